@@ -0,0 +1,65 @@
+/* alloc.h */
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// --------------------------------------------------------------------------
+// Allocation layer
+// --------------------------------------------------------------------------
+//
+// Every allocation in the pipeline goes through mem_alloc/mem_realloc/
+// mem_free, tagged with the subsystem that owns it. The bytes themselves
+// come from the installed Allocator (malloc by default). When tracking is on,
+// per-subsystem counts, live bytes and per-phase peaks are kept, and
+// mem_report prints them together with whatever is still live.
+
+typedef enum {
+    MEM_IO,           // Input buffers
+    MEM_LEXER,        // Line-start index
+    MEM_PARSER,       // Parser scope stack
+    MEM_AST,          // AST nodes, including shared expression nodes
+    MEM_DAG,          // Expression DAG index and parent lists
+    MEM_SYMBOLS,      // SymbolTable, Symbols, dense symbol arrays
+    MEM_PARALLEL,     // Persistent tables and task state
+    MEM_EXPORT,       // Export buffers and reader output
+    MEM_TRACE,        // Per-thread trace rings
+    MEM_INTERN,       // Interned names and their tables
+    MEM_API,          // Library contexts and their result buffers
+    MEM_IR,           // SSA programs and pass state
+    MEM_SUBSYSTEM_COUNT
+} MemSubsystem;
+
+// A custom allocator. Sizes include the layer's bookkeeping header, and
+// free/realloc are told the size that was allocated, so arena or pool
+// allocators can be plugged in without their own size tracking.
+typedef struct {
+    void* (*alloc)(void* context, size_t size);
+    void* (*realloc)(void* context, void* block, size_t old_size, size_t new_size);
+    void (*free)(void* context, void* block, size_t size);
+    void* context;
+} Allocator;
+
+// Install an allocator (NULL restores malloc) for the blocks allocated from
+// now on. A block is always resized and freed by the allocator it came from,
+// so that one must stay usable until its last block is freed. Only switch
+// while no other thread allocates. Returns 0 if eight distinct allocators
+// have been installed already.
+int mem_set_allocator(const Allocator* allocator);
+// The installed allocator, to restore later.
+const Allocator* mem_get_allocator(void);
+
+void* mem_alloc(MemSubsystem subsystem, size_t size);
+void* mem_calloc(MemSubsystem subsystem, size_t count, size_t size);
+void* mem_realloc(MemSubsystem subsystem, void* block, size_t size);
+void mem_free(void* block);
+
+// Tracking
+void mem_tracking_enable(int enabled);
+void mem_phase_begin(const char* name);   // Phases do not nest
+void mem_phase_end(void);
+size_t mem_live_bytes(void);
+void mem_report(FILE* out);
+
+#endif /* ALLOC_H */
@@ -0,0 +1,75 @@
+/* analyzer.h */
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <stddef.h>
+#include "alloc.h"
+#include "semantic.h"
+
+// --------------------------------------------------------------------------
+// In-process library API
+// --------------------------------------------------------------------------
+//
+// Analyzes source held in memory and hands back the results instead of
+// printing them: nothing is written to stdout and parse errors do not exit.
+// A context keeps its buffers between calls, so analyzing many small inputs
+// allocates little after the first.
+//
+// Build the library without the command-line driver:
+//   gcc -c -O2 -DSEMANTIC_NO_MAIN src/*/*.c && ar rcs libsemantic.a *.o
+// and link with -lpthread.
+//
+// One context per process: the parser, checker and interner keep
+// process-wide state, so analyzer_create returns NULL while another context
+// is open, and a context must be used by one thread at a time. Interned names
+// are shared with the rest of the process and outlive the context; the host
+// releases them with intern_free (intern.h) once nothing uses them. Running
+// out of memory still ends the process.
+
+typedef enum {
+    ANALYZER_SYNTAX,         // Parse error
+    ANALYZER_SEMANTIC        // Reported by the checker
+} AnalyzerDiagnosticKind;
+
+typedef struct {
+    AnalyzerDiagnosticKind kind;
+    int line;
+    char message[256];       // As the CLI prints it, newline included
+} AnalyzerDiagnostic;
+
+// All zero is a plain parse followed by analyze_semantics.
+typedef struct {
+    int keep_ast;            // Return the tree; otherwise it is freed (fused: never built)
+    int fused;               // Check while parsing (see analyze_fused)
+    int cross_reference;     // Record the use-def index (see get_cross_reference)
+} AnalyzerOptions;
+
+typedef struct {
+    int ok;                  // Parsed without errors and passed analysis
+    int aborted;             // A parse error stopped parsing; no symbols
+    const AnalyzerDiagnostic* diagnostics;
+    int diagnostic_count;
+    const ProgramSymbols* symbols;
+    ASTNode* ast;            // Only with keep_ast
+} AnalyzerResult;
+
+typedef struct AnalyzerContext AnalyzerContext;
+
+// Installs allocator (NULL for malloc) for everything allocated until
+// analyzer_destroy, which reinstalls the previous one. Blocks already live
+// stay with the allocator they came from, and names interned meanwhile keep
+// using this one, so it must stay usable until intern_free. Returns NULL if
+// a context is already open or the allocator cannot be installed.
+AnalyzerContext* analyzer_create(const Allocator* allocator);
+
+// Analyzes length bytes of buffer, which need not be NUL-terminated (a NUL
+// ends the input early). options may be NULL. The result and everything it
+// points to stay valid until the next call on the context; NULL if the input
+// could not be copied.
+const AnalyzerResult* analyzer_run(AnalyzerContext* context, const char* buffer, size_t length,
+                                   const AnalyzerOptions* options);
+
+// Frees the context and the last result. Interned names are kept.
+void analyzer_destroy(AnalyzerContext* context);
+
+#endif /* ANALYZER_H */
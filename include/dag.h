@@ -0,0 +1,47 @@
+/* dag.h */
+#ifndef DAG_H
+#define DAG_H
+
+#include "parser.h"
+
+// --------------------------------------------------------------------------
+// Hash-consed expression DAG (opt-in)
+// --------------------------------------------------------------------------
+//
+// While enabled, the parser interns every pure expression node (numbers,
+// identifiers, operators, factorial calls) bottom-up, so structurally
+// identical subexpressions become one shared node with dag_id >= 0. Shared
+// nodes belong to the DAG: free_ast skips them and dag_free releases them.
+//
+// Each shared node also caches a successful check. A check only depends on
+// which symbol each name resolves to and whether it is initialized;
+// assignments can only initialize, so the one write that can turn a passing
+// expression into a failing one is a declaration that shadows a name it
+// reads. dag_invalidate_name drops the cached result of every node above that
+// name. Failures are never cached, so every diagnostic is still reported,
+// on the line of the statement being checked (a shared node has no single
+// position of its own).
+
+typedef struct {
+    long requested;          // Expression nodes the parser built
+    int unique;              // Distinct nodes kept
+    long check_hits;         // check_expression calls answered from the cache
+    long check_misses;
+    long invalidated;        // Cached results dropped by declarations
+} DagStats;
+
+void dag_enable(int enabled);
+int dag_enabled(void);
+
+// Returns the canonical node for node, whose children must already be
+// canonical; a duplicate is freed.
+ASTNode* dag_intern(ASTNode* node);
+
+int dag_check_cached(const ASTNode* node);
+void dag_store_check(const ASTNode* node);
+void dag_invalidate_name(const Token* name);
+
+void dag_get_stats(DagStats* stats);
+void dag_free(void);
+
+#endif /* DAG_H */
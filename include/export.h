@@ -0,0 +1,73 @@
+/* export.h */
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "parser.h"
+#include "semantic.h"
+
+// --------------------------------------------------------------------------
+// Buffered writer
+// --------------------------------------------------------------------------
+
+// All export output goes through one fixed-size buffer that is flushed to
+// the FILE when full, so memory stays constant however large the program.
+typedef struct {
+    FILE* out;
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    int error;               // Nonzero once a write to `out` failed
+} ExportWriter;
+
+#define EXPORT_BUFFER_SIZE (1 << 20)
+
+int export_writer_open(ExportWriter* writer, FILE* out, size_t capacity);
+int export_writer_close(ExportWriter* writer);   // Flushes; returns 0 on success
+void export_flush(ExportWriter* writer);
+
+// --------------------------------------------------------------------------
+// Binary format (little-endian, unsigned LEB128 varints)
+// --------------------------------------------------------------------------
+//
+//   AST section:      "SAST" u8 version, then the program in pre-order.
+//     node:           u8 type, u8 flags (EXPORT_HAS_*), u8 token type,
+//                     varint offset, varint symbol_id + 1, varint slot + 1,
+//                     varint lexeme length, lexeme bytes,
+//                     then the left child, right child and next node if
+//                     the matching flag is set.
+//   Symbol section:   "SSYM" u8 version, varint symbol count, varint scope
+//     symbol:         varint name length, name bytes, varint type,
+//                     varint scope, varint scope level, varint slot,
+//                     varint line, u8 initialized
+//     scope:          varint parent + 1, varint level, varint first symbol,
+//                     varint end symbol, varint frame size
+
+#define EXPORT_FORMAT_VERSION 1
+#define EXPORT_HAS_LEFT  0x01
+#define EXPORT_HAS_RIGHT 0x02
+#define EXPORT_HAS_NEXT  0x04
+
+void export_ast_binary(ExportWriter* writer, const ASTNode* ast);
+void export_symbols_binary(ExportWriter* writer, const ProgramSymbols* program);
+
+// JSON lines: one object per node, symbol and scope. Nodes carry a pre-order
+// id plus their parent's id and the edge (left/right/next) leading to them.
+void export_ast_jsonl(ExportWriter* writer, const ASTNode* ast);
+void export_symbols_jsonl(ExportWriter* writer, const ProgramSymbols* program);
+
+// --------------------------------------------------------------------------
+// Binary reader
+// --------------------------------------------------------------------------
+
+// Each reader consumes one section from data and stores how many bytes it
+// used in *consumed. Trees come back as ordinary ASTNodes (free_ast them);
+// symbol arrays are mem_alloc'd (free_read_symbols them). Returns NULL / 0
+// on malformed input.
+ASTNode* read_ast_binary(const unsigned char* data, size_t size, size_t* consumed);
+int read_symbols_binary(const unsigned char* data, size_t size, size_t* consumed,
+                        ProgramSymbols* program);
+void free_read_symbols(ProgramSymbols* program);
+
+#endif /* EXPORT_H */
@@ -0,0 +1,69 @@
+/* ingest.h */
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stddef.h>
+
+// --------------------------------------------------------------------------
+// Batch file ingestion
+// --------------------------------------------------------------------------
+//
+// Reads a list of files ahead of the code analyzing them. An I/O thread keeps
+// up to `depth` reads in flight and queues each file once it is complete; the
+// consumer takes files off the queue in completion order and hands each
+// buffer back when done with it. Buffers come from a fixed pool, so at most
+// `buffers` files are held at once however long the list; a buffer grows to
+// fit the largest file it has held.
+//
+// On Linux the reads go through io_uring. Where it cannot be set up (old
+// kernel, seccomp, -DSEMANTIC_NO_IO_URING) the thread reads each file with
+// blocking preadv instead: regular files always poll as ready, so epoll
+// would add no overlap. Without threads files are read when asked for.
+
+#define INGEST_DEFAULT_DEPTH 32
+#define INGEST_DEFAULT_BUFFERS 64
+#define INGEST_DEFAULT_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    const char* path;
+    int index;               // Position in the path list
+    char* data;              // Contents, NUL-terminated
+    size_t length;
+    int error;               // errno of a failed open or read, else 0
+} IngestFile;
+
+typedef struct {
+    int depth;               // Reads in flight
+    int buffers;             // Files held at once, queued or with the consumer
+    size_t buffer_size;      // Initial capacity of each buffer
+} IngestOptions;
+
+typedef struct Ingest Ingest;
+
+// Starts reading paths (which must outlive the Ingest). options may be NULL.
+Ingest* ingest_start(const char* const* paths, int count, const IngestOptions* options);
+
+// Next file, blocking until one is read; NULL once every path was handed
+// out. A consumer holding `buffers` files must release one first.
+IngestFile* ingest_next(Ingest* ingest);
+void ingest_release(Ingest* ingest, IngestFile* file);
+
+// "io_uring", "preadv" or "inline".
+const char* ingest_backend(const Ingest* ingest);
+
+// Stops reading, joins the I/O thread and frees every buffer, released or not.
+void ingest_finish(Ingest* ingest);
+
+// Path lists: files as given, directories walked recursively in name order
+// (symbolic links inside them are not followed). Returns 0 with errno set
+// if path cannot be listed.
+typedef struct {
+    char** paths;
+    int count;
+    int capacity;
+} IngestPaths;
+
+int ingest_add_path(IngestPaths* list, const char* path);
+void ingest_free_paths(IngestPaths* list);
+
+#endif /* INGEST_H */
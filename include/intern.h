@@ -0,0 +1,38 @@
+/* intern.h */
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// --------------------------------------------------------------------------
+// Process-wide identifier interner
+// --------------------------------------------------------------------------
+//
+// Maps every distinct name to one canonical, immutable copy and a dense id,
+// shared by all threads and all programs analyzed in the process, so names
+// can be compared by id (or canonical pointer) across files.
+//
+// The table is split into INTERN_SHARDS shards by hash. Lookups never lock:
+// they follow atomically published table and entry pointers. Inserting a new
+// name locks only its shard; tables outgrown by an insert are retired, not
+// freed, so a concurrent reader can finish its probe. Ids and strings stay
+// valid until intern_free.
+
+#define INTERN_SHARDS 64             // Power of two
+
+// Id of name, interning it first if needed; -1 if out of memory.
+int intern_name(const char* name);
+// Same for the first length bytes of name, which need not be terminated.
+int intern_name_length(const char* name, size_t length);
+// Id of name if it is already interned, else -1. Never locks or allocates.
+int intern_lookup(const char* name);
+// Canonical copy of an interned name.
+const char* intern_string(int id);
+// Number of distinct names interned so far.
+int intern_count(void);
+
+// Releases every name. Only call once no thread uses the interner and
+// nothing holds an id or canonical pointer.
+void intern_free(void);
+
+#endif /* INTERN_H */
@@ -0,0 +1,211 @@
+/* ir.h */
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "parser.h"
+
+// --------------------------------------------------------------------------
+// SSA intermediate representation
+// --------------------------------------------------------------------------
+//
+// A checked program lowers to one function of basic blocks in SSA form.
+// Every instruction defines at most one value, named by its index, and
+// operands refer to those indices. Variables disappear during lowering: phis
+// join their definitions where control flow merges, so an assignment that
+// nothing reads is just an unused value.
+//
+// Values are 32-bit ints that wrap on overflow. Comparisons yield 0 or 1 and
+// conditions test for nonzero. A variable declared without an initializer
+// reads as 0, factorial(n) is 1 for n <= 1, and dividing by zero stops the
+// program, so passes never move or drop a division that might trap. Each
+// read statement takes the next value of the run's input, or 0 once the
+// input is used up.
+
+typedef enum {
+    IR_NOP,              // Removed; not in any block
+    IR_CONST,
+    IR_PHI,
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_SHL,              // Only introduced by strength reduction
+    IR_EQ,
+    IR_NE,
+    IR_LT,
+    IR_GT,
+    IR_FACTORIAL,
+    IR_READ,             // Next input value; never removed or reordered
+    IR_PRINT,
+    IR_JUMP,             // Terminators
+    IR_BRANCH,           // args[0] nonzero: succs[0], else succs[1]
+    IR_RETURN,
+    IR_OP_COUNT
+} IrOp;
+
+typedef struct {
+    IrOp op;
+    int block;           // Owning block, -1 once removed
+    int args[2];         // Operand values, -1 if unused
+    int* phi_args;       // IR_PHI: one value per predecessor of the block
+    int imm;             // IR_CONST value
+    int line;            // Source line
+} IrInstr;
+
+typedef struct {
+    int* code;           // Instruction ids: phis, body, then one terminator
+    int length;
+    int capacity;
+    int* preds;
+    int pred_count;
+    int pred_capacity;
+    int succs[2];        // -1 if absent
+} IrBlock;
+
+typedef struct {
+    IrInstr* instrs;
+    int instr_count;
+    int instr_capacity;
+    IrBlock* blocks;
+    int block_count;
+    int block_capacity;
+} IrProgram;             // Block 0 is the entry
+
+// Variables of a program. Each declaration is one variable; a name refers to
+// the latest declaration of it before the use in source order, which is how
+// the checker resolves names (a block's declarations stay visible after it).
+typedef struct {
+    const ASTNode** nodes;   // Open-addressed: VARDECL, ASSIGN and IDENTIFIER nodes
+    int* vars;
+    int capacity;
+    int node_count;
+    int var_count;
+} IrVariables;
+
+// Returns 0 and describes the problem in error if a name has no declaration
+// (possible inside repeat bodies, which the checker skips).
+int ir_resolve_variables(const ASTNode* ast, IrVariables* variables, char* error, size_t size);
+int ir_variable_of(const IrVariables* variables, const ASTNode* node);
+void ir_free_variables(IrVariables* variables);
+
+// Lowering; NULL with error set if the program cannot be lowered.
+IrProgram* ir_lower(const ASTNode* ast, char* error, size_t size);
+void ir_free(IrProgram* program);
+
+int ir_instruction_count(const IrProgram* program);
+void ir_dump(FILE* out, const IrProgram* program);
+// Checks block structure and that every definition dominates its uses.
+// Returns 0 and describes the first problem in error.
+int ir_verify(const IrProgram* program, char* error, size_t size);
+
+// Internal helpers shared by the passes and interpreters
+int ir_literal(const ASTNode* number);
+IrOp ir_operator(const ASTNode* binop);
+// Returns 0 instead of dividing by zero.
+int ir_evaluate(IrOp op, int a, int b, int* result);
+int ir_add_instr(IrProgram* program, IrOp op, int a, int b, int line);
+void ir_insert(IrProgram* program, int block, int position, int instr);
+// Marks instr removed; ir_compact then drops it from its block's code.
+void ir_remove(IrProgram* program, int instr);
+void ir_compact(IrProgram* program);
+// A constant at the start of the entry block, shared if already there.
+int ir_constant(IrProgram* program, int value);
+int ir_pred_index(const IrProgram* program, int block, int pred);
+
+typedef struct {
+    int* idom;           // Immediate dominator, -1 for the entry and unreachable blocks
+    int* order;          // Reachable blocks in reverse postorder
+    int* rank;           // Position of each block in order, -1 if unreachable
+    int count;
+    int* first_child;    // Dominator tree
+    int* next_sibling;
+    int* enter;          // Depth-first numbering of the tree
+    int* leave;
+} IrDominators;
+
+void ir_dominators(const IrProgram* program, IrDominators* dom);
+int ir_dominates(const IrDominators* dom, int a, int b);
+void ir_free_dominators(IrDominators* dom);
+
+// --------------------------------------------------------------------------
+// Passes (passes.c)
+// --------------------------------------------------------------------------
+//
+// Each returns how many instructions it changed: removed (GVN, DCE), hoisted
+// out of loops (LICM) or replaced by cheaper ones (strength reduction).
+
+int ir_gvn(IrProgram* program);
+int ir_licm(IrProgram* program);
+int ir_strength_reduce(IrProgram* program);
+int ir_dce(IrProgram* program);
+
+// --------------------------------------------------------------------------
+// Interpreters (interp.c)
+// --------------------------------------------------------------------------
+
+#define IR_RUN_KEEP 1024     // Printed values kept for comparison
+
+typedef enum {
+    IR_RUN_DONE,
+    IR_RUN_DIVIDE_BY_ZERO,
+    IR_RUN_STEP_LIMIT
+} IrRunStatus;
+
+typedef struct {
+    IrRunStatus status;
+    long printed;            // Values printed in all
+    int kept[IR_RUN_KEEP];   // The first IR_RUN_KEEP of them
+    unsigned long checksum;  // Over every printed value
+    long steps;              // Instructions executed (phis are free)
+    long multiplies;         // Of which IR_MUL and IR_DIV
+} IrRun;
+
+// Runs program for at most max_steps instructions, reading from the
+// input_count values of inputs.
+void ir_run(const IrProgram* program, const int* inputs, int input_count, long max_steps, IrRun* run);
+// Reference semantics: walks the AST directly. Steps count evaluated nodes.
+void ir_run_ast(const ASTNode* ast, const int* inputs, int input_count, long max_steps, IrRun* run);
+// Whether two runs printed the same. Runs cut off by the step limit are
+// compared on the values both printed.
+int ir_runs_agree(const IrRun* a, const IrRun* b);
+
+// --------------------------------------------------------------------------
+// Batch execution (batch.c)
+// --------------------------------------------------------------------------
+//
+// Runs one program over many inputs at once. Each input is a lane; a batch
+// holds IR_LANES of them, and every variable is a column evaluated with SIMD
+// across the lanes. Branches and loops keep a mask of the lanes that take
+// them, so lanes may diverge; the batch follows a branch while any lane does.
+// Results match ir_run_ast except that the limit counts loop iterations per
+// lane rather than steps.
+//
+// The streams take one input per line (integers separated by blanks) and
+// write one line per input: the values printed, " ..." if more than
+// IR_RUN_KEEP were, then "!division by zero" or "!step limit" if the run
+// stopped early.
+
+#define IR_LANES 256
+
+typedef struct IrBatchProgram IrBatchProgram;
+
+typedef struct {
+    long rows;               // Inputs run
+    double execute_seconds;  // Spent running them, without parsing or printing
+} IrStreamStats;
+
+// NULL with error set if the program cannot be compiled.
+IrBatchProgram* ir_batch_compile(const ASTNode* ast, char* error, size_t size);
+void ir_batch_free(IrBatchProgram* program);
+// Lanes per SIMD instruction in this build: 8 (AVX2), 4 (SSE2) or 1.
+int ir_batch_vector_width(void);
+// Return 0 with error set on a malformed input line; rows before it are run.
+int ir_batch_stream(const IrBatchProgram* program, FILE* in, FILE* out, long max_iterations,
+                    IrStreamStats* stats, char* error, size_t size);
+// The same stream one input at a time through ir_run, for comparison.
+int ir_scalar_stream(const IrProgram* program, FILE* in, FILE* out, long max_steps,
+                     IrStreamStats* stats, char* error, size_t size);
+
+#endif /* IR_H */
@@ -2,11 +2,35 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
 #include "tokens.h"
 
+#define TOKEN_TEXT_SIZE 128     // Fits the spelling of any token
+
 // Lexer functions that need to be visible to other files
 Token get_next_token(const char* input, int* pos);
 void print_token(Token token);
 void print_error(ErrorType error, int line, const char* lexeme);
 
+// Spelling of a token, written to buf and returned. Only an overflowing
+// number needs the source it was lexed from (the current input).
+const char* token_text(const Token* token, char* buf, size_t size);
+// Canonical interned name of a TOKEN_IDENTIFIER.
+const char* token_name(const Token* token);
+const char* operator_text(OperatorId op);
+// Decodes the spelling of a token whose type is already set, as the lexer
+// would have. The result has no source text. Returns 0 if out of memory or
+// a number does not fit in a long long.
+int token_decode(Token* token, const char* text);
+
+// Source positions are resolved lazily from a line-start index over the
+// current input, so only diagnostics pay for line/column bookkeeping.
+void lexer_set_source(const char* input);
+int offset_to_line(int offset);
+int offset_to_column(int offset);
+int line_to_offset(int line, int column);   // Both 1-based; clamped to the input
+int token_line(Token token);
+int token_column(Token token);
+void free_line_index(void);
+
 #endif /* LEXER_H */
\ No newline at end of file
@@ -0,0 +1,24 @@
+/* lexer_dfa.h - generated by tools/lexgen.c from src/lexer/lexer.rules; do not edit */
+#ifndef LEXER_DFA_H
+#define LEXER_DFA_H
+
+#define DFA_STATE_COUNT 45
+#define DFA_CLASS_COUNT 27
+#define DFA_ROW_SHIFT 5   // Rows are padded to a power of two
+#define DFA_DEAD 0
+#define DFA_START 1
+
+// dfa_token values besides TokenType
+#define DFA_REJECT (-1)
+#define DFA_SKIP (-2)
+
+// dfa_flags bits
+#define DFA_IDENT 1
+#define DFA_ARITH 2
+
+extern const unsigned char dfa_class[256];
+extern const unsigned char dfa_next[DFA_STATE_COUNT << DFA_ROW_SHIFT];
+extern const signed char dfa_token[DFA_STATE_COUNT];
+extern const unsigned char dfa_flags[DFA_STATE_COUNT];
+
+#endif /* LEXER_DFA_H */
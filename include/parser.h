@@ -2,6 +2,7 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <setjmp.h>
 #include "tokens.h"
 
 // Basic node types for AST
@@ -18,7 +19,8 @@ typedef enum {
     AST_WHILE,          // For while loops
     AST_REPEAT,         // For repeat-until loops
     AST_BLOCK,          // For block statements
-    AST_FUNC_CALL       // For function calls, e.g., factorial
+    AST_FUNC_CALL,      // For function calls, e.g., factorial
+    AST_READ            // Read statement; left is the target identifier
     // TODO: Add more node types as needed
 } ASTNodeType;
 
@@ -43,11 +45,36 @@ typedef struct ASTNode {
     struct ASTNode* left;  // For expressions, the left operand or child
     struct ASTNode* right; // For expressions, the right operand or child
     struct ASTNode* next;  // New: used solely to chain statements in a block
+    int symbol_id;         // Resolved symbol (VARDECL/ASSIGN/IDENTIFIER), -1 if none
+    int slot;              // Frame slot of that symbol within its scope, -1 if none
+    int dag_id;            // Shared expression node (see dag.h), -1 if none
 } ASTNode;
 
+struct SymbolTable;
+
 // Parser functions
 void parser_init(const char* input);
+// Same, but tokens come from a lexer thread (see token_pipeline.h). Returns
+// 0 if none could be started, in which case the parser lexes inline.
+int parser_init_pipelined(const char* input);
+// Stops the lexer thread, if any. Call once parsing is done.
+void parser_close(void);
 ASTNode* parse(void);
+// Parse while resolving names against a semantic symbol table (used by
+// analyze_fused). Returns NULL without allocating any nodes if build_ast is 0.
+ASTNode* parse_checked(struct SymbolTable* table, int build_ast, int* result);
+// Statement-at-a-time alternative to parse(): returns the next top-level
+// statement for the caller to free_ast, or NULL at the end of the input.
+ASTNode* parse_next_statement(void);
+// Route parse error messages (newline included) to sink instead of stdout;
+// NULL restores printing.
+typedef void (*ParseErrorSink)(void* context, int line, const char* message);
+void set_parse_error_sink(ParseErrorSink sink, void* context);
+// A parse error that cannot be recovered from normally exits. While a
+// recovery point is set it frees the unfinished tree, resets the parser and
+// longjmps there instead. Set it before parser_init and clear it (NULL)
+// once the tree is handed over. Not for DAG or statement-at-a-time parses.
+void parser_set_recovery(jmp_buf* point);
 void print_ast(ASTNode* node, int level);
 void free_ast(ASTNode* node);
 
@@ -0,0 +1,51 @@
+/* perfcount.h */
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdio.h>
+
+// --------------------------------------------------------------------------
+// Hardware counter profile (opt-in)
+// --------------------------------------------------------------------------
+//
+// Counts cycles, instructions, L1 data read misses, last-level cache misses
+// and branch misses with perf_event_open, in user space and across every
+// thread started after perf_start. PERF_BEGIN/PERF_END charge what was
+// counted in between to a phase; a phase begun inside another pauses it, so
+// each phase's counts are its own. Each phase also counts units of work
+// (bytes, tokens, nodes, lookups, symbols) so the report can show rates.
+//
+// Counters the kernel refuses (no PMU in a VM, perf_event_paranoid, a
+// container's seccomp profile) are reported as unavailable with the
+// reason; wall time and units are always measured. While stopped, each
+// macro is one branch.
+
+typedef enum {
+    PERF_LOAD,               // Reading the input; units are bytes
+    PERF_LEX,                // A get_next_token loop over the input; tokens
+    PERF_PARSE,              // parse_program, lexing included; AST nodes
+    PERF_CHECK,              // Semantic analysis; symbol lookups
+    PERF_DUMP,               // dump_symbol_table; symbols
+    PERF_PHASE_COUNT
+} PerfPhase;
+
+extern int perf_active;
+
+// Opens the counters and starts profiling. Returns how many counters could
+// be opened, possibly 0.
+int perf_start(void);
+void perf_begin(PerfPhase phase);
+void perf_end(void);
+void perf_add_units(PerfPhase phase, long units);
+
+// Stops profiling and prints one row per phase that ran.
+void perf_report(FILE* out);
+
+#define PERF_BEGIN(phase) \
+    do { if (perf_active) perf_begin(phase); } while (0)
+#define PERF_END() \
+    do { if (perf_active) perf_end(); } while (0)
+#define PERF_UNITS(phase, units) \
+    do { if (perf_active) perf_add_units((phase), (units)); } while (0)
+
+#endif /* PERFCOUNT_H */
@@ -0,0 +1,79 @@
+/* psymtab.h */
+#ifndef PSYMTAB_H
+#define PSYMTAB_H
+
+#include <stddef.h>
+
+// --------------------------------------------------------------------------
+// Persistent (immutable) symbol table
+// --------------------------------------------------------------------------
+//
+// Same lookup rules as SymbolTable in semantic.h, but every update produces a
+// new version and leaves older ones intact. A PSymTab is just a handle to one
+// version, so taking a snapshot (e.g. on scope entry) is a struct copy.
+// Names are kept in a hash array mapped trie; each name maps to its bindings,
+// newest first, exactly the order SymbolTable's linked list would find them.
+// Nodes are never freed individually: they live in a PArena.
+
+typedef struct PArenaChunk PArenaChunk;
+
+typedef struct {
+    PArenaChunk* head;
+} PArena;
+
+void* parena_alloc(PArena* arena, size_t size);
+void parena_adopt(PArena* arena, PArena* other);   // takes over other's chunks
+void parena_free(PArena* arena);
+
+// One declaration, shared by every version of the table that contains it.
+typedef struct PDecl {
+    const char* name;
+    int name_id;             // Interned id of name
+    int scope_level;
+    int line_declared;
+    int is_initialized;      // Filled in by psymtab_finalize
+} PDecl;
+
+typedef struct PBinding {
+    PDecl* decl;
+    int scope_level;
+    int is_initialized;
+    const struct PBinding* next;   // Older binding of the same name
+} PBinding;
+
+typedef struct PEntry {
+    const char* name;
+    unsigned hash;
+    int reported;                  // Undeclared-use already diagnosed
+    const PBinding* bindings;
+    const struct PEntry* collision;
+} PEntry;
+
+typedef struct PNode PNode;
+
+typedef struct {
+    const PNode* root;
+    int scope_level;
+    int reported_count;            // Names with reported set
+} PSymTab;
+
+void psymtab_init(PSymTab* table);
+
+const PEntry* psymtab_entry(const PSymTab* table, const char* name);
+const PBinding* psymtab_lookup(const PSymTab* table, const char* name);
+const PBinding* psymtab_lookup_current_scope(const PSymTab* table, const char* name);
+
+void psymtab_declare(PArena* arena, PSymTab* table, PDecl* decl);
+void psymtab_mark_initialized(PArena* arena, PSymTab* table, const char* name);
+void psymtab_set_reported(PArena* arena, PSymTab* table, const char* name);
+
+// Replace (or add) the entry for entry->name with a copy of entry, typically
+// taken from another version of the table.
+void psymtab_put_entry(PArena* arena, PSymTab* table, const PEntry* entry);
+
+// Copy each binding's initialization state into its PDecl.
+void psymtab_finalize(const PSymTab* table);
+
+unsigned psymtab_hash(const char* name);
+
+#endif /* PSYMTAB_H */
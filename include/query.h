@@ -0,0 +1,51 @@
+/* query.h */
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "semantic.h"
+
+// --------------------------------------------------------------------------
+// Demand-driven queries
+// --------------------------------------------------------------------------
+//
+// A QueryEngine answers questions about one position of a parsed program by
+// checking top-level statements only up to that position. Checking moves a
+// frontier forward and never repeats work: the symbols it declares (with the
+// offsets at which they were declared and became initialized) and the
+// diagnostics it would have printed are kept, so a query behind the frontier
+// is a binary search. Results match analyze_semantics, which declares and
+// initializes in source order and never removes a block's symbols.
+//
+// Positions are byte offsets into the input given to parser_init (see
+// line_to_offset). The engine uses the checker's global state: only one
+// engine may be advancing at a time, and not alongside another analysis.
+
+typedef struct {
+    int line;
+    char message[160];       // As semantic_error prints it, newline included
+} QueryDiagnostic;
+
+typedef struct QueryEngine QueryEngine;
+
+// The engine annotates but does not own ast; free it after query_close.
+QueryEngine* query_open(ASTNode* ast);
+void query_close(QueryEngine* engine);
+
+// Symbols visible at offset, latest declaration first, one per name. Writes
+// up to max symbol ids and returns how many there are in total.
+int query_visible(QueryEngine* engine, int offset, int* ids, int max);
+const ResolvedSymbol* query_symbol(const QueryEngine* engine, int id);
+
+// Whether name reads as initialized at offset: 1 or 0, or -1 if no
+// declaration of it is visible there.
+int query_initialized(QueryEngine* engine, const char* name, int offset);
+
+// Diagnostics reported on lines [first_line, last_line]; *first points at
+// the first of the returned count.
+int query_diagnostics(QueryEngine* engine, int first_line, int last_line,
+                      const QueryDiagnostic** first);
+
+// Top-level statements checked so far, out of *total.
+int query_checked(const QueryEngine* engine, int* total);
+
+#endif /* QUERY_H */
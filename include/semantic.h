@@ -1,6 +1,7 @@
 #ifndef SEMANTIC_H
 #define SEMANTIC_H
 
+#include <stddef.h>
 #include "parser.h"   // For ASTNode definition
 #include "tokens.h"   // For token types (e.g. TOKEN_INT)
 
@@ -9,17 +10,72 @@
 // --------------------------------------------------------------------------
 
 typedef struct Symbol {
-    char name[100];          // Variable name
+    const char* name;        // Variable name, interned (see intern.h)
+    int name_id;             // Its interner id
     int type;                // Data type (e.g., TOKEN_INT)
     int scope_level;         // Scope nesting level
     int line_declared;       // Line where declared
     int is_initialized;      // 0 = not initialized, 1 = initialized
+    int id;                  // Index into ProgramSymbols.symbols
     struct Symbol* next;     // Next symbol in the linked list
 } Symbol;
 
+// Dense, declaration-ordered view of every symbol and scope of a program.
+// Resolved AST nodes refer into it by ASTNode.symbol_id.
 typedef struct {
+    const char* name;        // Interned, like Symbol.name
+    int name_id;
+    int type;
+    int scope;               // Index into ProgramSymbols.scopes
+    int scope_level;         // Nesting level (Symbol.scope_level)
+    int slot;                // Slot within that scope's frame
+    int line_declared;
+    int is_initialized;      // Final state after analysis
+    int declared_at;         // Offset of the declared name, -1 if unknown
+    int initialized_at;      // Offset from which it reads as initialized, -1 if never
+} ResolvedSymbol;
+
+typedef struct {
+    int parent;              // Enclosing scope, -1 for the program scope
+    int level;               // Nesting level (matches Symbol.scope_level)
+    int first_symbol;        // Symbols declared inside this scope, nested
+    int end_symbol;          //   scopes included, are ids [first, end)
+    int frame_size;          // Number of slots declared directly in it
+} ScopeRange;
+
+typedef struct {
+    ResolvedSymbol* symbols;
+    int symbol_count;
+    int symbol_capacity;
+    ScopeRange* scopes;
+    int scope_count;
+    int scope_capacity;
+} ProgramSymbols;
+
+// One resolved name occurrence, in check order (grouped by xref.h).
+typedef enum {
+    XREF_DECL,               // Declaration
+    XREF_DEF,                // Initializer or assignment
+    XREF_USE                 // Read in an expression
+} XrefKind;
+
+typedef struct {
+    int symbol;
+    XrefKind kind;
+    int offset;
+    ASTNode* node;
+} XrefRecord;
+
+typedef struct SymbolTable {
     Symbol* head;            // Head of the symbol linked list
     int current_scope;       // Current scope level
+    int current_scope_id;    // Innermost open scope in program.scopes
+    ProgramSymbols program;  // Dense symbol/scope arrays, filled as we go
+    XrefRecord* refs;        // Occurrences seen so far
+    int ref_count;
+    int ref_capacity;
+    int pending_ref;         // Last record still waiting for resolve_node, or -1
+    long lookups;            // Name occurrences resolved (see semantic_lookups)
 } SymbolTable;
 
 // --------------------------------------------------------------------------
@@ -34,6 +90,15 @@ void enter_scope(SymbolTable* table);
 void exit_scope(SymbolTable* table);
 void remove_symbols_in_current_scope(SymbolTable* table);
 void free_symbol_table(SymbolTable* table);
+void dump_symbol_table(SymbolTable* table);
+// Whether the analyze_* entry points print the table on success (default on).
+void set_symbol_table_dump(int enabled);
+
+// Symbols of the last analyze_semantics/analyze_fused/analyze_streaming run;
+// empty after the parallel checkers (see analyze_semantics_parallel). Stays
+// valid until the next run or free_program_symbols().
+const ProgramSymbols* get_program_symbols(void);
+void free_program_symbols(void);
 
 // --------------------------------------------------------------------------
 // Semantic Error Types and Reporting
@@ -49,7 +114,18 @@ typedef enum {
     SEM_ERROR_SEMANTIC_ERROR  // Generic semantic error
 } SemanticErrorType;
 
+// Undeclared-variable diagnostics are reported once per name, for at most
+// this many distinct names.
+#define MAX_REPORTED_ERRORS 100
+
 void semantic_error(SemanticErrorType error, const char* name, int line);
+// Forget which names were reported; every analysis starts with this.
+void reset_semantic_errors(void);
+// Route semantic_error to sink instead of stdout (NULL restores printing).
+typedef void (*DiagnosticSink)(void* context, SemanticErrorType error, const char* name, int line);
+void set_diagnostic_sink(DiagnosticSink sink, void* context);
+// Same message as semantic_error, written snprintf-style into buffer.
+int format_semantic_error(char* buffer, size_t size, SemanticErrorType error, const char* name, int line);
 
 // --------------------------------------------------------------------------
 // Semantic Analysis Functions
@@ -58,19 +134,83 @@ void semantic_error(SemanticErrorType error, const char* name, int line);
 // Entry point for semantic analysis. Returns nonzero on success.
 int analyze_semantics(ASTNode* ast);
 
+// Name occurrences the last analysis resolved, any entry point (--perf
+// units). Every checker counts one per declaration, target and use it keeps,
+// so the figure is the program's whatever the mode: work a parallel checker
+// throws away is not counted, and only --dag, which checks a shared
+// expression once, counts fewer. Set once the analysis has finished.
+extern long semantic_lookups;
+
+// Single-pass alternative to parse() + analyze_semantics(): checks the input
+// given to parser_init while parsing it. If out_ast is NULL no AST nodes are
+// allocated at all; otherwise the tree is built and returned through it.
+int analyze_fused(ASTNode** out_ast);
+// Frees the symbol table of an analyze_fused that a parse error jumped out
+// of (see parser_set_recovery).
+void abandon_analysis(void);
+
+// Same output as parse() + analyze_semantics() for a program that parses,
+// but each top-level statement is parsed, checked and freed before the next
+// one is read, so no AST outlives its statement. Like analyze_fused, reads
+// the input given to parser_init; published symbols keep no nodes.
+int analyze_streaming(void);
+
+// Same diagnostics and symbol table dump as analyze_semantics, but sibling
+// statement ranges and then/else blocks are checked as fork-join tasks on up
+// to `threads` threads against snapshots of a persistent symbol table (see
+// psymtab.h).
+//
+// Neither parallel checker resolves the tree or publishes symbols: symbol_id
+// and slot stay -1, and get_program_symbols() and get_cross_reference() come
+// back empty. Whatever reads them, such as an export or --xref-report, must
+// run analyze_semantics instead; main switches to it for those.
+int analyze_semantics_parallel(ASTNode* ast, int threads);
+// The same again, but the top-level statements are split into chunks that
+// are checked independently on up to `threads` threads, each summarized by
+// the names it relied on from earlier chunks, then combined in order;
+// a chunk whose summary does not hold is checked again.
+int analyze_semantics_map_reduce(ASTNode* ast, int threads);
+
 // Check a variable declaration (no redeclaration in same scope).
 int check_declaration(ASTNode* node, SymbolTable* table);
 
 // Check a variable assignment (variable must be declared; mark as initialized).
 int check_assignment(ASTNode* node, SymbolTable* table);
 
+// Check a read statement; its target is assigned like an assignment's.
+int check_read(ASTNode* node, SymbolTable* table);
+
 // Check an expression for type correctness and variable usage.
 int check_expression(ASTNode* node, SymbolTable* table);
 
 // Check a block of statements (handle scope creation and removal).
 int check_block(ASTNode* node, SymbolTable* table);
 
+// Check one statement of any kind, as analyze_semantics does for each
+// top-level statement.
+int check_statement(ASTNode* node, SymbolTable* table);
+
 // Check a condition (e.g., in if or while statements).
 int check_condition(ASTNode* node, SymbolTable* table);
 
+// Leaf checks, usable without an AST (the fused parser calls these directly).
+// Each reports its own diagnostic and returns 0 on failure. The symbol a
+// name resolved to, if any, is stored through resolved when it is non-NULL.
+int check_declared_name(const Token* name, SymbolTable* table);   // declare in current scope
+int check_assigned_name(const Token* name, SymbolTable* table,    // must exist; marks initialized
+                        Symbol** resolved);
+int check_identifier_use(const Token* name, SymbolTable* table,   // must exist and be initialized
+                         Symbol** resolved);
+int check_callee_name(const Token* callee, const Token* call);    // only factorial() is known
+
+// Set symbol's initialized flag; offset is where that takes effect.
+void mark_initialized(SymbolTable* table, Symbol* symbol, int offset);
+
+// Record the write done by a declaration's initializer.
+void record_initializer(SymbolTable* table, const Symbol* declared, const Token* name, ASTNode* node);
+
+// Record a resolved symbol on a VARDECL/ASSIGN/IDENTIFIER node (no-op if NULL)
+// and attach the node to the occurrence the preceding leaf check recorded.
+void resolve_node(ASTNode* node, SymbolTable* table, const Symbol* symbol);
+
 #endif /* SEMANTIC_H */
@@ -0,0 +1,35 @@
+/* token_pipeline.h */
+#ifndef TOKEN_PIPELINE_H
+#define TOKEN_PIPELINE_H
+
+#include "tokens.h"
+
+// --------------------------------------------------------------------------
+// Pipelined lexing
+// --------------------------------------------------------------------------
+//
+// A lexer thread runs get_next_token over the whole input and hands tokens
+// to the parser through a bounded single-producer/single-consumer ring.
+// Each side keeps a private copy of the other's index and only publishes
+// its own every TOKEN_PIPELINE_BATCH tokens (or when it would otherwise
+// wait), so the shared cache lines move once per batch, not once per token.
+// The ring holds the lexer at most TOKEN_PIPELINE_SLOTS tokens ahead.
+
+#define TOKEN_PIPELINE_SLOTS 1024    // Power of two, multiple of the batch
+#define TOKEN_PIPELINE_BATCH 64
+
+typedef struct TokenPipeline TokenPipeline;
+
+// Starts lexing input on a new thread. Returns NULL if no thread could be
+// started (or threads are compiled out); the caller then lexes inline.
+TokenPipeline* token_pipeline_start(const char* input);
+
+// Next token, blocking until the lexer has produced it. Once the EOF token
+// is reached it is returned again on every call.
+Token token_pipeline_next(TokenPipeline* pipeline);
+
+// Stops the lexer thread wherever it is, joins it and frees the ring. Safe
+// to call before the parser has consumed everything (e.g. on a parse error).
+void token_pipeline_stop(TokenPipeline* pipeline);
+
+#endif /* TOKEN_PIPELINE_H */
@@ -20,7 +20,7 @@ typedef enum {
     TOKEN_WHILE,     // Added for while loops
     TOKEN_REPEAT,    // Added for repeat-until loops
     TOKEN_UNTIL,     // Added for repeat-until loops
-    TOKEN_READ,      // (optional) for input operations
+    TOKEN_READ,      // Added for read statements
     TOKEN_ERROR
 } TokenType;
 
@@ -30,15 +30,37 @@ typedef enum {
     ERROR_INVALID_NUMBER,
     ERROR_CONSECUTIVE_OPERATORS,
     ERROR_INVALID_IDENTIFIER,
-    ERROR_UNEXPECTED_TOKEN
+    ERROR_UNEXPECTED_TOKEN,
+    ERROR_NUMBER_OVERFLOW    // Literal above the largest long long
 } ErrorType;
 
+// Operators of TOKEN_OPERATOR tokens, decoded once by the lexer
+typedef enum {
+    OP_NONE,
+    OP_EQ,      // ==
+    OP_NE,      // !=
+    OP_LT,      // <
+    OP_GT,      // >
+    OP_ADD,     // +
+    OP_SUB,     // -
+    OP_MUL,     // *
+    OP_DIV,     // /
+    OP_COUNT
+} OperatorId;
+
+// Tokens are packed into 16 bytes and carry no text. Names and numbers are
+// decoded by the lexer, and token_text (lexer.h) recovers the spelling when a
+// diagnostic or export needs it.
 typedef struct {
-    TokenType type;
-    char lexeme[100];   // Actual text of the token
-    int line;           // Line number in source file
-    int column;
-    ErrorType error;    // Error type if any
+    unsigned char type;     // TokenType
+    unsigned char op;       // OperatorId; also set on a CONSECUTIVE_OPERATORS error
+    unsigned char error;    // ErrorType
+    unsigned char length;   // Bytes of source text, 0 for tokens not lexed from source
+    int offset;             // Byte offset in source (see token_line/token_column)
+    long long value;        // NUMBER: literal value; IDENTIFIER: interned name id;
+                            // INVALID_CHAR error: the offending byte
 } Token;
 
+_Static_assert(sizeof(Token) == 16, "Token must stay 16 bytes");
+
 #endif /* TOKENS_H */
\ No newline at end of file
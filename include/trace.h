@@ -0,0 +1,40 @@
+/* trace.h */
+#ifndef TRACE_H
+#define TRACE_H
+
+// --------------------------------------------------------------------------
+// Timeline tracer (opt-in)
+// --------------------------------------------------------------------------
+//
+// Once started, TRACE_BEGIN/TRACE_END time a span on the calling thread.
+// Open spans sit on a small per-thread stack; a finished span is stored as
+// one event in a ring buffer owned by that thread, so recording takes no
+// lock and memory stays bounded. A full ring overwrites its oldest events,
+// and because spans are stored when they end, the enclosing phases are the
+// last to go. trace_write emits Chrome trace-event JSON, which Perfetto and
+// chrome://tracing open directly. While stopped, each macro is one branch.
+//
+// Span names must be string literals (only the pointer is stored). An
+// offset, when given, is reported as the span's source line.
+
+#define TRACE_RING_EVENTS 16384      // Per thread, power of two
+#define TRACE_MAX_DEPTH 64           // Deeper spans are not recorded
+
+extern int trace_active;
+
+void trace_start(void);
+void trace_begin(const char* name, int offset);
+void trace_end(void);
+
+// Stops tracing and writes every thread's retained spans to path.
+// Returns 0 on failure.
+int trace_write(const char* path);
+void trace_free(void);
+
+#define TRACE_BEGIN_AT(name, offset) \
+    do { if (trace_active) trace_begin((name), (offset)); } while (0)
+#define TRACE_BEGIN(name) TRACE_BEGIN_AT(name, -1)
+#define TRACE_END() \
+    do { if (trace_active) trace_end(); } while (0)
+
+#endif /* TRACE_H */
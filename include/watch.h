@@ -0,0 +1,56 @@
+/* watch.h */
+#ifndef WATCH_H
+#define WATCH_H
+
+// --------------------------------------------------------------------------
+// File tree watching
+// --------------------------------------------------------------------------
+//
+// Reports which files under a set of paths were written, created or removed,
+// in bursts: after the first event the watcher keeps collecting until no
+// event has arrived for a quiet period, so an editor's save (write to a
+// temporary, rename over the original) or a checkout of many files comes back
+// as one burst with each path listed once.
+//
+// Paths are given as for ingest_add_path: files, or directories watched
+// recursively, subdirectories created later included. A changed path is
+// spelled the way ingest_add_path lists it. A named file is watched through
+// its directory, so replacing it by rename is seen.
+//
+// Linux only (inotify); elsewhere watch_start fails with ENOSYS.
+
+typedef enum {
+    WATCH_CHANGED,           // Written and closed, or moved into place
+    WATCH_REMOVED            // Deleted or moved away
+} WatchChangeKind;
+
+typedef struct {
+    char* path;
+    WatchChangeKind kind;
+    int directory;           // A removed directory: everything under path/ went
+} WatchChange;
+
+typedef struct {
+    WatchChange* changes;    // In the order paths were first seen
+    int count;
+    int capacity;
+    int overflowed;          // Events were lost; rescan everything
+    double first_event;      // CLOCK_MONOTONIC seconds the burst was noticed
+} WatchBurst;
+
+typedef struct Watch Watch;
+
+// Returns NULL with errno set if inotify or a path cannot be watched.
+Watch* watch_start(const char* const* paths, int count);
+int watch_directory_count(const Watch* watch);
+
+// Waits for the next burst, which ends after quiet_ms without events (or
+// a few times that, under a steady stream). Returns 0 on error with errno
+// set, EINTR if a signal arrived before the first event. The burst is reset
+// first; free it with watch_free_burst.
+int watch_next(Watch* watch, int quiet_ms, WatchBurst* burst);
+void watch_free_burst(WatchBurst* burst);
+
+void watch_finish(Watch* watch);
+
+#endif /* WATCH_H */
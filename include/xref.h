@@ -0,0 +1,55 @@
+/* xref.h */
+#ifndef XREF_H
+#define XREF_H
+
+#include <stdio.h>
+#include "semantic.h"
+
+// --------------------------------------------------------------------------
+// Use-def cross-reference index
+// --------------------------------------------------------------------------
+//
+// analyze_semantics and analyze_fused record every name occurrence the leaf
+// checks resolve and publish them with the program symbols, grouped by
+// symbol id and kind. Each group is sorted by source position, so "where is
+// this declared / written / read" is one array lookup for any node's
+// symbol_id. Occurrences inside expressions answered by the --dag check
+// cache are not visited and so not recorded.
+//
+// Recording is on by default; its memory grows with the number of
+// occurrences, so switch it off when nothing will query the index.
+
+typedef struct {
+    int offset;              // Byte offset of the name (offset_to_line/column)
+    ASTNode* node;           // VARDECL, ASSIGN or IDENTIFIER; NULL without a tree
+} XrefSite;
+
+typedef struct {
+    XrefSite* sites;
+    int* start;              // Group (symbol, kind) is sites[start[3 * symbol + kind]]
+                             //   up to the next group; start has 3 * symbols + 1 entries
+    int symbol_count;
+    int site_count;
+} CrossReference;
+
+void xref_enable(int enabled);
+int xref_enabled(void);
+
+// Index of the last analysis run, valid until the next run or
+// free_program_symbols(). Empty after the parallel checkers (semantic.h).
+const CrossReference* get_cross_reference(void);
+
+// Sites of one kind for a symbol; *count may be 0.
+const XrefSite* xref_sites(const CrossReference* xref, int symbol, XrefKind kind, int* count);
+int xref_count(const CrossReference* xref, int symbol, XrefKind kind);
+
+// Groups records (in any order) into the published index. Records keep their
+// nodes only if keep_nodes is set.
+void publish_cross_reference(const XrefRecord* records, int count, int symbol_count, int keep_nodes);
+void free_cross_reference(void);
+
+// Warn about variables that are never read: unused when they are not written
+// either, write-only otherwise. Returns the number of warnings.
+int report_unused_variables(FILE* out, const CrossReference* xref, const ProgramSymbols* program);
+
+#endif /* XREF_H */
@@ -0,0 +1,241 @@
+/* alloc.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../../include/alloc.h"
+
+#define MEM_HEADER_SIZE 16
+#define MAX_PHASES 16
+#define MAX_ALLOCATORS 8
+
+// Sits in front of every block; 16 bytes keeps the payload aligned.
+typedef struct {
+    size_t size;                 // Payload size
+    int subsystem;
+    int allocator;               // Index into allocators: the one that owns it
+} MemHeader;
+
+_Static_assert(sizeof(MemHeader) <= MEM_HEADER_SIZE, "MemHeader must fit its 16 bytes");
+
+typedef struct {
+    atomic_size_t allocations;
+    atomic_size_t frees;
+    atomic_size_t bytes_allocated;   // Cumulative
+    atomic_size_t live_bytes;
+    atomic_size_t live_blocks;
+    atomic_size_t peak_bytes;
+} MemCounters;
+
+typedef struct {
+    const char* name;
+    size_t start_bytes;
+    size_t peak_bytes;
+} MemPhase;
+
+static const char* subsystem_names[MEM_SUBSYSTEM_COUNT] = {
+    "io", "lexer", "parser", "ast", "dag", "symbols", "parallel", "export", "trace", "intern", "api", "ir"
+};
+
+static void* default_alloc(void* context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* default_realloc(void* context, void* block, size_t old_size, size_t new_size) {
+    (void)context;
+    (void)old_size;
+    return realloc(block, new_size);
+}
+
+static void default_free(void* context, void* block, size_t size) {
+    (void)context;
+    (void)size;
+    free(block);
+}
+
+// Every allocator ever installed, so a block is always resized and freed by
+// the one that allocated it, whichever is installed by then.
+static Allocator allocators[MAX_ALLOCATORS] = {{default_alloc, default_realloc, default_free, NULL}};
+static int allocator_count = 1;
+static int current = 0;
+
+static int tracking = 0;
+static MemCounters counters[MEM_SUBSYSTEM_COUNT];
+static atomic_size_t total_live;
+static atomic_size_t total_peak;
+static atomic_size_t phase_peak;
+static MemPhase phases[MAX_PHASES];
+static int phase_count = 0;
+static int phase_open = 0;
+
+int mem_set_allocator(const Allocator* allocator) {
+    if (!allocator) {
+        current = 0;
+        return 1;
+    }
+    for (int i = 0; i < allocator_count; i++) {
+        const Allocator* known = &allocators[i];
+        if (known->alloc == allocator->alloc && known->realloc == allocator->realloc &&
+            known->free == allocator->free && known->context == allocator->context) {
+            current = i;
+            return 1;
+        }
+    }
+    if (allocator_count == MAX_ALLOCATORS)
+        return 0;
+    allocators[allocator_count] = *allocator;
+    current = allocator_count++;
+    return 1;
+}
+
+const Allocator* mem_get_allocator(void) {
+    return &allocators[current];
+}
+
+static void raise_to(atomic_size_t* peak, size_t value) {
+    size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+    while (value > seen &&
+           !atomic_compare_exchange_weak_explicit(peak, &seen, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void track_alloc(int subsystem, size_t size) {
+    MemCounters* c = &counters[subsystem];
+    atomic_fetch_add_explicit(&c->allocations, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->bytes_allocated, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->live_blocks, 1, memory_order_relaxed);
+    size_t live = atomic_fetch_add_explicit(&c->live_bytes, size, memory_order_relaxed) + size;
+    raise_to(&c->peak_bytes, live);
+    size_t total = atomic_fetch_add_explicit(&total_live, size, memory_order_relaxed) + size;
+    raise_to(&total_peak, total);
+    raise_to(&phase_peak, total);
+}
+
+static void track_free(int subsystem, size_t size) {
+    MemCounters* c = &counters[subsystem];
+    atomic_fetch_add_explicit(&c->frees, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&c->live_blocks, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&c->live_bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&total_live, size, memory_order_relaxed);
+}
+
+void* mem_alloc(MemSubsystem subsystem, size_t size) {
+    const Allocator* owner = &allocators[current];
+    MemHeader* header = owner->alloc(owner->context, MEM_HEADER_SIZE + size);
+    if (!header)
+        return NULL;
+    header->size = size;
+    header->subsystem = subsystem;
+    header->allocator = current;
+    if (tracking)
+        track_alloc(subsystem, size);
+    return (char*)header + MEM_HEADER_SIZE;
+}
+
+void* mem_calloc(MemSubsystem subsystem, size_t count, size_t size) {
+    if (size && count > ((size_t)-1 - MEM_HEADER_SIZE) / size)
+        return NULL;
+    void* block = mem_alloc(subsystem, count * size);
+    if (block)
+        memset(block, 0, count * size);
+    return block;
+}
+
+void* mem_realloc(MemSubsystem subsystem, void* block, size_t size) {
+    if (!block)
+        return mem_alloc(subsystem, size);
+    MemHeader* header = (MemHeader*)((char*)block - MEM_HEADER_SIZE);
+    size_t old_size = header->size;
+    int old_subsystem = header->subsystem;
+    const Allocator* owner = &allocators[header->allocator];
+    header = owner->realloc(owner->context, header, MEM_HEADER_SIZE + old_size, MEM_HEADER_SIZE + size);
+    if (!header)
+        return NULL;
+    header->size = size;
+    header->subsystem = subsystem;
+    if (tracking) {
+        track_free(old_subsystem, old_size);
+        track_alloc(subsystem, size);
+    }
+    return (char*)header + MEM_HEADER_SIZE;
+}
+
+void mem_free(void* block) {
+    if (!block)
+        return;
+    MemHeader* header = (MemHeader*)((char*)block - MEM_HEADER_SIZE);
+    if (tracking)
+        track_free(header->subsystem, header->size);
+    const Allocator* owner = &allocators[header->allocator];
+    owner->free(owner->context, header, MEM_HEADER_SIZE + header->size);
+}
+
+// --------------------------------------------------------------------------
+// Tracking and reports
+// --------------------------------------------------------------------------
+
+void mem_tracking_enable(int enabled) {
+    tracking = enabled;
+}
+
+size_t mem_live_bytes(void) {
+    return atomic_load(&total_live);
+}
+
+void mem_phase_begin(const char* name) {
+    if (phase_open)
+        mem_phase_end();
+    if (phase_count == MAX_PHASES)
+        return;
+    size_t live = atomic_load(&total_live);
+    atomic_store(&phase_peak, live);
+    phases[phase_count].name = name;
+    phases[phase_count].start_bytes = live;
+    phase_open = 1;
+}
+
+void mem_phase_end(void) {
+    if (!phase_open)
+        return;
+    phases[phase_count].peak_bytes = atomic_load(&phase_peak);
+    phase_count++;
+    phase_open = 0;
+}
+
+void mem_report(FILE* out) {
+    if (phase_open)
+        mem_phase_end();
+    fprintf(out, "== MEMORY REPORT ==\n");
+    fprintf(out, "%-10s %12s %12s %14s %12s %12s\n",
+            "subsystem", "allocs", "frees", "bytes", "peak", "live");
+    size_t live_blocks = 0;
+    for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+        MemCounters* c = &counters[i];
+        if (!atomic_load(&c->allocations))
+            continue;
+        fprintf(out, "%-10s %12zu %12zu %14zu %12zu %12zu\n", subsystem_names[i],
+                atomic_load(&c->allocations), atomic_load(&c->frees),
+                atomic_load(&c->bytes_allocated), atomic_load(&c->peak_bytes),
+                atomic_load(&c->live_bytes));
+        live_blocks += atomic_load(&c->live_blocks);
+    }
+    fprintf(out, "Peak live bytes: %zu\n", atomic_load(&total_peak));
+    for (int i = 0; i < phase_count; i++) {
+        fprintf(out, "Phase %-10s start %12zu  peak %12zu\n", phases[i].name,
+                phases[i].start_bytes, phases[i].peak_bytes);
+    }
+    if (live_blocks) {
+        fprintf(out, "Still live: %zu bytes in %zu blocks\n", atomic_load(&total_live), live_blocks);
+        for (int i = 0; i < MEM_SUBSYSTEM_COUNT; i++) {
+            size_t blocks = atomic_load(&counters[i].live_blocks);
+            if (blocks)
+                fprintf(out, "  %-10s %zu bytes in %zu blocks\n", subsystem_names[i],
+                        atomic_load(&counters[i].live_bytes), blocks);
+        }
+    } else {
+        fprintf(out, "No live allocations.\n");
+    }
+    fprintf(out, "===================\n");
+}
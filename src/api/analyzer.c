@@ -0,0 +1,167 @@
+/* analyzer.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "../../include/analyzer.h"
+#include "../../include/parser.h"
+#include "../../include/lexer.h"
+#include "../../include/dag.h"
+#include "../../include/xref.h"
+
+struct AnalyzerContext {
+    char* input;             // NUL-terminated copy of the last buffer
+    size_t input_capacity;
+    AnalyzerDiagnostic* diagnostics;
+    int diagnostic_count;
+    int diagnostic_capacity;
+    ASTNode* ast;            // Kept tree of the last run
+    AnalyzerResult result;
+    const Allocator* previous; // Installed before analyzer_create
+};
+
+static int context_open = 0;
+
+AnalyzerContext* analyzer_create(const Allocator* allocator) {
+    if (context_open)
+        return NULL;
+    const Allocator* previous = mem_get_allocator();
+    if (!mem_set_allocator(allocator))
+        return NULL;
+    AnalyzerContext* context = mem_calloc(MEM_API, 1, sizeof(AnalyzerContext));
+    if (!context) {
+        mem_set_allocator(previous);
+        return NULL;
+    }
+    context->previous = previous;
+    context_open = 1;
+    return context;
+}
+
+void analyzer_destroy(AnalyzerContext* context) {
+    if (!context)
+        return;
+    const Allocator* previous = context->previous;
+    free_ast(context->ast);
+    free_program_symbols();
+    free_line_index();
+    dag_free();
+    mem_free(context->input);
+    mem_free(context->diagnostics);
+    mem_free(context);
+    mem_set_allocator(previous);
+    context_open = 0;
+}
+
+// --------------------------------------------------------------------------
+// Diagnostics
+// --------------------------------------------------------------------------
+
+// Next free diagnostic, or NULL if the array cannot grow (it is then dropped).
+static AnalyzerDiagnostic* add_diagnostic(AnalyzerContext* context, AnalyzerDiagnosticKind kind, int line) {
+    if (context->diagnostic_count == context->diagnostic_capacity) {
+        int new_capacity = context->diagnostic_capacity ? context->diagnostic_capacity * 2 : 16;
+        AnalyzerDiagnostic* grown = mem_realloc(MEM_API, context->diagnostics,
+                                                new_capacity * sizeof(AnalyzerDiagnostic));
+        if (!grown)
+            return NULL;
+        context->diagnostics = grown;
+        context->diagnostic_capacity = new_capacity;
+    }
+    AnalyzerDiagnostic* diagnostic = &context->diagnostics[context->diagnostic_count++];
+    diagnostic->kind = kind;
+    diagnostic->line = line;
+    return diagnostic;
+}
+
+static void keep_semantic_error(void* context, SemanticErrorType error, const char* name, int line) {
+    AnalyzerDiagnostic* diagnostic = add_diagnostic(context, ANALYZER_SEMANTIC, line);
+    if (diagnostic)
+        format_semantic_error(diagnostic->message, sizeof(diagnostic->message), error, name, line);
+}
+
+static void keep_parse_error(void* context, int line, const char* message) {
+    AnalyzerDiagnostic* diagnostic = add_diagnostic(context, ANALYZER_SYNTAX, line);
+    if (diagnostic)
+        snprintf(diagnostic->message, sizeof(diagnostic->message), "%s", message);
+}
+
+// --------------------------------------------------------------------------
+// Runs
+// --------------------------------------------------------------------------
+
+static int copy_input(AnalyzerContext* context, const char* buffer, size_t length) {
+    if (length + 1 > context->input_capacity) {
+        char* grown = mem_realloc(MEM_API, context->input, length + 1);
+        if (!grown)
+            return 0;
+        context->input = grown;
+        context->input_capacity = length + 1;
+    }
+    memcpy(context->input, buffer, length);
+    context->input[length] = '\0';
+    return 1;
+}
+
+const AnalyzerResult* analyzer_run(AnalyzerContext* context, const char* buffer, size_t length,
+                                   const AnalyzerOptions* options) {
+    static const AnalyzerOptions defaults = {0};
+    const AnalyzerOptions settings = options ? *options : defaults;
+
+    // The previous result goes first, so its memory is reused
+    free_ast(context->ast);
+    context->ast = NULL;
+    free_program_symbols();
+    context->diagnostic_count = 0;
+    memset(&context->result, 0, sizeof(context->result));
+    if (!copy_input(context, buffer, length))
+        return NULL;
+
+    int recorded = xref_enabled();
+    xref_enable(settings.cross_reference);
+    dag_enable(0);
+    set_symbol_table_dump(0);
+    set_diagnostic_sink(keep_semantic_error, context);
+    set_parse_error_sink(keep_parse_error, context);
+
+    jmp_buf recovery;
+    ASTNode* ast = NULL;
+    int ok = 0;
+    if (setjmp(recovery) == 0) {
+        parser_set_recovery(&recovery);
+        parser_init(context->input);
+        if (settings.fused) {
+            ok = analyze_fused(settings.keep_ast ? &ast : NULL);
+        } else {
+            ast = parse();
+            ok = analyze_semantics(ast);
+        }
+    } else {
+        // The parser freed its unfinished tree before jumping back
+        abandon_analysis();
+        ast = NULL;
+        context->result.aborted = 1;
+    }
+    parser_set_recovery(NULL);
+    parser_close();
+
+    set_parse_error_sink(NULL, NULL);
+    set_diagnostic_sink(NULL, NULL);
+    set_symbol_table_dump(1);
+    xref_enable(recorded);
+
+    if (settings.keep_ast)
+        context->ast = ast;
+    else
+        free_ast(ast);
+
+    for (int i = 0; i < context->diagnostic_count; i++)
+        if (context->diagnostics[i].kind == ANALYZER_SYNTAX)
+            ok = 0;
+    context->result.ok = ok && !context->result.aborted;
+    context->result.diagnostics = context->diagnostics;
+    context->result.diagnostic_count = context->diagnostic_count;
+    context->result.symbols = get_program_symbols();
+    context->result.ast = context->ast;
+    return &context->result;
+}
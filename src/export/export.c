@@ -0,0 +1,265 @@
+/* export.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/export.h"
+#include "../../include/lexer.h"
+#include "../../include/alloc.h"
+
+static const char* node_type_names[] = {
+    "Program", "VarDecl", "Assign", "Print", "Number", "Identifier", "BinaryOp",
+    "If", "Else", "While", "Repeat", "Block", "FunctionCall", "Read"
+};
+
+// --------------------------------------------------------------------------
+// Buffered writer
+// --------------------------------------------------------------------------
+
+int export_writer_open(ExportWriter* writer, FILE* out, size_t capacity) {
+    writer->out = out;
+    writer->length = 0;
+    writer->capacity = capacity < 64 ? 64 : capacity;
+    writer->error = 0;
+    writer->data = mem_alloc(MEM_EXPORT, writer->capacity);
+    return writer->data != NULL;
+}
+
+void export_flush(ExportWriter* writer) {
+    if (writer->length && fwrite(writer->data, 1, writer->length, writer->out) != writer->length)
+        writer->error = 1;
+    writer->length = 0;
+}
+
+int export_writer_close(ExportWriter* writer) {
+    export_flush(writer);
+    if (fflush(writer->out) != 0)
+        writer->error = 1;
+    mem_free(writer->data);
+    writer->data = NULL;
+    return writer->error ? -1 : 0;
+}
+
+static void put_bytes(ExportWriter* writer, const void* bytes, size_t count) {
+    const unsigned char* src = bytes;
+    while (count) {
+        if (writer->length == writer->capacity)
+            export_flush(writer);
+        size_t room = writer->capacity - writer->length;
+        size_t chunk = count < room ? count : room;
+        memcpy(writer->data + writer->length, src, chunk);
+        writer->length += chunk;
+        src += chunk;
+        count -= chunk;
+    }
+}
+
+// Small writes reserve their worst case up front and then fill in place.
+static unsigned char* reserve(ExportWriter* writer, size_t count) {
+    if (writer->capacity - writer->length < count)
+        export_flush(writer);
+    return writer->data + writer->length;
+}
+
+static void put_u8(ExportWriter* writer, unsigned value) {
+    *reserve(writer, 1) = (unsigned char)value;
+    writer->length++;
+}
+
+static void put_varint(ExportWriter* writer, unsigned long long value) {
+    unsigned char* p = reserve(writer, 10);
+    size_t n = 0;
+    do {
+        unsigned char byte = value & 0x7f;
+        value >>= 7;
+        p[n++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    writer->length += n;
+}
+
+static void put_text(ExportWriter* writer, const char* text) {
+    put_bytes(writer, text, strlen(text));
+}
+
+static void put_int(ExportWriter* writer, long long value) {
+    char digits[24];
+    int n = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    unsigned char* p = reserve(writer, 21);
+    size_t length = 0;
+    if (value < 0)
+        p[length++] = '-';
+    while (n)
+        p[length++] = digits[--n];
+    writer->length += length;
+}
+
+static void put_json_string(ExportWriter* writer, const char* text) {
+    static const char hex[] = "0123456789abcdef";
+    put_u8(writer, '"');
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            unsigned char* p = reserve(writer, 2);
+            p[0] = '\\';
+            p[1] = *c;
+            writer->length += 2;
+        } else if (*c < 0x20) {
+            unsigned char* p = reserve(writer, 6);
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[*c >> 4];
+            p[5] = hex[*c & 15];
+            writer->length += 6;
+        } else {
+            put_u8(writer, *c);
+        }
+    }
+    put_u8(writer, '"');
+}
+
+// --------------------------------------------------------------------------
+// Binary export
+// --------------------------------------------------------------------------
+
+// Statement chains are walked iteratively; only left/right children nest.
+static void write_binary_chain(ExportWriter* writer, const ASTNode* node) {
+    for (; node; node = node->next) {
+        unsigned flags = (node->left ? EXPORT_HAS_LEFT : 0) |
+                         (node->right ? EXPORT_HAS_RIGHT : 0) |
+                         (node->next ? EXPORT_HAS_NEXT : 0);
+        char text[TOKEN_TEXT_SIZE];
+        size_t lexeme_length = strlen(token_text(&node->token, text, sizeof(text)));
+        put_u8(writer, node->type);
+        put_u8(writer, flags);
+        put_u8(writer, node->token.type);
+        put_varint(writer, (unsigned)node->token.offset);
+        put_varint(writer, (unsigned)(node->symbol_id + 1));
+        put_varint(writer, (unsigned)(node->slot + 1));
+        put_varint(writer, lexeme_length);
+        put_bytes(writer, text, lexeme_length);
+        if (node->left)
+            write_binary_chain(writer, node->left);
+        if (node->right)
+            write_binary_chain(writer, node->right);
+    }
+}
+
+void export_ast_binary(ExportWriter* writer, const ASTNode* ast) {
+    put_bytes(writer, "SAST", 4);
+    put_u8(writer, EXPORT_FORMAT_VERSION);
+    if (!ast) {
+        // An empty program is a lone Program node, as parse() returns it.
+        static const ASTNode empty = {AST_PROGRAM, {TOKEN_EOF, OP_NONE, ERROR_NONE, 0, 0, 0}, NULL, NULL, NULL, -1, -1, -1};
+        ast = &empty;
+    }
+    write_binary_chain(writer, ast);
+}
+
+void export_symbols_binary(ExportWriter* writer, const ProgramSymbols* program) {
+    put_bytes(writer, "SSYM", 4);
+    put_u8(writer, EXPORT_FORMAT_VERSION);
+    put_varint(writer, (unsigned)program->symbol_count);
+    put_varint(writer, (unsigned)program->scope_count);
+    for (int i = 0; i < program->symbol_count; i++) {
+        const ResolvedSymbol* sym = &program->symbols[i];
+        size_t name_length = strlen(sym->name);
+        put_varint(writer, name_length);
+        put_bytes(writer, sym->name, name_length);
+        put_varint(writer, (unsigned)sym->type);
+        put_varint(writer, (unsigned)sym->scope);
+        put_varint(writer, (unsigned)sym->scope_level);
+        put_varint(writer, (unsigned)sym->slot);
+        put_varint(writer, (unsigned)sym->line_declared);
+        put_u8(writer, sym->is_initialized ? 1 : 0);
+    }
+    for (int i = 0; i < program->scope_count; i++) {
+        const ScopeRange* scope = &program->scopes[i];
+        put_varint(writer, (unsigned)(scope->parent + 1));
+        put_varint(writer, (unsigned)scope->level);
+        put_varint(writer, (unsigned)scope->first_symbol);
+        put_varint(writer, (unsigned)scope->end_symbol);
+        put_varint(writer, (unsigned)scope->frame_size);
+    }
+}
+
+// --------------------------------------------------------------------------
+// JSON lines export
+// --------------------------------------------------------------------------
+
+static long write_json_chain(ExportWriter* writer, const ASTNode* node, long next_id,
+                             long parent, const char* edge) {
+    char text[TOKEN_TEXT_SIZE];
+    for (; node; node = node->next) {
+        long id = next_id++;
+        put_text(writer, "{\"kind\":\"node\",\"id\":");
+        put_int(writer, id);
+        put_text(writer, ",\"parent\":");
+        put_int(writer, parent);
+        put_text(writer, ",\"edge\":\"");
+        put_text(writer, edge);
+        put_text(writer, "\",\"type\":\"");
+        put_text(writer, node->type <= AST_READ ? node_type_names[node->type] : "Unknown");
+        put_text(writer, "\",\"lexeme\":");
+        put_json_string(writer, token_text(&node->token, text, sizeof(text)));
+        put_text(writer, ",\"line\":");
+        put_int(writer, token_line(node->token));
+        put_text(writer, ",\"column\":");
+        put_int(writer, token_column(node->token));
+        if (node->symbol_id >= 0) {
+            put_text(writer, ",\"symbol\":");
+            put_int(writer, node->symbol_id);
+            put_text(writer, ",\"slot\":");
+            put_int(writer, node->slot);
+        }
+        put_text(writer, "}\n");
+        if (node->left)
+            next_id = write_json_chain(writer, node->left, next_id, id, "left");
+        if (node->right)
+            next_id = write_json_chain(writer, node->right, next_id, id, "right");
+        parent = id;
+        edge = "next";
+    }
+    return next_id;
+}
+
+void export_ast_jsonl(ExportWriter* writer, const ASTNode* ast) {
+    write_json_chain(writer, ast, 0, -1, "root");
+}
+
+void export_symbols_jsonl(ExportWriter* writer, const ProgramSymbols* program) {
+    for (int i = 0; i < program->scope_count; i++) {
+        const ScopeRange* scope = &program->scopes[i];
+        put_text(writer, "{\"kind\":\"scope\",\"id\":");
+        put_int(writer, i);
+        put_text(writer, ",\"parent\":");
+        put_int(writer, scope->parent);
+        put_text(writer, ",\"level\":");
+        put_int(writer, scope->level);
+        put_text(writer, ",\"first_symbol\":");
+        put_int(writer, scope->first_symbol);
+        put_text(writer, ",\"end_symbol\":");
+        put_int(writer, scope->end_symbol);
+        put_text(writer, ",\"frame_size\":");
+        put_int(writer, scope->frame_size);
+        put_text(writer, "}\n");
+    }
+    for (int i = 0; i < program->symbol_count; i++) {
+        const ResolvedSymbol* sym = &program->symbols[i];
+        put_text(writer, "{\"kind\":\"symbol\",\"id\":");
+        put_int(writer, i);
+        put_text(writer, ",\"name\":");
+        put_json_string(writer, sym->name);
+        put_text(writer, sym->type == TOKEN_INT ? ",\"type\":\"int\"" : ",\"type\":\"unknown\"");
+        put_text(writer, ",\"scope\":");
+        put_int(writer, sym->scope);
+        put_text(writer, ",\"level\":");
+        put_int(writer, sym->scope_level);
+        put_text(writer, ",\"slot\":");
+        put_int(writer, sym->slot);
+        put_text(writer, ",\"line\":");
+        put_int(writer, sym->line_declared);
+        put_text(writer, sym->is_initialized ? ",\"initialized\":true}\n" : ",\"initialized\":false}\n");
+    }
+}
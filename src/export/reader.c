@@ -0,0 +1,164 @@
+/* reader.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/export.h"
+#include "../../include/lexer.h"
+#include "../../include/alloc.h"
+#include "../../include/intern.h"
+
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+    size_t pos;
+    int error;
+} Reader;
+
+static unsigned get_u8(Reader* reader) {
+    if (reader->pos >= reader->size) {
+        reader->error = 1;
+        return 0;
+    }
+    return reader->data[reader->pos++];
+}
+
+static unsigned long long get_varint(Reader* reader) {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned byte = get_u8(reader);
+        value |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    reader->error = 1;
+    return 0;
+}
+
+static int get_string(Reader* reader, char* out, size_t out_size) {
+    unsigned long long length = get_varint(reader);
+    if (reader->error || length >= out_size || length > reader->size - reader->pos) {
+        reader->error = 1;
+        return 0;
+    }
+    memcpy(out, reader->data + reader->pos, length);
+    out[length] = '\0';
+    reader->pos += length;
+    return 1;
+}
+
+static int expect_header(Reader* reader, const char* magic) {
+    if (reader->size - reader->pos < 5 || memcmp(reader->data + reader->pos, magic, 4) != 0)
+        return 0;
+    reader->pos += 4;
+    return get_u8(reader) == EXPORT_FORMAT_VERSION;
+}
+
+// Mirrors write_binary_chain: next links are followed iteratively.
+static ASTNode* read_chain(Reader* reader) {
+    ASTNode* first = NULL;
+    ASTNode** link = &first;
+    unsigned flags;
+    do {
+        ASTNode* node = mem_calloc(MEM_AST, 1, sizeof(ASTNode));
+        if (!node) {
+            reader->error = 1;
+            break;
+        }
+        *link = node;
+        unsigned type = get_u8(reader);
+        flags = get_u8(reader);
+        unsigned token_type = get_u8(reader);
+        node->type = (ASTNodeType)type;
+        node->token.type = (TokenType)token_type;
+        node->token.offset = (int)get_varint(reader);
+        node->token.error = ERROR_NONE;
+        node->symbol_id = (int)get_varint(reader) - 1;
+        node->slot = (int)get_varint(reader) - 1;
+        node->dag_id = -1;
+        char text[TOKEN_TEXT_SIZE];
+        // A tree never holds error tokens, which parsing rejects
+        if (!get_string(reader, text, sizeof(text)) || type > AST_READ || token_type >= TOKEN_ERROR ||
+            !token_decode(&node->token, text))
+            reader->error = 1;
+        if (reader->error)
+            break;
+        if (flags & EXPORT_HAS_LEFT)
+            node->left = read_chain(reader);
+        if (flags & EXPORT_HAS_RIGHT)
+            node->right = read_chain(reader);
+        link = &node->next;
+    } while (!reader->error && (flags & EXPORT_HAS_NEXT));
+    return first;
+}
+
+ASTNode* read_ast_binary(const unsigned char* data, size_t size, size_t* consumed) {
+    Reader reader = {data, size, 0, 0};
+    if (!expect_header(&reader, "SAST"))
+        return NULL;
+    ASTNode* ast = read_chain(&reader);
+    if (reader.error) {
+        free_ast(ast);
+        return NULL;
+    }
+    if (consumed)
+        *consumed = reader.pos;
+    return ast;
+}
+
+int read_symbols_binary(const unsigned char* data, size_t size, size_t* consumed,
+                        ProgramSymbols* program) {
+    Reader reader = {data, size, 0, 0};
+    memset(program, 0, sizeof(*program));
+    if (!expect_header(&reader, "SSYM"))
+        return 0;
+    unsigned long long symbol_count = get_varint(&reader);
+    unsigned long long scope_count = get_varint(&reader);
+    // Every record takes at least one byte per field, which bounds the counts.
+    if (reader.error || symbol_count > size || scope_count > size)
+        return 0;
+    program->symbols = mem_calloc(MEM_EXPORT, symbol_count ? symbol_count : 1, sizeof(ResolvedSymbol));
+    program->scopes = mem_calloc(MEM_EXPORT, scope_count ? scope_count : 1, sizeof(ScopeRange));
+    if (!program->symbols || !program->scopes) {
+        free_read_symbols(program);
+        return 0;
+    }
+    program->symbol_count = program->symbol_capacity = (int)symbol_count;
+    program->scope_count = program->scope_capacity = (int)scope_count;
+    for (int i = 0; i < program->symbol_count && !reader.error; i++) {
+        ResolvedSymbol* sym = &program->symbols[i];
+        char name[100];
+        if (!get_string(&reader, name, sizeof(name)) || (sym->name_id = intern_name(name)) < 0) {
+            reader.error = 1;
+            break;
+        }
+        sym->name = intern_string(sym->name_id);
+        sym->type = (int)get_varint(&reader);
+        sym->scope = (int)get_varint(&reader);
+        sym->scope_level = (int)get_varint(&reader);
+        sym->slot = (int)get_varint(&reader);
+        sym->line_declared = (int)get_varint(&reader);
+        sym->is_initialized = (int)get_u8(&reader);
+        sym->declared_at = sym->initialized_at = -1;
+    }
+    for (int i = 0; i < program->scope_count && !reader.error; i++) {
+        ScopeRange* scope = &program->scopes[i];
+        scope->parent = (int)get_varint(&reader) - 1;
+        scope->level = (int)get_varint(&reader);
+        scope->first_symbol = (int)get_varint(&reader);
+        scope->end_symbol = (int)get_varint(&reader);
+        scope->frame_size = (int)get_varint(&reader);
+    }
+    if (reader.error) {
+        free_read_symbols(program);
+        return 0;
+    }
+    if (consumed)
+        *consumed = reader.pos;
+    return 1;
+}
+
+void free_read_symbols(ProgramSymbols* program) {
+    mem_free(program->symbols);
+    mem_free(program->scopes);
+    memset(program, 0, sizeof(*program));
+}
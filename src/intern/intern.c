@@ -0,0 +1,230 @@
+/* intern.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#ifndef SEMANTIC_NO_THREADS
+#include <pthread.h>
+#endif
+#include "../../include/intern.h"
+#include "../../include/alloc.h"
+
+#define CHUNK_BITS 12                // Ids per chunk of the id directory
+#define CHUNK_SIZE (1 << CHUNK_BITS)
+#define MAX_CHUNKS 16384             // Up to 64M names
+#define SHARD_BITS 6                 // log2(INTERN_SHARDS)
+
+typedef struct {
+    unsigned hash;
+    int id;
+    size_t length;
+    char text[];
+} InternEntry;
+
+typedef struct InternTable {
+    unsigned capacity;               // Power of two
+    struct InternTable* retired;     // Older tables of the same shard
+    _Atomic(InternEntry*) slots[];
+} InternTable;
+
+// Shards sit on their own cache lines so inserts in one do not slow reads
+// in another.
+typedef struct {
+    _Alignas(64) _Atomic(InternTable*) table;
+    int count;                       // Entries; guarded by lock
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_t lock;
+#endif
+} InternShard;
+
+static InternShard shards[INTERN_SHARDS];
+static atomic_int next_id = 0;
+static _Atomic(_Atomic(InternEntry*)*) chunks[MAX_CHUNKS];
+
+#ifndef SEMANTIC_NO_THREADS
+static pthread_once_t locks_ready = PTHREAD_ONCE_INIT;
+
+static void init_locks(void) {
+    for (int i = 0; i < INTERN_SHARDS; i++)
+        pthread_mutex_init(&shards[i].lock, NULL);
+}
+#define LOCK(shard) (pthread_once(&locks_ready, init_locks), pthread_mutex_lock(&(shard)->lock))
+#define UNLOCK(shard) pthread_mutex_unlock(&(shard)->lock)
+#else
+#define LOCK(shard) ((void)(shard))
+#define UNLOCK(shard) ((void)(shard))
+#endif
+
+static unsigned hash_name(const char* name, size_t length) {
+    unsigned hash = 2166136261u;
+    const unsigned char* c = (const unsigned char*)name;
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ c[i]) * 16777619u;
+    return hash;
+}
+
+// Probe for name; returns its entry, or NULL with *empty set to the free slot.
+static InternEntry* probe(InternTable* table, const char* name, size_t length, unsigned hash,
+                          unsigned* empty) {
+    unsigned mask = table->capacity - 1;
+    unsigned i = (hash >> SHARD_BITS) & mask;
+    for (;;) {
+        InternEntry* entry = atomic_load_explicit(&table->slots[i], memory_order_acquire);
+        if (!entry) {
+            *empty = i;
+            return NULL;
+        }
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, name, length) == 0)
+            return entry;
+        i = (i + 1) & mask;
+    }
+}
+
+int intern_lookup(const char* name) {
+    size_t length = strlen(name);
+    unsigned hash = hash_name(name, length);
+    InternShard* shard = &shards[hash & (INTERN_SHARDS - 1)];
+    InternTable* table = atomic_load_explicit(&shard->table, memory_order_acquire);
+    unsigned empty;
+    InternEntry* entry = table ? probe(table, name, length, hash, &empty) : NULL;
+    return entry ? entry->id : -1;
+}
+
+// --------------------------------------------------------------------------
+// Inserts (shard lock held)
+// --------------------------------------------------------------------------
+
+static InternTable* new_table(unsigned capacity) {
+    InternTable* table = mem_calloc(MEM_INTERN, 1, sizeof(InternTable) + capacity * sizeof(InternEntry*));
+    if (table)
+        table->capacity = capacity;
+    return table;
+}
+
+// Rehash into a table twice the size and publish it. Readers still probing
+// the old one find every entry it had, and it is kept until intern_free.
+static InternTable* grow_table(InternShard* shard, InternTable* old) {
+    InternTable* table = new_table(old ? old->capacity * 2 : 64);
+    if (!table)
+        return NULL;
+    if (old) {
+        for (unsigned i = 0; i < old->capacity; i++) {
+            InternEntry* entry = atomic_load_explicit(&old->slots[i], memory_order_relaxed);
+            if (!entry)
+                continue;
+            unsigned j = (entry->hash >> SHARD_BITS) & (table->capacity - 1);
+            while (atomic_load_explicit(&table->slots[j], memory_order_relaxed))
+                j = (j + 1) & (table->capacity - 1);
+            atomic_store_explicit(&table->slots[j], entry, memory_order_relaxed);
+        }
+        table->retired = old;
+    }
+    atomic_store_explicit(&shard->table, table, memory_order_release);
+    return table;
+}
+
+static _Atomic(InternEntry*)* id_slot(int id) {
+    _Atomic(_Atomic(InternEntry*)*)* chunk = &chunks[id >> CHUNK_BITS];
+    _Atomic(InternEntry*)* slots = atomic_load_explicit(chunk, memory_order_acquire);
+    if (!slots) {
+        _Atomic(InternEntry*)* fresh = mem_calloc(MEM_INTERN, CHUNK_SIZE, sizeof(InternEntry*));
+        if (!fresh)
+            return NULL;
+        if (atomic_compare_exchange_strong(chunk, &slots, fresh))
+            slots = fresh;
+        else
+            mem_free(fresh);     // Another shard's insert got there first
+    }
+    return &slots[id & (CHUNK_SIZE - 1)];
+}
+
+int intern_name(const char* name) {
+    return intern_name_length(name, strlen(name));
+}
+
+int intern_name_length(const char* name, size_t length) {
+    unsigned hash = hash_name(name, length);
+    InternShard* shard = &shards[hash & (INTERN_SHARDS - 1)];
+    unsigned empty;
+    InternTable* table = atomic_load_explicit(&shard->table, memory_order_acquire);
+    InternEntry* entry = table ? probe(table, name, length, hash, &empty) : NULL;
+    if (entry)
+        return entry->id;
+
+    LOCK(shard);
+    int id = -1;
+    table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    if (table && (entry = probe(table, name, length, hash, &empty)) != NULL) {
+        id = entry->id;   // Inserted while we waited
+        goto done;
+    }
+    if (!table || (unsigned)(shard->count + 1) * 4 > table->capacity * 3) {
+        if (!(table = grow_table(shard, table)))
+            goto done;
+        probe(table, name, length, hash, &empty);
+    }
+    if (atomic_load_explicit(&next_id, memory_order_relaxed) >= MAX_CHUNKS * CHUNK_SIZE)
+        goto done;
+    entry = mem_alloc(MEM_INTERN, sizeof(InternEntry) + length + 1);
+    if (!entry)
+        goto done;
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->text, name, length);
+    entry->text[length] = '\0';
+    entry->id = atomic_fetch_add_explicit(&next_id, 1, memory_order_relaxed);
+    _Atomic(InternEntry*)* slot = id_slot(entry->id);
+    if (!slot) {
+        // The id is burned; the directory simply keeps a hole there
+        mem_free(entry);
+        goto done;
+    }
+    // The id slot is filled before the name becomes findable, so anyone who
+    // obtained the id can resolve it.
+    atomic_store_explicit(slot, entry, memory_order_release);
+    atomic_store_explicit(&table->slots[empty], entry, memory_order_release);
+    shard->count++;
+    id = entry->id;
+done:
+    UNLOCK(shard);
+    return id;
+}
+
+const char* intern_string(int id) {
+    _Atomic(InternEntry*)* slots = atomic_load_explicit(&chunks[id >> CHUNK_BITS], memory_order_acquire);
+    return atomic_load_explicit(&slots[id & (CHUNK_SIZE - 1)], memory_order_acquire)->text;
+}
+
+int intern_count(void) {
+    int count = 0;
+    for (int i = 0; i < INTERN_SHARDS; i++) {
+        LOCK(&shards[i]);
+        count += shards[i].count;
+        UNLOCK(&shards[i]);
+    }
+    return count;
+}
+
+void intern_free(void) {
+    int ids = atomic_load(&next_id);
+    for (int c = 0; c * CHUNK_SIZE < ids; c++) {
+        _Atomic(InternEntry*)* slots = atomic_load(&chunks[c]);
+        if (!slots)
+            continue;
+        for (int i = 0; i < CHUNK_SIZE; i++)
+            mem_free(atomic_load(&slots[i]));
+        mem_free(slots);
+        atomic_store(&chunks[c], NULL);
+    }
+    for (int s = 0; s < INTERN_SHARDS; s++) {
+        InternTable* table = atomic_load(&shards[s].table);
+        while (table) {
+            InternTable* older = table->retired;
+            mem_free(table);
+            table = older;
+        }
+        atomic_store(&shards[s].table, NULL);
+        shards[s].count = 0;
+    }
+    atomic_store(&next_id, 0);
+}
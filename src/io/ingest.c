@@ -0,0 +1,567 @@
+/* ingest.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifndef SEMANTIC_NO_THREADS
+#include <pthread.h>
+#endif
+#if defined(__linux__) && !defined(SEMANTIC_NO_IO_URING) && !defined(SEMANTIC_NO_THREADS)
+#define INGEST_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#include "../../include/ingest.h"
+#include "../../include/alloc.h"
+#include "../../include/trace.h"
+
+typedef struct Slot {
+    IngestFile file;         // First, so a released IngestFile is its Slot
+    size_t capacity;
+    size_t expected;         // Size when opened; reads stop there
+    int fd;
+    struct iovec iov;        // Target of the read in flight
+    struct Slot* next;       // Free list or ready queue
+} Slot;
+
+#ifdef INGEST_IO_URING
+typedef struct {
+    int fd;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;           // Same mapping as sq_ring on newer kernels
+    size_t cq_ring_size;
+    size_t sqes_size;
+    unsigned unsubmitted;
+} Uring;
+#endif
+
+struct Ingest {
+    const char* const* paths;
+    int count;
+    int next_path;           // Next path to open (reading side)
+    int handed_out;          // Files returned by ingest_next
+    int depth;
+    const char* backend;
+
+    Slot* slots;
+    int slot_count;
+    Slot* free_slots;        // The rest are guarded by lock
+    Slot* ready_head;
+    Slot* ready_tail;
+    atomic_int stop;         // Set by ingest_finish; read without the lock
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    int threaded;
+#endif
+#ifdef INGEST_IO_URING
+    Uring ring;
+    int use_uring;
+#endif
+};
+
+#ifndef SEMANTIC_NO_THREADS
+#define LOCK(ingest) pthread_mutex_lock(&(ingest)->lock)
+#define UNLOCK(ingest) pthread_mutex_unlock(&(ingest)->lock)
+#define SIGNAL(ingest) pthread_cond_broadcast(&(ingest)->changed)
+#define WAIT(ingest) pthread_cond_wait(&(ingest)->changed, &(ingest)->lock)
+#else
+#define LOCK(ingest) ((void)(ingest))
+#define UNLOCK(ingest) ((void)(ingest))
+#define SIGNAL(ingest) ((void)(ingest))
+#define WAIT(ingest) ((void)(ingest))
+#endif
+
+// --------------------------------------------------------------------------
+// Buffer pool and ready queue
+// --------------------------------------------------------------------------
+
+// A free slot; with wait set, blocks until the consumer releases one.
+static Slot* take_free(Ingest* ingest, int wait) {
+    LOCK(ingest);
+    while (!ingest->free_slots && wait && !atomic_load(&ingest->stop))
+        WAIT(ingest);
+    Slot* slot = ingest->free_slots;
+    if (slot)
+        ingest->free_slots = slot->next;
+    UNLOCK(ingest);
+    return slot;
+}
+
+#ifndef SEMANTIC_NO_THREADS
+// Only the loader threads hand files over
+static void queue_ready(Ingest* ingest, Slot* slot) {
+    slot->next = NULL;
+    LOCK(ingest);
+    if (ingest->ready_tail)
+        ingest->ready_tail->next = slot;
+    else
+        ingest->ready_head = slot;
+    ingest->ready_tail = slot;
+    SIGNAL(ingest);
+    UNLOCK(ingest);
+}
+#endif
+
+void ingest_release(Ingest* ingest, IngestFile* file) {
+    Slot* slot = (Slot*)file;
+    LOCK(ingest);
+    slot->next = ingest->free_slots;
+    ingest->free_slots = slot;
+    SIGNAL(ingest);
+    UNLOCK(ingest);
+}
+
+// --------------------------------------------------------------------------
+// Reading
+// --------------------------------------------------------------------------
+
+// Opens path index into slot, sized for the whole file. Returns 0 if the file
+// failed (file.error is set) and is ready to queue as it is.
+static int open_file(Ingest* ingest, Slot* slot, int index) {
+    slot->file.path = ingest->paths[index];
+    slot->file.index = index;
+    slot->file.length = 0;
+    slot->file.error = 0;
+    slot->file.data[0] = '\0';
+    slot->fd = open(slot->file.path, O_RDONLY | O_CLOEXEC);
+    if (slot->fd < 0) {
+        slot->file.error = errno;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(slot->fd, &st) != 0)
+        slot->file.error = errno;
+    else if (!S_ISREG(st.st_mode))
+        slot->file.error = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+    if (slot->file.error) {
+        close(slot->fd);
+        slot->fd = -1;
+        return 0;
+    }
+    slot->expected = (size_t)st.st_size;
+    if (slot->expected + 1 > slot->capacity) {
+        char* grown = mem_realloc(MEM_IO, slot->file.data, slot->expected + 1);
+        if (!grown) {
+            slot->file.error = ENOMEM;
+            close(slot->fd);
+            slot->fd = -1;
+            return 0;
+        }
+        slot->file.data = grown;
+        slot->capacity = slot->expected + 1;
+    }
+    return 1;
+}
+
+static void close_file(Slot* slot) {
+    close(slot->fd);
+    slot->fd = -1;
+    slot->file.data[slot->file.length] = '\0';
+}
+
+static void read_blocking(Slot* slot) {
+    while (slot->file.length < slot->expected) {
+        struct iovec iov = {slot->file.data + slot->file.length, slot->expected - slot->file.length};
+        ssize_t n = preadv(slot->fd, &iov, 1, (off_t)slot->file.length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            slot->file.error = errno;
+        if (n <= 0)
+            break;   // A file that shrank is taken as it now is
+        slot->file.length += (size_t)n;
+    }
+    close_file(slot);
+}
+
+#ifdef INGEST_IO_URING
+
+static int uring_init(Uring* ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+        return 0;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && ring->cq_ring_size > ring->sq_ring_size)
+        ring->sq_ring_size = ring->cq_ring_size;
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = single ? ring->sq_ring
+                           : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sq_ring != MAP_FAILED)
+            munmap(ring->sq_ring, ring->sq_ring_size);
+        if (!single && ring->cq_ring != MAP_FAILED)
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        if (ring->sqes != MAP_FAILED)
+            munmap(ring->sqes, ring->sqes_size);
+        close(ring->fd);
+        return 0;
+    }
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+static void uring_free(Uring* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+// Queue a read of the rest of slot's file; it is submitted by uring_wait.
+static void uring_read(Uring* ring, Slot* slot) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    slot->iov.iov_base = slot->file.data + slot->file.length;
+    slot->iov.iov_len = slot->expected - slot->file.length;
+    sqe->opcode = IORING_OP_READV;   // READ needs 5.6; READV works wherever io_uring does
+    sqe->fd = slot->fd;
+    sqe->off = slot->file.length;
+    sqe->addr = (uint64_t)(uintptr_t)&slot->iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)(uintptr_t)slot;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->unsubmitted++;
+}
+
+// Submit queued reads and wait for at least one completion.
+static void uring_wait(Uring* ring) {
+    for (;;) {
+        int submitted = (int)syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, 1,
+                                     IORING_ENTER_GETEVENTS, NULL, 0);
+        if (submitted >= 0) {
+            ring->unsubmitted -= (unsigned)submitted;
+            return;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            return;
+    }
+}
+
+// Handle every completion; returns how many files finished.
+static int uring_reap(Ingest* ingest, int queue) {
+    Uring* ring = &ingest->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    int finished = 0;
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+        Slot* slot = (Slot*)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        if (res > 0)
+            slot->file.length += (size_t)res;
+        if ((res > 0 && slot->file.length < slot->expected) || res == -EINTR || res == -EAGAIN) {
+            if (!atomic_load(&ingest->stop)) {
+                uring_read(ring, slot);   // Short read: go on from where it stopped
+                continue;
+            }
+        } else if (res < 0) {
+            slot->file.error = -res;
+        }
+        close_file(slot);
+        if (queue)
+            queue_ready(ingest, slot);
+        finished++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return finished;
+}
+
+static void read_with_uring(Ingest* ingest) {
+    int in_flight = 0;
+    while (!atomic_load(&ingest->stop) && (ingest->next_path < ingest->count || in_flight > 0)) {
+        while (in_flight < ingest->depth && ingest->next_path < ingest->count) {
+            // Only block for a buffer when no completion could free one
+            Slot* slot = take_free(ingest, in_flight == 0);
+            if (!slot)
+                break;
+            if (!open_file(ingest, slot, ingest->next_path++)) {
+                queue_ready(ingest, slot);
+            } else if (slot->expected == 0) {
+                close_file(slot);
+                queue_ready(ingest, slot);
+            } else {
+                uring_read(&ingest->ring, slot);
+                in_flight++;
+            }
+        }
+        if (in_flight > 0) {
+            uring_wait(&ingest->ring);
+            in_flight -= uring_reap(ingest, 1);
+        }
+    }
+    // Stopped early: the kernel still owns the buffers of reads in flight
+    while (in_flight > 0) {
+        uring_wait(&ingest->ring);
+        in_flight -= uring_reap(ingest, 0);
+    }
+}
+
+#endif /* INGEST_IO_URING */
+
+static void read_next_blocking(Ingest* ingest, Slot* slot) {
+    if (open_file(ingest, slot, ingest->next_path++))
+        read_blocking(slot);
+}
+
+#ifndef SEMANTIC_NO_THREADS
+static void* io_thread(void* arg) {
+    Ingest* ingest = arg;
+    TRACE_BEGIN("ingest");
+#ifdef INGEST_IO_URING
+    if (ingest->use_uring) {
+        read_with_uring(ingest);
+        TRACE_END();
+        return NULL;
+    }
+#endif
+    while (ingest->next_path < ingest->count) {
+        Slot* slot = take_free(ingest, 1);
+        if (!slot)
+            break;   // Stopped
+        read_next_blocking(ingest, slot);
+        queue_ready(ingest, slot);
+    }
+    TRACE_END();
+    return NULL;
+}
+#endif
+
+// --------------------------------------------------------------------------
+// Ingest
+// --------------------------------------------------------------------------
+
+Ingest* ingest_start(const char* const* paths, int count, const IngestOptions* options) {
+    IngestOptions settings = {INGEST_DEFAULT_DEPTH, INGEST_DEFAULT_BUFFERS, INGEST_DEFAULT_BUFFER_SIZE};
+    if (options)
+        settings = *options;
+    if (settings.buffers < 1)
+        settings.buffers = 1;
+    if (settings.depth < 1 || settings.depth > settings.buffers)
+        settings.depth = settings.buffers;
+    if (settings.buffer_size < 1)
+        settings.buffer_size = 1;
+
+    Ingest* ingest = mem_calloc(MEM_IO, 1, sizeof(Ingest));
+    if (!ingest)
+        return NULL;
+    ingest->paths = paths;
+    ingest->count = count;
+    ingest->depth = settings.depth;
+    ingest->slots = mem_calloc(MEM_IO, settings.buffers, sizeof(Slot));
+    if (!ingest->slots) {
+        mem_free(ingest);
+        return NULL;
+    }
+    for (int i = 0; i < settings.buffers; i++) {
+        Slot* slot = &ingest->slots[i];
+        slot->file.data = mem_alloc(MEM_IO, settings.buffer_size);
+        if (!slot->file.data)
+            break;
+        slot->capacity = settings.buffer_size;
+        slot->fd = -1;
+        slot->next = ingest->free_slots;
+        ingest->free_slots = slot;
+        ingest->slot_count++;
+    }
+    if (ingest->slot_count == 0) {
+        ingest_finish(ingest);
+        return NULL;
+    }
+
+    ingest->backend = "inline";
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_init(&ingest->lock, NULL);
+    pthread_cond_init(&ingest->changed, NULL);
+#ifdef INGEST_IO_URING
+    ingest->use_uring = uring_init(&ingest->ring, (unsigned)ingest->depth);
+#endif
+    ingest->threaded = pthread_create(&ingest->thread, NULL, io_thread, ingest) == 0;
+    if (ingest->threaded) {
+        ingest->backend = "preadv";
+#ifdef INGEST_IO_URING
+        if (ingest->use_uring)
+            ingest->backend = "io_uring";
+#endif
+    }
+#endif
+    return ingest;
+}
+
+IngestFile* ingest_next(Ingest* ingest) {
+    if (ingest->handed_out == ingest->count)
+        return NULL;
+#ifndef SEMANTIC_NO_THREADS
+    if (ingest->threaded) {
+        LOCK(ingest);
+        while (!ingest->ready_head)
+            WAIT(ingest);
+        Slot* slot = ingest->ready_head;
+        ingest->ready_head = slot->next;
+        if (!ingest->ready_head)
+            ingest->ready_tail = NULL;
+        UNLOCK(ingest);
+        ingest->handed_out++;
+        return &slot->file;
+    }
+#endif
+    Slot* slot = take_free(ingest, 0);
+    if (!slot)
+        return NULL;   // Every buffer is still held
+    read_next_blocking(ingest, slot);
+    ingest->handed_out++;
+    return &slot->file;
+}
+
+const char* ingest_backend(const Ingest* ingest) {
+    return ingest->backend;
+}
+
+void ingest_finish(Ingest* ingest) {
+    if (!ingest)
+        return;
+#ifndef SEMANTIC_NO_THREADS
+    if (ingest->threaded) {
+        LOCK(ingest);
+        atomic_store(&ingest->stop, 1);
+        SIGNAL(ingest);
+        UNLOCK(ingest);
+        pthread_join(ingest->thread, NULL);
+    }
+#ifdef INGEST_IO_URING
+    if (ingest->use_uring)
+        uring_free(&ingest->ring);
+#endif
+    if (ingest->slot_count > 0) {
+        pthread_cond_destroy(&ingest->changed);
+        pthread_mutex_destroy(&ingest->lock);
+    }
+#endif
+    for (int i = 0; i < ingest->slot_count; i++) {
+        if (ingest->slots[i].fd >= 0)
+            close(ingest->slots[i].fd);
+        mem_free(ingest->slots[i].file.data);
+    }
+    mem_free(ingest->slots);
+    mem_free(ingest);
+}
+
+// --------------------------------------------------------------------------
+// Path lists
+// --------------------------------------------------------------------------
+
+static int add_file(IngestPaths* list, const char* path) {
+    if (list->count == list->capacity) {
+        int new_capacity = list->capacity ? list->capacity * 2 : 64;
+        char** grown = mem_realloc(MEM_IO, list->paths, new_capacity * sizeof(char*));
+        if (!grown)
+            return 0;
+        list->paths = grown;
+        list->capacity = new_capacity;
+    }
+    size_t length = strlen(path);
+    char* copy = mem_alloc(MEM_IO, length + 1);
+    if (!copy)
+        return 0;
+    memcpy(copy, path, length + 1);
+    list->paths[list->count++] = copy;
+    return 1;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int add_directory(IngestPaths* list, const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir)
+        return 0;
+    IngestPaths names = {0};
+    struct dirent* entry;
+    int ok = 1;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            ok = add_file(&names, entry->d_name);
+    }
+    closedir(dir);
+    qsort(names.paths, names.count, sizeof(char*), compare_names);
+
+    size_t base = strlen(path);
+    while (base > 1 && path[base - 1] == '/')
+        base--;
+    for (int i = 0; ok && i < names.count; i++) {
+        size_t length = base + 1 + strlen(names.paths[i]);
+        char* child = mem_alloc(MEM_IO, length + 1);
+        if (!child) {
+            ok = 0;
+            break;
+        }
+        snprintf(child, length + 1, "%.*s/%s", (int)base, path, names.paths[i]);
+        struct stat st;
+        if (lstat(child, &st) == 0) {
+            if (S_ISDIR(st.st_mode))
+                ok = add_directory(list, child);
+            else if (S_ISREG(st.st_mode))
+                ok = add_file(list, child);
+        }
+        mem_free(child);
+    }
+    ingest_free_paths(&names);
+    return ok;
+}
+
+int ingest_add_path(IngestPaths* list, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    if (S_ISDIR(st.st_mode))
+        return add_directory(list, path);
+    return add_file(list, path);
+}
+
+void ingest_free_paths(IngestPaths* list) {
+    for (int i = 0; i < list->count; i++)
+        mem_free(list->paths[i]);
+    mem_free(list->paths);
+    memset(list, 0, sizeof(*list));
+}
@@ -0,0 +1,362 @@
+/* watch.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+#include "../../include/watch.h"
+#include "../../include/ingest.h"
+#include "../../include/alloc.h"
+
+// A burst under a steady stream of events still ends after this many quiet
+// periods.
+#define WATCH_MAX_QUIET_PERIODS 20
+
+static void add_change(WatchBurst* burst, const char* path, WatchChangeKind kind, int directory) {
+    for (int i = 0; i < burst->count; i++) {
+        if (strcmp(burst->changes[i].path, path) == 0) {
+            burst->changes[i].kind = kind;
+            burst->changes[i].directory = directory;
+            return;
+        }
+    }
+    if (burst->count == burst->capacity) {
+        int new_capacity = burst->capacity ? burst->capacity * 2 : 16;
+        WatchChange* grown = mem_realloc(MEM_IO, burst->changes, new_capacity * sizeof(WatchChange));
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        burst->changes = grown;
+        burst->capacity = new_capacity;
+    }
+    size_t length = strlen(path);
+    char* copy = mem_alloc(MEM_IO, length + 1);
+    if (!copy) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    memcpy(copy, path, length + 1);
+    burst->changes[burst->count++] = (WatchChange){copy, kind, directory};
+}
+
+void watch_free_burst(WatchBurst* burst) {
+    for (int i = 0; i < burst->count; i++)
+        mem_free(burst->changes[i].path);
+    mem_free(burst->changes);
+    memset(burst, 0, sizeof(*burst));
+}
+
+static void reset_burst(WatchBurst* burst) {
+    for (int i = 0; i < burst->count; i++)
+        mem_free(burst->changes[i].path);
+    burst->count = 0;
+    burst->overflowed = 0;
+}
+
+#ifdef __linux__
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR)
+
+typedef struct {
+    int wd;                  // -1 once the kernel dropped it
+    char* prefix;            // Joined with event names: "dir/", or "" for "."
+    int recursive;           // Everything under it counts, not just named files
+} WatchDir;
+
+struct Watch {
+    int fd;
+    WatchDir* dirs;
+    int dir_count;
+    int dir_capacity;
+    IngestPaths files;       // Named files, sorted
+};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static char* join(const char* prefix, const char* name) {
+    size_t length = strlen(prefix) + strlen(name);
+    char* path = mem_alloc(MEM_IO, length + 1);
+    if (!path) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    snprintf(path, length + 1, "%s%s", prefix, name);
+    return path;
+}
+
+static char* copy_text(const char* text, size_t length) {
+    char* copy = mem_alloc(MEM_IO, length + 1);
+    if (!copy) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// "dir/" for dir, trailing slashes dropped as ingest_add_path does.
+static char* prefix_of(const char* dir, size_t length) {
+    while (length > 1 && dir[length - 1] == '/')
+        length--;
+    char* prefix = mem_alloc(MEM_IO, length + 2);
+    if (!prefix) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    snprintf(prefix, length + 2, "%.*s/", (int)length, dir);
+    return prefix;
+}
+
+static WatchDir* find_dir(Watch* watch, int wd) {
+    for (int i = 0; i < watch->dir_count; i++)
+        if (watch->dirs[i].wd == wd)
+            return &watch->dirs[i];
+    return NULL;
+}
+
+// Watches dir (spelled as its files' prefix) and, when recursive, everything
+// below it. With a burst, the files found are reported as changed.
+static int watch_dir(Watch* watch, const char* dir, char* prefix, int recursive, WatchBurst* burst) {
+    int wd = inotify_add_watch(watch->fd, dir, WATCH_MASK);
+    if (wd < 0) {
+        mem_free(prefix);
+        return 0;
+    }
+    WatchDir* existing = find_dir(watch, wd);
+    if (existing) {
+        existing->recursive |= recursive;
+        mem_free(prefix);
+        if (!recursive)
+            return 1;
+        prefix = existing->prefix;
+    } else {
+        if (watch->dir_count == watch->dir_capacity) {
+            int new_capacity = watch->dir_capacity ? watch->dir_capacity * 2 : 16;
+            WatchDir* grown = mem_realloc(MEM_IO, watch->dirs, new_capacity * sizeof(WatchDir));
+            if (!grown) {
+                perror("Memory allocation error");
+                exit(1);
+            }
+            watch->dirs = grown;
+            watch->dir_capacity = new_capacity;
+        }
+        watch->dirs[watch->dir_count++] = (WatchDir){wd, prefix, recursive};
+        if (!recursive)
+            return 1;
+    }
+
+    DIR* listing = opendir(dir);
+    if (!listing)
+        return 0;
+    int ok = 1;
+    struct dirent* entry;
+    while (ok && (entry = readdir(listing)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        char* child = join(prefix, entry->d_name);
+        struct stat st;
+        if (lstat(child, &st) == 0) {
+            if (S_ISDIR(st.st_mode))
+                ok = watch_dir(watch, child, prefix_of(child, strlen(child)), 1, burst);
+            else if (S_ISREG(st.st_mode) && burst)
+                add_change(burst, child, WATCH_CHANGED, 0);
+        }
+        mem_free(child);
+    }
+    closedir(listing);
+    return ok;
+}
+
+// A directory went away or moved: its subdirectories' watches would keep
+// reporting under the old name.
+static void unwatch_under(Watch* watch, const char* path) {
+    size_t length = strlen(path);
+    for (int i = 0; i < watch->dir_count; i++) {
+        WatchDir* dir = &watch->dirs[i];
+        if (dir->wd >= 0 && strncmp(dir->prefix, path, length) == 0 && dir->prefix[length] == '/') {
+            inotify_rm_watch(watch->fd, dir->wd);
+            dir->wd = -1;
+        }
+    }
+}
+
+static int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int is_named(const Watch* watch, const char* path) {
+    return watch->files.count &&
+           bsearch(&path, watch->files.paths, watch->files.count, sizeof(char*), compare_paths) != NULL;
+}
+
+static void handle_event(Watch* watch, const struct inotify_event* event, WatchBurst* burst) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        burst->overflowed = 1;
+        return;
+    }
+    WatchDir* dir = find_dir(watch, event->wd);
+    if (!dir)
+        return;
+    if (event->mask & IN_IGNORED) {
+        dir->wd = -1;
+        return;
+    }
+    if (!event->len)
+        return;
+
+    char* path = join(dir->prefix, event->name);
+    if (event->mask & IN_ISDIR) {
+        if (!dir->recursive) {
+        } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            watch_dir(watch, path, prefix_of(path, strlen(path)), 1, burst);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            unwatch_under(watch, path);
+            add_change(burst, path, WATCH_REMOVED, 1);
+        }
+    } else if (dir->recursive || is_named(watch, path)) {
+        // A created file is reported once it is closed
+        if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            add_change(burst, path, WATCH_CHANGED, 0);
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            add_change(burst, path, WATCH_REMOVED, 0);
+    }
+    mem_free(path);
+}
+
+// Drains what the kernel has queued. Returns 0 on a read error.
+static int read_events(Watch* watch, WatchBurst* burst) {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+        if (length < 0)
+            return errno == EAGAIN || errno == EINTR;
+        if (length == 0)
+            return 1;
+        const struct inotify_event* event;
+        for (char* at = buffer; at < buffer + length; at += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event*)at;
+            handle_event(watch, event, burst);
+        }
+    }
+}
+
+Watch* watch_start(const char* const* paths, int count) {
+    Watch* watch = mem_calloc(MEM_IO, 1, sizeof(Watch));
+    if (!watch)
+        return NULL;
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd < 0) {
+        mem_free(watch);
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        int ok = stat(paths[i], &st) == 0;
+        if (ok && S_ISDIR(st.st_mode)) {
+            ok = watch_dir(watch, paths[i], prefix_of(paths[i], strlen(paths[i])), 1, NULL);
+        } else if (ok) {
+            // The directory, so a save that renames over the file is seen.
+            // Its events are joined to the text up to the last slash.
+            ok = ingest_add_path(&watch->files, paths[i]);
+            const char* slash = strrchr(paths[i], '/');
+            size_t length = slash ? (size_t)(slash - paths[i]) + 1 : 0;
+            char* dir = copy_text(length > 1 ? paths[i] : (length ? "/" : "."), length > 1 ? length - 1 : 1);
+            if (ok)
+                ok = watch_dir(watch, dir, copy_text(paths[i], length), 0, NULL);
+            mem_free(dir);
+        }
+        if (!ok) {
+            int saved = errno;
+            watch_finish(watch);
+            errno = saved;
+            return NULL;
+        }
+    }
+    if (watch->files.count)
+        qsort(watch->files.paths, watch->files.count, sizeof(char*), compare_paths);
+    return watch;
+}
+
+int watch_directory_count(const Watch* watch) {
+    int count = 0;
+    for (int i = 0; i < watch->dir_count; i++)
+        count += watch->dirs[i].wd >= 0;
+    return count;
+}
+
+int watch_next(Watch* watch, int quiet_ms, WatchBurst* burst) {
+    struct pollfd ready = {watch->fd, POLLIN, 0};
+    reset_burst(burst);
+    while (burst->count == 0 && !burst->overflowed) {
+        if (poll(&ready, 1, -1) < 0)
+            return 0;
+        burst->first_event = now();
+        double deadline = burst->first_event + WATCH_MAX_QUIET_PERIODS * quiet_ms / 1000.0;
+        for (;;) {
+            if (!read_events(watch, burst))
+                return 0;
+            int wait = (int)((deadline - now()) * 1000);
+            if (wait <= 0)
+                break;
+            if (poll(&ready, 1, wait < quiet_ms ? wait : quiet_ms) <= 0)
+                break;
+        }
+    }
+    return 1;
+}
+
+void watch_finish(Watch* watch) {
+    if (!watch)
+        return;
+    close(watch->fd);
+    for (int i = 0; i < watch->dir_count; i++)
+        mem_free(watch->dirs[i].prefix);
+    mem_free(watch->dirs);
+    ingest_free_paths(&watch->files);
+    mem_free(watch);
+}
+
+#else
+
+struct Watch {
+    int unused;
+};
+
+Watch* watch_start(const char* const* paths, int count) {
+    (void)paths;
+    (void)count;
+    errno = ENOSYS;
+    return NULL;
+}
+
+int watch_directory_count(const Watch* watch) {
+    (void)watch;
+    return 0;
+}
+
+int watch_next(Watch* watch, int quiet_ms, WatchBurst* burst) {
+    (void)watch;
+    (void)quiet_ms;
+    reset_burst(burst);
+    errno = ENOSYS;
+    return 0;
+}
+
+void watch_finish(Watch* watch) {
+    (void)watch;
+}
+
+#endif
@@ -0,0 +1,775 @@
+/* batch.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "../../include/ir.h"
+#include "../../include/alloc.h"
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+static void* table(size_t count, size_t size) {
+    void* memory = mem_calloc(MEM_IR, count ? count : 1, size);
+    if (!memory)
+        out_of_memory();
+    return memory;
+}
+
+// --------------------------------------------------------------------------
+// Lane vectors
+// --------------------------------------------------------------------------
+//
+// The kernels are written once against Vec: eight lanes with AVX2, four with
+// SSE2, or one plain int. Comparisons give all ones for true.
+
+#if defined(__AVX2__)
+#define VECTOR_WIDTH 8
+typedef __m256i Vec;
+static inline Vec vload(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void vstore(int* p, Vec v) { _mm256_storeu_si256((__m256i*)p, v); }
+static inline Vec vset(int x) { return _mm256_set1_epi32(x); }
+static inline Vec vadd(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+static inline Vec vsub(Vec a, Vec b) { return _mm256_sub_epi32(a, b); }
+static inline Vec vmul(Vec a, Vec b) { return _mm256_mullo_epi32(a, b); }
+static inline Vec vcmpeq(Vec a, Vec b) { return _mm256_cmpeq_epi32(a, b); }
+static inline Vec vcmpgt(Vec a, Vec b) { return _mm256_cmpgt_epi32(a, b); }
+static inline Vec vand(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+static inline Vec vandnot(Vec a, Vec b) { return _mm256_andnot_si256(a, b); }
+static inline Vec vor(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+static inline int vany(Vec a) { return !_mm256_testz_si256(a, a); }
+#elif defined(__SSE2__)
+#define VECTOR_WIDTH 4
+typedef __m128i Vec;
+static inline Vec vload(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vstore(int* p, Vec v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline Vec vset(int x) { return _mm_set1_epi32(x); }
+static inline Vec vadd(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+static inline Vec vsub(Vec a, Vec b) { return _mm_sub_epi32(a, b); }
+// SSE2 has no 32-bit low multiply: multiply even and odd lanes as 64-bit
+// products and gather the low halves.
+static inline Vec vmul(Vec a, Vec b) {
+    Vec even = _mm_mul_epu32(a, b);
+    Vec odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+static inline Vec vcmpeq(Vec a, Vec b) { return _mm_cmpeq_epi32(a, b); }
+static inline Vec vcmpgt(Vec a, Vec b) { return _mm_cmpgt_epi32(a, b); }
+static inline Vec vand(Vec a, Vec b) { return _mm_and_si128(a, b); }
+static inline Vec vandnot(Vec a, Vec b) { return _mm_andnot_si128(a, b); }
+static inline Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+static inline int vany(Vec a) { return _mm_movemask_epi8(a) != 0; }
+#else
+#define VECTOR_WIDTH 1
+typedef int Vec;
+static inline Vec vload(const int* p) { return *p; }
+static inline void vstore(int* p, Vec v) { *p = v; }
+static inline Vec vset(int x) { return x; }
+static inline Vec vadd(Vec a, Vec b) { return (int)((unsigned)a + (unsigned)b); }
+static inline Vec vsub(Vec a, Vec b) { return (int)((unsigned)a - (unsigned)b); }
+static inline Vec vmul(Vec a, Vec b) { return (int)((unsigned)a * (unsigned)b); }
+static inline Vec vcmpeq(Vec a, Vec b) { return -(a == b); }
+static inline Vec vcmpgt(Vec a, Vec b) { return -(a > b); }
+static inline Vec vand(Vec a, Vec b) { return a & b; }
+static inline Vec vandnot(Vec a, Vec b) { return ~a & b; }
+static inline Vec vor(Vec a, Vec b) { return a | b; }
+static inline int vany(Vec a) { return a != 0; }
+#endif
+
+int ir_batch_vector_width(void) {
+    return VECTOR_WIDTH;
+}
+
+// --------------------------------------------------------------------------
+// Column code
+// --------------------------------------------------------------------------
+//
+// Registers are columns of IR_LANES values: the program's variables, then
+// its constants, then temporaries. Control flow keeps a stack of lane masks;
+// the top one says which lanes the current instruction affects.
+
+typedef enum {
+    V_MOVE,              // dst = a
+    V_ADD,
+    V_SUB,
+    V_MUL,
+    V_DIV,
+    V_EQ,
+    V_NE,
+    V_LT,
+    V_GT,
+    V_FACTORIAL,         // dst = factorial(a)
+    V_READ,              // dst = the lane's next input
+    V_PRINT,             // a
+    V_IF,                // Push the lanes where a != 0; if none, go to target
+    V_ELSE,              // Swap to the enclosing lanes the if left out; if none, go to target
+    V_END_IF,            // Pop
+    V_LOOP,              // Push the current lanes
+    V_WHILE,             // Drop lanes where a == 0; if none remain, go to target
+    V_UNTIL,             // Drop lanes where a != 0; if any remain, go to target
+    V_JUMP,
+    V_END_LOOP,          // Pop
+    V_HALT
+} BatchOp;
+
+typedef struct {
+    BatchOp op;
+    int dst;
+    int a;
+    int b;
+    int target;
+} BatchInstr;
+
+struct IrBatchProgram {
+    BatchInstr* code;
+    int length;
+    int capacity;
+    int variable_count;
+    int* constants;      // Value of each constant register
+    int constant_count;
+    int constant_capacity;
+    int temp_count;
+    int register_count;
+    int max_depth;       // Mask stack entries needed below the base
+};
+
+// Constants and temporaries are numbered apart while compiling and placed
+// after the variables once their counts are known.
+#define CONSTANT_BASE (1 << 28)
+#define TEMP_BASE (1 << 29)
+
+typedef struct {
+    IrBatchProgram* program;
+    IrVariables variables;
+    int temps;
+    int depth;
+} BatchCompiler;
+
+static int emit(BatchCompiler* compiler, BatchOp op, int dst, int a, int b) {
+    IrBatchProgram* program = compiler->program;
+    if (program->length == program->capacity) {
+        int capacity = program->capacity ? program->capacity * 2 : 64;
+        BatchInstr* grown = mem_realloc(MEM_IR, program->code, capacity * sizeof(BatchInstr));
+        if (!grown)
+            out_of_memory();
+        program->code = grown;
+        program->capacity = capacity;
+    }
+    program->code[program->length] = (BatchInstr){op, dst, a, b, -1};
+    return program->length++;
+}
+
+static int constant_register(BatchCompiler* compiler, int value) {
+    IrBatchProgram* program = compiler->program;
+    for (int i = 0; i < program->constant_count; i++)
+        if (program->constants[i] == value)
+            return CONSTANT_BASE + i;
+    if (program->constant_count == program->constant_capacity) {
+        int capacity = program->constant_capacity ? program->constant_capacity * 2 : 16;
+        int* grown = mem_realloc(MEM_IR, program->constants, capacity * sizeof(int));
+        if (!grown)
+            out_of_memory();
+        program->constants = grown;
+        program->constant_capacity = capacity;
+    }
+    program->constants[program->constant_count] = value;
+    return CONSTANT_BASE + program->constant_count++;
+}
+
+static int temp_register(BatchCompiler* compiler) {
+    int temp = compiler->temps++;
+    if (compiler->temps > compiler->program->temp_count)
+        compiler->program->temp_count = compiler->temps;
+    return TEMP_BASE + temp;
+}
+
+static void push_mask(BatchCompiler* compiler) {
+    if (++compiler->depth > compiler->program->max_depth)
+        compiler->program->max_depth = compiler->depth;
+}
+
+// Operands are released before the result is taken, so the result may reuse
+// one of their registers; every kernel reads a lane before writing it.
+static int compile_expression(BatchCompiler* compiler, const ASTNode* node) {
+    int mark = compiler->temps;
+    int a, b;
+    BatchOp op;
+    switch (node->type) {
+        case AST_NUMBER:
+            return constant_register(compiler, ir_literal(node));
+        case AST_IDENTIFIER:
+            return ir_variable_of(&compiler->variables, node);
+        case AST_FUNC_CALL:
+            a = compile_expression(compiler, node->right);
+            compiler->temps = mark;
+            b = temp_register(compiler);
+            emit(compiler, V_FACTORIAL, b, a, -1);
+            return b;
+        case AST_BINOP:
+            switch (ir_operator(node)) {
+                case IR_ADD: op = V_ADD; break;
+                case IR_SUB: op = V_SUB; break;
+                case IR_MUL: op = V_MUL; break;
+                case IR_DIV: op = V_DIV; break;
+                case IR_EQ:  op = V_EQ; break;
+                case IR_NE:  op = V_NE; break;
+                case IR_LT:  op = V_LT; break;
+                case IR_GT:  op = V_GT; break;
+                default:     return constant_register(compiler, 0);
+            }
+            // A prefix operator has no left operand and applies to 0
+            a = node->left ? compile_expression(compiler, node->left) : constant_register(compiler, 0);
+            b = compile_expression(compiler, node->right);
+            compiler->temps = mark;
+            int dst = temp_register(compiler);
+            emit(compiler, op, dst, a, b);
+            return dst;
+        default:
+            return constant_register(compiler, 0);
+    }
+}
+
+static void compile_statements(BatchCompiler* compiler, const ASTNode* first);
+
+static void compile_statement(BatchCompiler* compiler, const ASTNode* node) {
+    IrBatchProgram* program = compiler->program;
+    int value, branch, other;
+    compiler->temps = 0;
+    switch (node->type) {
+        case AST_VARDECL:
+            value = node->right ? compile_expression(compiler, node->right) : constant_register(compiler, 0);
+            emit(compiler, V_MOVE, ir_variable_of(&compiler->variables, node), value, -1);
+            break;
+        case AST_ASSIGN:
+            value = compile_expression(compiler, node->right);
+            emit(compiler, V_MOVE, ir_variable_of(&compiler->variables, node->left), value, -1);
+            break;
+        case AST_READ:
+            emit(compiler, V_READ, ir_variable_of(&compiler->variables, node->left), -1, -1);
+            break;
+        case AST_PRINT:
+            emit(compiler, V_PRINT, -1, compile_expression(compiler, node->left), -1);
+            break;
+        case AST_IF:
+            value = compile_expression(compiler, node->left);
+            branch = emit(compiler, V_IF, -1, value, -1);
+            push_mask(compiler);
+            compile_statements(compiler, node->right->left);
+            if (node->right->right) {
+                other = emit(compiler, V_ELSE, -1, -1, -1);
+                program->code[branch].target = other;
+                compile_statements(compiler, node->right->right->left);
+                branch = other;
+            }
+            other = emit(compiler, V_END_IF, -1, -1, -1);
+            program->code[branch].target = other;
+            compiler->depth--;
+            break;
+        case AST_WHILE: {
+            emit(compiler, V_LOOP, -1, -1, -1);
+            push_mask(compiler);
+            int head = program->length;
+            value = compile_expression(compiler, node->left);
+            branch = emit(compiler, V_WHILE, -1, value, -1);
+            compile_statements(compiler, node->right->left);
+            // emit may move the code, so targets are set after it returns
+            other = emit(compiler, V_JUMP, -1, -1, -1);
+            program->code[other].target = head;
+            other = emit(compiler, V_END_LOOP, -1, -1, -1);
+            program->code[branch].target = other;
+            compiler->depth--;
+            break;
+        }
+        case AST_REPEAT: {
+            emit(compiler, V_LOOP, -1, -1, -1);
+            push_mask(compiler);
+            int body = program->length;
+            compile_statements(compiler, node->left->left);
+            compiler->temps = 0;
+            value = compile_expression(compiler, node->right);
+            other = emit(compiler, V_UNTIL, -1, value, -1);
+            program->code[other].target = body;
+            emit(compiler, V_END_LOOP, -1, -1, -1);
+            compiler->depth--;
+            break;
+        }
+        case AST_BLOCK:
+            compile_statements(compiler, node->left);
+            break;
+        default:
+            // A bare expression statement: evaluated for its traps only
+            compile_expression(compiler, node);
+            break;
+    }
+}
+
+static void compile_statements(BatchCompiler* compiler, const ASTNode* first) {
+    for (const ASTNode* statement = first; statement; statement = statement->next)
+        compile_statement(compiler, statement);
+}
+
+static int place_register(const IrBatchProgram* program, int r) {
+    if (r >= TEMP_BASE)
+        return program->variable_count + program->constant_count + (r - TEMP_BASE);
+    if (r >= CONSTANT_BASE)
+        return program->variable_count + (r - CONSTANT_BASE);
+    return r;
+}
+
+IrBatchProgram* ir_batch_compile(const ASTNode* ast, char* error, size_t size) {
+    BatchCompiler compiler = {0};
+    if (!ir_resolve_variables(ast, &compiler.variables, error, size))
+        return NULL;
+    IrBatchProgram* program = table(1, sizeof(IrBatchProgram));
+    compiler.program = program;
+    program->variable_count = compiler.variables.var_count;
+    for (const ASTNode* statement = ast; statement; statement = statement->next)
+        if (statement->left)
+            compile_statement(&compiler, statement->left);
+    emit(&compiler, V_HALT, -1, -1, -1);
+    ir_free_variables(&compiler.variables);
+
+    for (int i = 0; i < program->length; i++) {
+        BatchInstr* instr = &program->code[i];
+        if (instr->dst >= 0)
+            instr->dst = place_register(program, instr->dst);
+        if (instr->a >= 0)
+            instr->a = place_register(program, instr->a);
+        if (instr->b >= 0)
+            instr->b = place_register(program, instr->b);
+    }
+    program->register_count = program->variable_count + program->constant_count + program->temp_count;
+    return program;
+}
+
+void ir_batch_free(IrBatchProgram* program) {
+    if (!program)
+        return;
+    mem_free(program->code);
+    mem_free(program->constants);
+    mem_free(program);
+}
+
+// --------------------------------------------------------------------------
+// Executing one batch
+// --------------------------------------------------------------------------
+
+typedef struct {
+    const IrBatchProgram* program;
+    long max_iterations;
+    int* registers;          // register_count columns
+    int* masks;              // max_depth + 1 columns of 0 or -1
+    int* iterations;         // Loop tests passed, per lane
+    int* read_count;         // Inputs taken, per lane
+    int* input_count;        // Inputs available, per lane
+    int* inputs;             // input_capacity columns
+    int input_capacity;
+    int* print_count;        // Values printed, per lane
+    int* outputs;            // output_capacity columns, at most IR_RUN_KEEP
+    int output_capacity;
+    IrRunStatus* status;
+} Batch;
+
+static void batch_init(Batch* batch, const IrBatchProgram* program, long max_iterations) {
+    memset(batch, 0, sizeof(*batch));
+    batch->program = program;
+    batch->max_iterations = max_iterations;
+    batch->registers = table((size_t)program->register_count * IR_LANES, sizeof(int));
+    batch->masks = table((size_t)(program->max_depth + 1) * IR_LANES, sizeof(int));
+    batch->iterations = table(IR_LANES, sizeof(int));
+    batch->read_count = table(IR_LANES, sizeof(int));
+    batch->input_count = table(IR_LANES, sizeof(int));
+    batch->print_count = table(IR_LANES, sizeof(int));
+    batch->status = table(IR_LANES, sizeof(IrRunStatus));
+    // Constant columns never change
+    for (int c = 0; c < program->constant_count; c++) {
+        int* column = batch->registers + (size_t)(program->variable_count + c) * IR_LANES;
+        for (int i = 0; i < IR_LANES; i++)
+            column[i] = program->constants[c];
+    }
+}
+
+static void batch_free(Batch* batch) {
+    mem_free(batch->registers);
+    mem_free(batch->masks);
+    mem_free(batch->iterations);
+    mem_free(batch->read_count);
+    mem_free(batch->input_count);
+    mem_free(batch->inputs);
+    mem_free(batch->print_count);
+    mem_free(batch->outputs);
+    mem_free(batch->status);
+}
+
+static void grow_inputs(Batch* batch, int columns) {
+    if (columns <= batch->input_capacity)
+        return;
+    int capacity = batch->input_capacity ? batch->input_capacity : 4;
+    while (capacity < columns)
+        capacity *= 2;
+    int* grown = mem_realloc(MEM_IR, batch->inputs, (size_t)capacity * IR_LANES * sizeof(int));
+    if (!grown)
+        out_of_memory();
+    batch->inputs = grown;
+    batch->input_capacity = capacity;
+}
+
+// Stops a lane for good: it leaves every mask on the stack.
+static void stop_lane(Batch* batch, int lane, int depth, IrRunStatus status) {
+    batch->status[lane] = status;
+    for (int d = 0; d <= depth; d++)
+        batch->masks[(size_t)d * IR_LANES + lane] = 0;
+}
+
+static int any_lane(const int* mask) {
+    Vec any = vset(0);
+    for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH)
+        any = vor(any, vload(mask + i));
+    return vany(any);
+}
+
+static void record_output(Batch* batch, int lane, int value) {
+    int count = batch->print_count[lane]++;
+    if (count >= IR_RUN_KEEP)
+        return;
+    if (count == batch->output_capacity) {
+        int capacity = batch->output_capacity ? batch->output_capacity * 2 : 8;
+        if (capacity > IR_RUN_KEEP)
+            capacity = IR_RUN_KEEP;
+        int* grown = mem_realloc(MEM_IR, batch->outputs, (size_t)capacity * IR_LANES * sizeof(int));
+        if (!grown)
+            out_of_memory();
+        batch->outputs = grown;
+        batch->output_capacity = capacity;
+    }
+    batch->outputs[(size_t)count * IR_LANES + lane] = value;
+}
+
+#define LANEWISE(result)                                        \
+    for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH) {          \
+        Vec x = vload(a + i), y = vload(b + i);                 \
+        vstore(dst + i, result);                                \
+    }
+
+// Runs the program over the first lanes lanes, whose inputs are loaded.
+static void batch_run(Batch* batch, int lanes) {
+    const IrBatchProgram* program = batch->program;
+    const BatchInstr* code = program->code;
+    int* registers = batch->registers;
+    const Vec zero = vset(0), one = vset(1);
+    long tests = 0;
+
+    memset(registers, 0, (size_t)program->variable_count * IR_LANES * sizeof(int));
+    memset(batch->iterations, 0, IR_LANES * sizeof(int));
+    memset(batch->read_count, 0, IR_LANES * sizeof(int));
+    memset(batch->print_count, 0, IR_LANES * sizeof(int));
+    for (int i = 0; i < IR_LANES; i++) {
+        batch->masks[i] = i < lanes ? -1 : 0;
+        batch->status[i] = IR_RUN_DONE;
+    }
+
+    int depth = 0;
+    int* mask = batch->masks;
+    for (int pc = 0;; pc++) {
+        const BatchInstr* instr = &code[pc];
+        int* dst = instr->dst >= 0 ? registers + (size_t)instr->dst * IR_LANES : NULL;
+        const int* a = instr->a >= 0 ? registers + (size_t)instr->a * IR_LANES : NULL;
+        const int* b = instr->b >= 0 ? registers + (size_t)instr->b * IR_LANES : NULL;
+        switch (instr->op) {
+            case V_MOVE:
+                for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH) {
+                    Vec m = vload(mask + i);
+                    vstore(dst + i, vor(vand(m, vload(a + i)), vandnot(m, vload(dst + i))));
+                }
+                break;
+            case V_ADD: LANEWISE(vadd(x, y)); break;
+            case V_SUB: LANEWISE(vsub(x, y)); break;
+            case V_MUL: LANEWISE(vmul(x, y)); break;
+            case V_EQ:  LANEWISE(vand(vcmpeq(x, y), one)); break;
+            case V_NE:  LANEWISE(vandnot(vcmpeq(x, y), one)); break;
+            case V_LT:  LANEWISE(vand(vcmpgt(y, x), one)); break;
+            case V_GT:  LANEWISE(vand(vcmpgt(x, y), one)); break;
+            case V_DIV:
+                // No vector division; a zero divisor stops its lane
+                for (int i = 0; i < IR_LANES; i++) {
+                    int result = 0;
+                    if (mask[i] && !ir_evaluate(IR_DIV, a[i], b[i], &result))
+                        stop_lane(batch, i, depth, IR_RUN_DIVIDE_BY_ZERO);
+                    dst[i] = result;
+                }
+                break;
+            case V_FACTORIAL:
+                for (int i = 0; i < IR_LANES; i++) {
+                    int result = 1;
+                    if (mask[i])
+                        ir_evaluate(IR_FACTORIAL, a[i], 0, &result);
+                    dst[i] = result;
+                }
+                break;
+            case V_READ:
+                for (int i = 0; i < IR_LANES; i++) {
+                    if (!mask[i])
+                        continue;
+                    int k = batch->read_count[i]++;
+                    dst[i] = k < batch->input_count[i] ? batch->inputs[(size_t)k * IR_LANES + i] : 0;
+                }
+                break;
+            case V_PRINT:
+                for (int i = 0; i < IR_LANES; i++)
+                    if (mask[i])
+                        record_output(batch, i, a[i]);
+                break;
+            case V_IF: {
+                int* inner = mask + IR_LANES;
+                for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH)
+                    vstore(inner + i, vandnot(vcmpeq(vload(a + i), zero), vload(mask + i)));
+                depth++;
+                mask = inner;
+                if (!any_lane(mask))
+                    pc = instr->target - 1;
+                break;
+            }
+            case V_ELSE: {
+                const int* outer = mask - IR_LANES;
+                for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH)
+                    vstore(mask + i, vandnot(vload(mask + i), vload(outer + i)));
+                if (!any_lane(mask))
+                    pc = instr->target - 1;
+                break;
+            }
+            case V_LOOP:
+                memcpy(mask + IR_LANES, mask, IR_LANES * sizeof(int));
+                depth++;
+                mask += IR_LANES;
+                break;
+            case V_WHILE:
+            case V_UNTIL: {
+                // while keeps the lanes whose condition holds, until the others
+                int keep_true = instr->op == V_WHILE;
+                Vec any = zero;
+                for (int i = 0; i < IR_LANES; i += VECTOR_WIDTH) {
+                    Vec is_false = vcmpeq(vload(a + i), zero);
+                    Vec m = keep_true ? vandnot(is_false, vload(mask + i)) : vand(is_false, vload(mask + i));
+                    vstore(mask + i, m);
+                    vstore(batch->iterations + i, vsub(vload(batch->iterations + i), m));
+                    any = vor(any, m);
+                }
+                // No lane can pass the limit before the batch has made that many tests
+                if (++tests > batch->max_iterations && vany(any)) {
+                    for (int i = 0; i < IR_LANES; i++)
+                        if (mask[i] && batch->iterations[i] > batch->max_iterations)
+                            stop_lane(batch, i, depth, IR_RUN_STEP_LIMIT);
+                    any = vset(any_lane(mask) ? -1 : 0);
+                }
+                if (keep_true ? !vany(any) : vany(any))
+                    pc = instr->target - 1;
+                break;
+            }
+            case V_JUMP:
+                pc = instr->target - 1;
+                break;
+            case V_END_IF:
+            case V_END_LOOP:
+                depth--;
+                mask -= IR_LANES;
+                break;
+            case V_HALT:
+                return;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// Streaming rows
+// --------------------------------------------------------------------------
+//
+// Input is one vector per line: integers separated by blanks, wrapping to
+// 32 bits. Output is one line per input with the values it printed, ' ...'
+// if there were more than IR_RUN_KEEP, and a note if the run stopped early.
+
+typedef struct {
+    FILE* in;
+    char* line;
+    size_t line_capacity;
+    long line_number;
+    int* values;
+    int count;
+    int capacity;
+} RowReader;
+
+// Next row into reader->values; 0 at the end, -1 on a malformed line.
+static int read_row(RowReader* reader, char* error, size_t size) {
+    ssize_t length = getline(&reader->line, &reader->line_capacity, reader->in);
+    if (length < 0)
+        return 0;
+    reader->line_number++;
+    reader->count = 0;
+    char* p = reader->line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n')
+            p++;
+        if (!*p)
+            return 1;
+        char* end;
+        long long value = strtoll(p, &end, 10);
+        if (end == p) {
+            int shown = (int)strcspn(p, " \t,\r\n");
+            snprintf(error, size, "line %ld: '%.*s' is not a number", reader->line_number,
+                     shown < 20 ? shown : 20, p);
+            return -1;
+        }
+        p = end;
+        if (reader->count == reader->capacity) {
+            int capacity = reader->capacity ? reader->capacity * 2 : 16;
+            int* grown = mem_realloc(MEM_IR, reader->values, capacity * sizeof(int));
+            if (!grown)
+                out_of_memory();
+            reader->values = grown;
+            reader->capacity = capacity;
+        }
+        reader->values[reader->count++] = (int)(unsigned)value;
+    }
+}
+
+static void free_reader(RowReader* reader) {
+    free(reader->line);      // Allocated by getline
+    mem_free(reader->values);
+}
+
+typedef struct {
+    FILE* out;
+    char buffer[1 << 16];
+    size_t length;
+} RowWriter;
+
+static void flush_rows(RowWriter* writer) {
+    fwrite(writer->buffer, 1, writer->length, writer->out);
+    writer->length = 0;
+}
+
+static void put_text(RowWriter* writer, const char* text) {
+    size_t length = strlen(text);
+    if (writer->length + length > sizeof(writer->buffer))
+        flush_rows(writer);
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+}
+
+static void put_value(RowWriter* writer, int value, int first) {
+    char digits[16];
+    int n = 0;
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (writer->length + 16 > sizeof(writer->buffer))
+        flush_rows(writer);
+    char* p = writer->buffer + writer->length;
+    if (!first)
+        *p++ = ' ';
+    if (value < 0)
+        *p++ = '-';
+    while (n)
+        *p++ = digits[--n];
+    writer->length = (size_t)(p - writer->buffer);
+}
+
+// Finishes a row: the values shown are kept[0..printed) up to IR_RUN_KEEP.
+static void end_row(RowWriter* writer, long printed, IrRunStatus status) {
+    if (printed > IR_RUN_KEEP)
+        put_text(writer, " ...");
+    if (status == IR_RUN_DIVIDE_BY_ZERO)
+        put_text(writer, printed ? " !division by zero" : "!division by zero");
+    else if (status == IR_RUN_STEP_LIMIT)
+        put_text(writer, printed ? " !step limit" : "!step limit");
+    put_text(writer, "\n");
+}
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int ir_batch_stream(const IrBatchProgram* program, FILE* in, FILE* out, long max_iterations,
+                    IrStreamStats* stats, char* error, size_t size) {
+    RowReader reader = {0};
+    reader.in = in;
+    RowWriter* writer = table(1, sizeof(RowWriter));
+    writer->out = out;
+    Batch batch;
+    batch_init(&batch, program, max_iterations);
+    memset(stats, 0, sizeof(*stats));
+    int ok = 1, more = 1;
+
+    while (more) {
+        int lanes = 0;
+        while (lanes < IR_LANES && (more = read_row(&reader, error, size)) > 0) {
+            grow_inputs(&batch, reader.count);
+            for (int k = 0; k < reader.count; k++)
+                batch.inputs[(size_t)k * IR_LANES + lanes] = reader.values[k];
+            batch.input_count[lanes++] = reader.count;
+        }
+        if (more < 0)
+            ok = more = 0;
+        if (!lanes)
+            break;
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        batch_run(&batch, lanes);
+        stats->execute_seconds += seconds_since(&start);
+        stats->rows += lanes;
+
+        for (int lane = 0; lane < lanes; lane++) {
+            int printed = batch.print_count[lane];
+            int shown = printed < IR_RUN_KEEP ? printed : IR_RUN_KEEP;
+            for (int k = 0; k < shown; k++)
+                put_value(writer, batch.outputs[(size_t)k * IR_LANES + lane], k == 0);
+            end_row(writer, printed, batch.status[lane]);
+        }
+    }
+    flush_rows(writer);
+    mem_free(writer);
+    batch_free(&batch);
+    free_reader(&reader);
+    return ok;
+}
+
+int ir_scalar_stream(const IrProgram* program, FILE* in, FILE* out, long max_steps,
+                     IrStreamStats* stats, char* error, size_t size) {
+    RowReader reader = {0};
+    reader.in = in;
+    RowWriter* writer = table(1, sizeof(RowWriter));
+    writer->out = out;
+    IrRun* run = table(1, sizeof(IrRun));
+    memset(stats, 0, sizeof(*stats));
+    int more;
+
+    while ((more = read_row(&reader, error, size)) > 0) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ir_run(program, reader.values, reader.count, max_steps, run);
+        stats->execute_seconds += seconds_since(&start);
+        stats->rows++;
+
+        long shown = run->printed < IR_RUN_KEEP ? run->printed : IR_RUN_KEEP;
+        for (long k = 0; k < shown; k++)
+            put_value(writer, run->kept[k], k == 0);
+        end_row(writer, run->printed, run->status);
+    }
+    flush_rows(writer);
+    mem_free(writer);
+    mem_free(run);
+    free_reader(&reader);
+    return more == 0;
+}
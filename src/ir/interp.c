@@ -0,0 +1,256 @@
+/* interp.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/ir.h"
+#include "../../include/alloc.h"
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+static void record_print(IrRun* run, int value) {
+    if (run->printed < IR_RUN_KEEP)
+        run->kept[run->printed] = value;
+    run->printed++;
+    run->checksum = (run->checksum ^ (unsigned)value) * 1099511628211ul;
+}
+
+static void start_run(IrRun* run) {
+    memset(run, 0, sizeof(*run));
+    run->status = IR_RUN_DONE;
+    run->checksum = 14695981039346656037ul;
+}
+
+int ir_runs_agree(const IrRun* a, const IrRun* b) {
+    if (a->status != IR_RUN_STEP_LIMIT && b->status != IR_RUN_STEP_LIMIT)
+        return a->status == b->status && a->printed == b->printed && a->checksum == b->checksum;
+    long common = a->printed < b->printed ? a->printed : b->printed;
+    if (common > IR_RUN_KEEP)
+        common = IR_RUN_KEEP;
+    return memcmp(a->kept, b->kept, common * sizeof(int)) == 0;
+}
+
+// --------------------------------------------------------------------------
+// IR interpreter
+// --------------------------------------------------------------------------
+
+void ir_run(const IrProgram* program, const int* inputs, int input_count, long max_steps, IrRun* run) {
+    start_run(run);
+    int next_input = 0;
+    int* values = mem_calloc(MEM_IR, program->instr_count ? program->instr_count : 1, sizeof(int));
+    int* incoming = mem_calloc(MEM_IR, program->instr_count ? program->instr_count : 1, sizeof(int));
+    if (!values || !incoming)
+        out_of_memory();
+
+    int block = 0, previous = -1;
+    for (;;) {
+        const IrBlock* current = &program->blocks[block];
+        int i = 0;
+        // Phis read their operands before any of them is written
+        if (previous >= 0) {
+            int edge = ir_pred_index(program, block, previous);
+            int phis = 0;
+            while (phis < current->length && program->instrs[current->code[phis]].op == IR_PHI) {
+                incoming[phis] = values[program->instrs[current->code[phis]].phi_args[edge]];
+                phis++;
+            }
+            for (; i < phis; i++)
+                values[current->code[i]] = incoming[i];
+        }
+        int next = -1;
+        for (; i < current->length && next < 0; i++) {
+            int id = current->code[i];
+            const IrInstr* instr = &program->instrs[id];
+            if (++run->steps > max_steps) {
+                run->status = IR_RUN_STEP_LIMIT;
+                goto done;
+            }
+            int a = instr->args[0] >= 0 ? values[instr->args[0]] : 0;
+            int b = instr->args[1] >= 0 ? values[instr->args[1]] : 0;
+            switch (instr->op) {
+                case IR_CONST:
+                    values[id] = instr->imm;
+                    break;
+                case IR_READ:
+                    values[id] = next_input < input_count ? inputs[next_input++] : 0;
+                    break;
+                case IR_PRINT:
+                    record_print(run, a);
+                    break;
+                case IR_JUMP:
+                    next = current->succs[0];
+                    break;
+                case IR_BRANCH:
+                    next = current->succs[a ? 0 : 1];
+                    break;
+                case IR_RETURN:
+                    goto done;
+                case IR_MUL:
+                case IR_DIV:
+                    run->multiplies++;
+                    /* fall through */
+                default:
+                    if (!ir_evaluate(instr->op, a, b, &values[id])) {
+                        run->status = IR_RUN_DIVIDE_BY_ZERO;
+                        goto done;
+                    }
+                    break;
+            }
+        }
+        previous = block;
+        block = next;
+    }
+done:
+    mem_free(values);
+    mem_free(incoming);
+}
+
+// --------------------------------------------------------------------------
+// AST reference interpreter
+// --------------------------------------------------------------------------
+//
+// The semantics the IR must preserve, computed straight from the tree with
+// its own arithmetic. Every variable starts at 0.
+
+typedef struct {
+    IrVariables variables;
+    unsigned* values;
+    const int* inputs;
+    int input_count;
+    int next_input;
+    long max_steps;
+    IrRun* run;
+} Evaluator;
+
+static int stopped(Evaluator* evaluator) {
+    if (evaluator->run->status != IR_RUN_DONE)
+        return 1;
+    if (++evaluator->run->steps > evaluator->max_steps) {
+        evaluator->run->status = IR_RUN_STEP_LIMIT;
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned evaluate(Evaluator* evaluator, const ASTNode* node) {
+    if (stopped(evaluator))
+        return 0;
+    switch (node->type) {
+        case AST_NUMBER:
+            return (unsigned)ir_literal(node);
+        case AST_IDENTIFIER:
+            return evaluator->values[ir_variable_of(&evaluator->variables, node)];
+        case AST_FUNC_CALL: {
+            int n = (int)evaluate(evaluator, node->right);
+            unsigned product = 1;
+            for (int i = n; i > 1 && product; i--)
+                product *= (unsigned)i;
+            return product;
+        }
+        case AST_BINOP: {
+            unsigned x = node->left ? evaluate(evaluator, node->left) : 0;
+            unsigned y = evaluate(evaluator, node->right);
+            if (evaluator->run->status != IR_RUN_DONE)
+                return 0;
+            switch (node->token.op) {
+                case OP_ADD: return x + y;
+                case OP_SUB: return x - y;
+                case OP_MUL: return x * y;
+                case OP_EQ:  return x == y;
+                case OP_NE:  return x != y;
+                case OP_LT:  return (int)x < (int)y;
+                case OP_GT:  return (int)x > (int)y;
+                case OP_DIV:
+                    if (y == 0) {
+                        evaluator->run->status = IR_RUN_DIVIDE_BY_ZERO;
+                        return 0;
+                    }
+                    // Only INT_MIN / -1 overflows; it wraps to INT_MIN
+                    if (y == (unsigned)-1)
+                        return 0u - x;
+                    return (unsigned)((int)x / (int)y);
+                default:
+                    break;
+            }
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+static void execute(Evaluator* evaluator, const ASTNode* node);
+
+static void execute_statements(Evaluator* evaluator, const ASTNode* first) {
+    for (const ASTNode* statement = first; statement && !stopped(evaluator); statement = statement->next)
+        execute(evaluator, statement);
+}
+
+static void execute(Evaluator* evaluator, const ASTNode* node) {
+    unsigned value;
+    switch (node->type) {
+        case AST_VARDECL:
+            value = node->right ? evaluate(evaluator, node->right) : 0;
+            evaluator->values[ir_variable_of(&evaluator->variables, node)] = value;
+            break;
+        case AST_ASSIGN:
+            value = evaluate(evaluator, node->right);
+            evaluator->values[ir_variable_of(&evaluator->variables, node->left)] = value;
+            break;
+        case AST_PRINT:
+            value = evaluate(evaluator, node->left);
+            if (evaluator->run->status == IR_RUN_DONE)
+                record_print(evaluator->run, (int)value);
+            break;
+        case AST_READ:
+            value = evaluator->next_input < evaluator->input_count ?
+                    (unsigned)evaluator->inputs[evaluator->next_input++] : 0;
+            evaluator->values[ir_variable_of(&evaluator->variables, node->left)] = value;
+            break;
+        case AST_IF:
+            if (evaluate(evaluator, node->left))
+                execute_statements(evaluator, node->right->left);
+            else if (node->right->right)
+                execute_statements(evaluator, node->right->right->left);
+            break;
+        case AST_WHILE:
+            while (evaluate(evaluator, node->left) && evaluator->run->status == IR_RUN_DONE)
+                execute_statements(evaluator, node->right->left);
+            break;
+        case AST_REPEAT:
+            do
+                execute_statements(evaluator, node->left->left);
+            while (!evaluate(evaluator, node->right) && evaluator->run->status == IR_RUN_DONE);
+            break;
+        case AST_BLOCK:
+            execute_statements(evaluator, node->left);
+            break;
+        default:
+            evaluate(evaluator, node);
+            break;
+    }
+}
+
+void ir_run_ast(const ASTNode* ast, const int* inputs, int input_count, long max_steps, IrRun* run) {
+    start_run(run);
+    Evaluator evaluator = {0};
+    char error[160];
+    if (!ir_resolve_variables(ast, &evaluator.variables, error, sizeof(error)))
+        return;
+    evaluator.values = mem_calloc(MEM_IR, evaluator.variables.var_count + 1, sizeof(unsigned));
+    if (!evaluator.values)
+        out_of_memory();
+    evaluator.inputs = inputs;
+    evaluator.input_count = input_count;
+    evaluator.max_steps = max_steps;
+    evaluator.run = run;
+    for (const ASTNode* statement = ast; statement && !stopped(&evaluator); statement = statement->next)
+        if (statement->left)
+            execute(&evaluator, statement->left);
+    if (run->status == IR_RUN_STEP_LIMIT)
+        run->steps = max_steps;
+    mem_free(evaluator.values);
+    ir_free_variables(&evaluator.variables);
+}
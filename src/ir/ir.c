@@ -0,0 +1,1044 @@
+/* ir.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/ir.h"
+#include "../../include/alloc.h"
+#include "../../include/lexer.h"
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+// Grows *array so that it holds at least needed elements.
+static void reserve(void** array, int* capacity, int needed, size_t element) {
+    if (needed <= *capacity)
+        return;
+    int new_capacity = *capacity ? *capacity : 8;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    void* grown = mem_realloc(MEM_IR, *array, (size_t)new_capacity * element);
+    if (!grown)
+        out_of_memory();
+    *array = grown;
+    *capacity = new_capacity;
+}
+
+static void* table(size_t count, size_t element) {
+    void* block = mem_calloc(MEM_IR, count ? count : 1, element);
+    if (!block)
+        out_of_memory();
+    return block;
+}
+
+static unsigned hash_pointer(const void* pointer) {
+    unsigned long long bits = (unsigned long long)(size_t)pointer;
+    return (unsigned)((bits * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static unsigned hash_name(const char* name) {
+    unsigned hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)name; *c; c++)
+        hash = (hash ^ *c) * 16777619u;
+    return hash;
+}
+
+int ir_literal(const ASTNode* node) {
+    // The lexer's 64-bit value wraps the same way, so the low bits agree
+    return (int)(unsigned)node->token.value;
+}
+
+IrOp ir_operator(const ASTNode* binop) {
+    static const IrOp ops[OP_COUNT] = {
+        [OP_NONE] = IR_NOP,
+        [OP_EQ] = IR_EQ, [OP_NE] = IR_NE, [OP_LT] = IR_LT, [OP_GT] = IR_GT,
+        [OP_ADD] = IR_ADD, [OP_SUB] = IR_SUB, [OP_MUL] = IR_MUL, [OP_DIV] = IR_DIV
+    };
+    return binop->token.op < OP_COUNT ? ops[binop->token.op] : IR_NOP;
+}
+
+int ir_evaluate(IrOp op, int a, int b, int* result) {
+    unsigned x = (unsigned)a, y = (unsigned)b;
+    switch (op) {
+        case IR_ADD: *result = (int)(x + y); return 1;
+        case IR_SUB: *result = (int)(x - y); return 1;
+        case IR_MUL: *result = (int)(x * y); return 1;
+        case IR_SHL: *result = (int)(x << (y & 31)); return 1;
+        case IR_EQ:  *result = a == b; return 1;
+        case IR_NE:  *result = a != b; return 1;
+        case IR_LT:  *result = a < b; return 1;
+        case IR_GT:  *result = a > b; return 1;
+        case IR_DIV:
+            if (b == 0)
+                return 0;
+            *result = (b == -1) ? (int)(0u - x) : a / b;
+            return 1;
+        case IR_FACTORIAL: {
+            // Any 34 consecutive factors hold 2^32, so the product soon wraps to 0
+            unsigned product = 1;
+            for (int i = 2; i <= a && product; i++)
+                product *= (unsigned)i;
+            *result = (int)product;
+            return 1;
+        }
+        default:
+            return 0;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Name resolution
+// --------------------------------------------------------------------------
+
+typedef struct {
+    const char** names;      // Open-addressed: name -> latest declaration
+    int* vars;
+    int capacity;
+    int count;
+    char* error;
+    size_t error_size;
+} Scope;
+
+static void map_node(IrVariables* variables, const ASTNode* node, int var);
+
+static void grow_variables(IrVariables* variables) {
+    IrVariables old = *variables;
+    variables->capacity = old.capacity ? old.capacity * 2 : 256;
+    variables->nodes = table(variables->capacity, sizeof(const ASTNode*));
+    variables->vars = table(variables->capacity, sizeof(int));
+    for (int i = 0; i < old.capacity; i++)
+        if (old.nodes[i])
+            map_node(variables, old.nodes[i], old.vars[i]);
+    mem_free(old.nodes);
+    mem_free(old.vars);
+}
+
+static void map_node(IrVariables* variables, const ASTNode* node, int var) {
+    unsigned mask = (unsigned)variables->capacity - 1;
+    unsigned i = hash_pointer(node) & mask;
+    while (variables->nodes[i] && variables->nodes[i] != node)
+        i = (i + 1) & mask;
+    variables->nodes[i] = node;
+    variables->vars[i] = var;
+}
+
+static void bind(IrVariables* variables, const ASTNode* node, int var) {
+    if (2 * (variables->node_count + 1) > variables->capacity)
+        grow_variables(variables);
+    map_node(variables, node, var);
+    variables->node_count++;
+}
+
+int ir_variable_of(const IrVariables* variables, const ASTNode* node) {
+    if (!variables->capacity)
+        return -1;
+    unsigned mask = (unsigned)variables->capacity - 1;
+    for (unsigned i = hash_pointer(node) & mask; variables->nodes[i]; i = (i + 1) & mask)
+        if (variables->nodes[i] == node)
+            return variables->vars[i];
+    return -1;
+}
+
+static void declare(Scope* scope, const char* name, int var) {
+    if (2 * (scope->count + 1) > scope->capacity) {
+        Scope old = *scope;
+        scope->capacity = old.capacity ? old.capacity * 2 : 64;
+        scope->names = table(scope->capacity, sizeof(const char*));
+        scope->vars = table(scope->capacity, sizeof(int));
+        scope->count = 0;
+        for (int i = 0; i < old.capacity; i++)
+            if (old.names[i])
+                declare(scope, old.names[i], old.vars[i]);
+        mem_free(old.names);
+        mem_free(old.vars);
+    }
+    unsigned mask = (unsigned)scope->capacity - 1;
+    unsigned i = hash_name(name) & mask;
+    while (scope->names[i] && strcmp(scope->names[i], name) != 0)
+        i = (i + 1) & mask;
+    if (!scope->names[i])
+        scope->count++;
+    scope->names[i] = name;
+    scope->vars[i] = var;
+}
+
+static int lookup(const Scope* scope, const char* name) {
+    if (!scope->capacity)
+        return -1;
+    unsigned mask = (unsigned)scope->capacity - 1;
+    for (unsigned i = hash_name(name) & mask; scope->names[i]; i = (i + 1) & mask)
+        if (strcmp(scope->names[i], name) == 0)
+            return scope->vars[i];
+    return -1;
+}
+
+static int resolve_use(IrVariables* variables, Scope* scope, const ASTNode* use, const ASTNode* node) {
+    int var = lookup(scope, token_name(&use->token));
+    if (var < 0) {
+        snprintf(scope->error, scope->error_size, "'%s' on line %d has no declaration",
+                 token_name(&use->token), token_line(use->token));
+        return 0;
+    }
+    bind(variables, node, var);
+    return 1;
+}
+
+static int resolve_node(IrVariables* variables, Scope* scope, const ASTNode* node);
+
+static int resolve_statements(IrVariables* variables, Scope* scope, const ASTNode* first) {
+    for (const ASTNode* statement = first; statement; statement = statement->next)
+        if (!resolve_node(variables, scope, statement))
+            return 0;
+    return 1;
+}
+
+static int resolve_node(IrVariables* variables, Scope* scope, const ASTNode* node) {
+    if (!node)
+        return 1;
+    switch (node->type) {
+        case AST_VARDECL:
+            // Declared before its initializer is read, as the checker does
+            declare(scope, token_name(&node->token), variables->var_count);
+            bind(variables, node, variables->var_count++);
+            return resolve_node(variables, scope, node->right);
+        case AST_ASSIGN:
+            return resolve_use(variables, scope, node->left, node->left) &&
+                   resolve_use(variables, scope, node->left, node) &&
+                   resolve_node(variables, scope, node->right);
+        case AST_IDENTIFIER:
+            return resolve_use(variables, scope, node, node);
+        case AST_FUNC_CALL:
+            return resolve_node(variables, scope, node->right);
+        case AST_IF:
+            return resolve_node(variables, scope, node->left) &&
+                   resolve_statements(variables, scope, node->right->left) &&
+                   (!node->right->right || resolve_statements(variables, scope, node->right->right->left));
+        case AST_BLOCK:
+            return resolve_statements(variables, scope, node->left);
+        default:
+            return resolve_node(variables, scope, node->left) &&
+                   resolve_node(variables, scope, node->right);
+    }
+}
+
+int ir_resolve_variables(const ASTNode* ast, IrVariables* variables, char* error, size_t size) {
+    memset(variables, 0, sizeof(*variables));
+    Scope scope = {0};
+    scope.error = error;
+    scope.error_size = size;
+    int ok = 1;
+    for (const ASTNode* program = ast; ok && program; program = program->next)
+        ok = resolve_node(variables, &scope, program->left);
+    mem_free(scope.names);
+    mem_free(scope.vars);
+    if (!ok)
+        ir_free_variables(variables);
+    return ok;
+}
+
+void ir_free_variables(IrVariables* variables) {
+    mem_free(variables->nodes);
+    mem_free(variables->vars);
+    memset(variables, 0, sizeof(*variables));
+}
+
+// --------------------------------------------------------------------------
+// Program construction
+// --------------------------------------------------------------------------
+
+int ir_add_instr(IrProgram* program, IrOp op, int a, int b, int line) {
+    reserve((void**)&program->instrs, &program->instr_capacity, program->instr_count + 1, sizeof(IrInstr));
+    IrInstr* instr = &program->instrs[program->instr_count];
+    memset(instr, 0, sizeof(*instr));
+    instr->op = op;
+    instr->block = -1;
+    instr->args[0] = a;
+    instr->args[1] = b;
+    instr->line = line;
+    return program->instr_count++;
+}
+
+void ir_insert(IrProgram* program, int block, int position, int instr) {
+    IrBlock* target = &program->blocks[block];
+    reserve((void**)&target->code, &target->capacity, target->length + 1, sizeof(int));
+    memmove(&target->code[position + 1], &target->code[position],
+            (size_t)(target->length - position) * sizeof(int));
+    target->code[position] = instr;
+    target->length++;
+    program->instrs[instr].block = block;
+}
+
+void ir_remove(IrProgram* program, int instr) {
+    IrInstr* removed = &program->instrs[instr];
+    removed->op = IR_NOP;
+    removed->block = -1;
+    mem_free(removed->phi_args);
+    removed->phi_args = NULL;
+}
+
+void ir_compact(IrProgram* program) {
+    for (int b = 0; b < program->block_count; b++) {
+        IrBlock* block = &program->blocks[b];
+        int kept = 0;
+        for (int i = 0; i < block->length; i++) {
+            int instr = block->code[i];
+            if (instr >= 0 && program->instrs[instr].op != IR_NOP && program->instrs[instr].block == b)
+                block->code[kept++] = instr;
+        }
+        block->length = kept;
+    }
+}
+
+int ir_constant(IrProgram* program, int value) {
+    IrBlock* entry = &program->blocks[0];
+    for (int i = 0; i < entry->length; i++) {
+        const IrInstr* instr = &program->instrs[entry->code[i]];
+        if (instr->op == IR_CONST && instr->imm == value)
+            return entry->code[i];
+        if (instr->op != IR_CONST)
+            break;
+    }
+    int constant = ir_add_instr(program, IR_CONST, -1, -1, 0);
+    program->instrs[constant].imm = value;
+    ir_insert(program, 0, 0, constant);
+    return constant;
+}
+
+static int add_block(IrProgram* program) {
+    reserve((void**)&program->blocks, &program->block_capacity, program->block_count + 1, sizeof(IrBlock));
+    IrBlock* block = &program->blocks[program->block_count];
+    memset(block, 0, sizeof(*block));
+    block->succs[0] = block->succs[1] = -1;
+    return program->block_count++;
+}
+
+static void add_edge(IrProgram* program, int from, int to) {
+    IrBlock* source = &program->blocks[from];
+    source->succs[source->succs[0] < 0 ? 0 : 1] = to;
+    IrBlock* target = &program->blocks[to];
+    reserve((void**)&target->preds, &target->pred_capacity, target->pred_count + 1, sizeof(int));
+    target->preds[target->pred_count++] = from;
+}
+
+int ir_pred_index(const IrProgram* program, int block, int pred) {
+    const IrBlock* target = &program->blocks[block];
+    for (int i = 0; i < target->pred_count; i++)
+        if (target->preds[i] == pred)
+            return i;
+    return -1;
+}
+
+int ir_instruction_count(const IrProgram* program) {
+    int count = 0;
+    for (int b = 0; b < program->block_count; b++)
+        for (int i = 0; i < program->blocks[b].length; i++)
+            count += program->instrs[program->blocks[b].code[i]].op != IR_NOP;
+    return count;
+}
+
+void ir_free(IrProgram* program) {
+    if (!program)
+        return;
+    for (int i = 0; i < program->instr_count; i++)
+        mem_free(program->instrs[i].phi_args);
+    for (int b = 0; b < program->block_count; b++) {
+        mem_free(program->blocks[b].code);
+        mem_free(program->blocks[b].preds);
+    }
+    mem_free(program->instrs);
+    mem_free(program->blocks);
+    mem_free(program);
+}
+
+// --------------------------------------------------------------------------
+// Lowering
+// --------------------------------------------------------------------------
+//
+// Statements are lowered in order while current[] holds each variable's value
+// at the insertion point. Every write is logged with the value it replaced,
+// so a branch can be undone once its effect is known: an if joins the two
+// outcomes of each variable either arm wrote with a phi, and a loop gives
+// each variable its body writes a phi in the loop header up front, filling in
+// the value carried around the back edge after lowering the body. Phis that
+// end up choosing between one value and themselves are folded away at the end.
+
+typedef struct {
+    int var;
+    int value;
+} Write;
+
+typedef struct {
+    IrProgram* program;
+    IrVariables variables;
+    int* current;            // Value of each variable, -1 before its declaration
+    Write* log;              // Undo log: each write with the value it replaced
+    int log_length;
+    int log_capacity;
+    int* stamp;              // Per variable, for collecting distinct variables
+    int clock;
+    int block;               // Insertion point: end of this block
+    int zero;
+} Lowering;
+
+static int emit(Lowering* lowering, IrOp op, int a, int b, int line) {
+    int instr = ir_add_instr(lowering->program, op, a, b, line);
+    IrBlock* block = &lowering->program->blocks[lowering->block];
+    ir_insert(lowering->program, lowering->block, block->length, instr);
+    return instr;
+}
+
+static void jump(Lowering* lowering, int target) {
+    emit(lowering, IR_JUMP, -1, -1, 0);
+    add_edge(lowering->program, lowering->block, target);
+}
+
+static void branch(Lowering* lowering, int condition, int taken, int not_taken) {
+    emit(lowering, IR_BRANCH, condition, -1, 0);
+    add_edge(lowering->program, lowering->block, taken);
+    add_edge(lowering->program, lowering->block, not_taken);
+}
+
+static int add_phi(Lowering* lowering, int block, int line) {
+    IrProgram* program = lowering->program;
+    int phi = ir_add_instr(program, IR_PHI, -1, -1, line);
+    program->instrs[phi].phi_args = table(2, sizeof(int));
+    int position = 0;
+    while (position < program->blocks[block].length &&
+           program->instrs[program->blocks[block].code[position]].op == IR_PHI)
+        position++;
+    ir_insert(program, block, position, phi);
+    return phi;
+}
+
+static void write_variable(Lowering* lowering, int var, int value) {
+    reserve((void**)&lowering->log, &lowering->log_capacity, lowering->log_length + 1, sizeof(Write));
+    lowering->log[lowering->log_length++] = (Write){var, lowering->current[var]};
+    lowering->current[var] = value;
+}
+
+static int read_variable(Lowering* lowering, int var) {
+    int value = lowering->current[var];
+    return value >= 0 ? value : lowering->zero;
+}
+
+static void undo_writes(Lowering* lowering, int mark) {
+    while (lowering->log_length > mark) {
+        const Write* write = &lowering->log[--lowering->log_length];
+        lowering->current[write->var] = write->value;
+    }
+}
+
+typedef struct {
+    Write* writes;           // Distinct variables
+    int count;
+    int capacity;
+} VariableSet;
+
+static void set_add(VariableSet* set, int var, int value) {
+    reserve((void**)&set->writes, &set->capacity, set->count + 1, sizeof(Write));
+    set->writes[set->count++] = (Write){var, value};
+}
+
+// Adds each variable written since mark (once) with its current value.
+static void collect_writes(Lowering* lowering, int mark, VariableSet* set) {
+    lowering->clock++;
+    for (int i = 0; i < set->count; i++)
+        lowering->stamp[set->writes[i].var] = lowering->clock;
+    for (int i = mark; i < lowering->log_length; i++) {
+        int var = lowering->log[i].var;
+        if (lowering->stamp[var] != lowering->clock) {
+            lowering->stamp[var] = lowering->clock;
+            set_add(set, var, lowering->current[var]);
+        }
+    }
+}
+
+// Adds each variable a statement list may write.
+static void collect_assigned(Lowering* lowering, const ASTNode* first, VariableSet* set) {
+    for (const ASTNode* statement = first; statement; statement = statement->next) {
+        int var = -1;
+        switch (statement->type) {
+            case AST_VARDECL:
+                var = ir_variable_of(&lowering->variables, statement);
+                break;
+            case AST_ASSIGN:
+            case AST_READ:
+                var = ir_variable_of(&lowering->variables, statement->left);
+                break;
+            case AST_IF:
+                collect_assigned(lowering, statement->right->left, set);
+                if (statement->right->right)
+                    collect_assigned(lowering, statement->right->right->left, set);
+                break;
+            case AST_WHILE:
+                collect_assigned(lowering, statement->right->left, set);
+                break;
+            case AST_REPEAT:
+                collect_assigned(lowering, statement->left->left, set);
+                break;
+            case AST_BLOCK:
+                collect_assigned(lowering, statement->left, set);
+                break;
+            default:
+                break;
+        }
+        if (var >= 0 && lowering->stamp[var] != lowering->clock) {
+            lowering->stamp[var] = lowering->clock;
+            set_add(set, var, -1);
+        }
+    }
+}
+
+static int lower_expression(Lowering* lowering, const ASTNode* node) {
+    int line = token_line(node->token);
+    switch (node->type) {
+        case AST_NUMBER: {
+            int constant = emit(lowering, IR_CONST, -1, -1, line);
+            lowering->program->instrs[constant].imm = ir_literal(node);
+            return constant;
+        }
+        case AST_IDENTIFIER:
+            return read_variable(lowering, ir_variable_of(&lowering->variables, node));
+        case AST_FUNC_CALL:
+            return emit(lowering, IR_FACTORIAL, lower_expression(lowering, node->right), -1, line);
+        case AST_BINOP: {
+            IrOp op = ir_operator(node);
+            // A prefix operator has no left operand and applies to 0
+            int left = node->left ? lower_expression(lowering, node->left) : lowering->zero;
+            int right = lower_expression(lowering, node->right);
+            return emit(lowering, op, left, right, line);
+        }
+        default:
+            return lowering->zero;
+    }
+}
+
+static void lower_statement(Lowering* lowering, const ASTNode* node);
+
+static void lower_statements(Lowering* lowering, const ASTNode* first) {
+    for (const ASTNode* statement = first; statement; statement = statement->next)
+        lower_statement(lowering, statement);
+}
+
+// Phis in header for every variable the loop body may write; their first
+// operand is the value on entry.
+static int* open_loop(Lowering* lowering, const ASTNode* body, int header, int line, VariableSet* assigned) {
+    lowering->clock++;
+    collect_assigned(lowering, body, assigned);
+    int* phis = table(assigned->count, sizeof(int));
+    for (int i = 0; i < assigned->count; i++) {
+        phis[i] = add_phi(lowering, header, line);
+        lowering->program->instrs[phis[i]].phi_args[0] = read_variable(lowering, assigned->writes[i].var);
+        write_variable(lowering, assigned->writes[i].var, phis[i]);
+    }
+    return phis;
+}
+
+static void close_loop(Lowering* lowering, int* phis, const VariableSet* assigned) {
+    for (int i = 0; i < assigned->count; i++)
+        lowering->program->instrs[phis[i]].phi_args[1] = read_variable(lowering, assigned->writes[i].var);
+    mem_free(phis);
+}
+
+static void lower_if(Lowering* lowering, const ASTNode* node) {
+    IrProgram* program = lowering->program;
+    const ASTNode* else_block = node->right->right;
+    int condition = lower_expression(lowering, node->left);
+    int then_start = add_block(program);
+    int else_start = else_block ? add_block(program) : -1;
+    int merge = add_block(program);
+    int head = lowering->block;
+    branch(lowering, condition, then_start, else_block ? else_start : merge);
+
+    int mark = lowering->log_length;
+    VariableSet then_writes = {0}, else_writes = {0};
+    lowering->block = then_start;
+    lower_statements(lowering, node->right->left);
+    int then_end = lowering->block;
+    jump(lowering, merge);
+    collect_writes(lowering, mark, &then_writes);
+    undo_writes(lowering, mark);
+
+    int else_end = head;
+    if (else_block) {
+        lowering->block = else_start;
+        lower_statements(lowering, else_block->left);
+        else_end = lowering->block;
+        jump(lowering, merge);
+        collect_writes(lowering, mark, &else_writes);
+        undo_writes(lowering, mark);
+    }
+
+    // Variables written on one side only keep their earlier value on the other
+    lowering->block = merge;
+    int then_index = ir_pred_index(program, merge, then_end);
+    int else_index = ir_pred_index(program, merge, else_end);
+    for (int side = 0; side < 2; side++) {
+        const VariableSet* writes = side ? &else_writes : &then_writes;
+        const VariableSet* other = side ? &then_writes : &else_writes;
+        for (int i = 0; i < writes->count; i++) {
+            int var = writes->writes[i].var;
+            int other_value = read_variable(lowering, var);
+            int found = 0;
+            for (int j = 0; j < other->count && !found; j++)
+                if (other->writes[j].var == var) {
+                    other_value = other->writes[j].value;
+                    found = 1;
+                }
+            if (side && found)
+                continue;    // Joined on the first pass
+            int value = writes->writes[i].value;
+            if (value != other_value) {
+                int phi = add_phi(lowering, merge, token_line(node->token));
+                program->instrs[phi].phi_args[side ? else_index : then_index] = value;
+                program->instrs[phi].phi_args[side ? then_index : else_index] = other_value;
+                value = phi;
+            }
+            write_variable(lowering, var, value);
+        }
+    }
+    mem_free(then_writes.writes);
+    mem_free(else_writes.writes);
+}
+
+static void lower_while(Lowering* lowering, const ASTNode* node) {
+    IrProgram* program = lowering->program;
+    int header = add_block(program);
+    jump(lowering, header);
+    lowering->block = header;
+    VariableSet assigned = {0};
+    int* phis = open_loop(lowering, node->right->left, header, token_line(node->token), &assigned);
+    int condition = lower_expression(lowering, node->left);
+    int body = add_block(program);
+    int exit = add_block(program);
+    branch(lowering, condition, body, exit);
+
+    // The loop is left from the header, where the phis hold every value
+    int mark = lowering->log_length;
+    lowering->block = body;
+    lower_statements(lowering, node->right->left);
+    jump(lowering, header);
+    close_loop(lowering, phis, &assigned);
+    undo_writes(lowering, mark);
+    lowering->block = exit;
+    mem_free(assigned.writes);
+}
+
+static void lower_repeat(Lowering* lowering, const ASTNode* node) {
+    IrProgram* program = lowering->program;
+    int body = add_block(program);
+    jump(lowering, body);
+    lowering->block = body;
+    VariableSet assigned = {0};
+    int* phis = open_loop(lowering, node->left->left, body, token_line(node->token), &assigned);
+    lower_statements(lowering, node->left->left);
+    int condition = lower_expression(lowering, node->right);
+    int exit = add_block(program);
+    branch(lowering, condition, exit, body);
+    // The loop is left from its end, with the values of the last iteration
+    close_loop(lowering, phis, &assigned);
+    lowering->block = exit;
+    mem_free(assigned.writes);
+}
+
+static void lower_statement(Lowering* lowering, const ASTNode* node) {
+    int line = token_line(node->token);
+    switch (node->type) {
+        case AST_VARDECL:
+            write_variable(lowering, ir_variable_of(&lowering->variables, node),
+                           node->right ? lower_expression(lowering, node->right) : lowering->zero);
+            break;
+        case AST_ASSIGN:
+            write_variable(lowering, ir_variable_of(&lowering->variables, node->left),
+                           lower_expression(lowering, node->right));
+            break;
+        case AST_PRINT:
+            emit(lowering, IR_PRINT, lower_expression(lowering, node->left), -1, line);
+            break;
+        case AST_READ:
+            write_variable(lowering, ir_variable_of(&lowering->variables, node->left),
+                           emit(lowering, IR_READ, -1, -1, line));
+            break;
+        case AST_IF:
+            lower_if(lowering, node);
+            break;
+        case AST_WHILE:
+            lower_while(lowering, node);
+            break;
+        case AST_REPEAT:
+            lower_repeat(lowering, node);
+            break;
+        case AST_BLOCK:
+            lower_statements(lowering, node->left);
+            break;
+        default:
+            // A bare expression statement: evaluated for its traps only
+            lower_expression(lowering, node);
+            break;
+    }
+}
+
+// Folds phis whose operands are all one value or the phi itself, until none
+// is left, and points every use at what remains.
+static void remove_trivial_phis(IrProgram* program) {
+    int* alias = table(program->instr_count, sizeof(int));
+    for (int i = 0; i < program->instr_count; i++)
+        alias[i] = i;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < program->instr_count; i++) {
+            IrInstr* phi = &program->instrs[i];
+            if (phi->op != IR_PHI)
+                continue;
+            int count = program->blocks[phi->block].pred_count;
+            int same = -1, trivial = 1;
+            for (int k = 0; k < count && trivial; k++) {
+                int arg = phi->phi_args[k];
+                while (alias[arg] != arg)
+                    arg = alias[arg];
+                phi->phi_args[k] = arg;
+                if (arg == i || arg == same)
+                    continue;
+                if (same >= 0)
+                    trivial = 0;
+                same = arg;
+            }
+            if (trivial && same >= 0) {
+                alias[i] = same;
+                ir_remove(program, i);
+                changed = 1;
+            }
+        }
+    }
+    for (int i = 0; i < program->instr_count; i++) {
+        IrInstr* instr = &program->instrs[i];
+        if (instr->op == IR_NOP)
+            continue;
+        for (int k = 0; k < 2; k++)
+            while (instr->args[k] >= 0 && alias[instr->args[k]] != instr->args[k])
+                instr->args[k] = alias[instr->args[k]];
+        if (instr->op == IR_PHI)
+            for (int k = 0; k < program->blocks[instr->block].pred_count; k++)
+                while (alias[instr->phi_args[k]] != instr->phi_args[k])
+                    instr->phi_args[k] = alias[instr->phi_args[k]];
+    }
+    mem_free(alias);
+    ir_compact(program);
+}
+
+IrProgram* ir_lower(const ASTNode* ast, char* error, size_t size) {
+    Lowering lowering = {0};
+    if (!ir_resolve_variables(ast, &lowering.variables, error, size))
+        return NULL;
+    IrProgram* program = table(1, sizeof(IrProgram));
+    lowering.program = program;
+    int vars = lowering.variables.var_count;
+    lowering.current = table(vars, sizeof(int));
+    lowering.stamp = table(vars, sizeof(int));
+    for (int i = 0; i < vars; i++)
+        lowering.current[i] = -1;
+
+    lowering.block = add_block(program);
+    lowering.zero = emit(&lowering, IR_CONST, -1, -1, 0);
+    for (const ASTNode* statement = ast; statement; statement = statement->next)
+        if (statement->left)
+            lower_statement(&lowering, statement->left);
+    emit(&lowering, IR_RETURN, -1, -1, 0);
+    remove_trivial_phis(program);
+
+    mem_free(lowering.current);
+    mem_free(lowering.stamp);
+    mem_free(lowering.log);
+    ir_free_variables(&lowering.variables);
+    return program;
+}
+
+// --------------------------------------------------------------------------
+// Dominators
+// --------------------------------------------------------------------------
+//
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder.
+// The tree is then numbered depth-first so that dominance is an interval test.
+
+void ir_dominators(const IrProgram* program, IrDominators* dom) {
+    int n = program->block_count;
+    dom->idom = table(n, sizeof(int));
+    dom->order = table(n, sizeof(int));
+    dom->rank = table(n, sizeof(int));
+    dom->enter = table(n, sizeof(int));
+    dom->leave = table(n, sizeof(int));
+    dom->count = 0;
+
+    // Postorder by iterative depth-first search
+    int* stack = table(n, sizeof(int));
+    int* edge = table(n, sizeof(int));
+    char* seen = table(n, 1);
+    int* post = table(n, sizeof(int));
+    int post_count = 0, depth = 0;
+    stack[depth++] = 0;
+    seen[0] = 1;
+    while (depth) {
+        int b = stack[depth - 1];
+        if (edge[b] < 2 && program->blocks[b].succs[edge[b]] >= 0) {
+            int s = program->blocks[b].succs[edge[b]++];
+            if (!seen[s]) {
+                seen[s] = 1;
+                stack[depth++] = s;
+            }
+        } else {
+            post[post_count++] = b;
+            depth--;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        dom->idom[i] = -1;
+        dom->rank[i] = -1;
+    }
+    for (int i = 0; i < post_count; i++) {
+        dom->order[i] = post[post_count - 1 - i];
+        dom->rank[dom->order[i]] = i;
+    }
+    dom->count = post_count;
+
+    dom->idom[0] = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < post_count; i++) {
+            int b = dom->order[i];
+            int new_idom = -1;
+            for (int p = 0; p < program->blocks[b].pred_count; p++) {
+                int pred = program->blocks[b].preds[p];
+                if (dom->idom[pred] < 0)
+                    continue;
+                if (new_idom < 0) {
+                    new_idom = pred;
+                    continue;
+                }
+                int x = pred, y = new_idom;
+                while (x != y) {
+                    while (dom->rank[x] > dom->rank[y])
+                        x = dom->idom[x];
+                    while (dom->rank[y] > dom->rank[x])
+                        y = dom->idom[y];
+                }
+                new_idom = x;
+            }
+            if (dom->idom[b] != new_idom) {
+                dom->idom[b] = new_idom;
+                changed = 1;
+            }
+        }
+    }
+
+    // Tree children, then interval numbering
+    dom->first_child = table(n, sizeof(int));
+    dom->next_sibling = table(n, sizeof(int));
+    for (int i = 0; i < n; i++)
+        dom->first_child[i] = dom->next_sibling[i] = -1;
+    for (int i = post_count - 1; i > 0; i--) {
+        int b = dom->order[i];
+        dom->next_sibling[b] = dom->first_child[dom->idom[b]];
+        dom->first_child[dom->idom[b]] = b;
+    }
+    int clock = 0;
+    depth = 0;
+    stack[depth++] = 0;
+    dom->enter[0] = clock++;
+    for (int i = 0; i < n; i++)
+        edge[i] = -2;
+    while (depth) {
+        int b = stack[depth - 1];
+        int child = edge[b] == -2 ? dom->first_child[b] : (edge[b] >= 0 ? dom->next_sibling[edge[b]] : -1);
+        if (child >= 0) {
+            edge[b] = child;
+            dom->enter[child] = clock++;
+            stack[depth++] = child;
+        } else {
+            dom->leave[b] = clock++;
+            depth--;
+        }
+    }
+    mem_free(stack);
+    mem_free(edge);
+    mem_free(seen);
+    mem_free(post);
+    dom->idom[0] = -1;
+}
+
+int ir_dominates(const IrDominators* dom, int a, int b) {
+    if (dom->rank[a] < 0 || dom->rank[b] < 0)
+        return 0;
+    return dom->enter[a] <= dom->enter[b] && dom->leave[b] <= dom->leave[a];
+}
+
+void ir_free_dominators(IrDominators* dom) {
+    mem_free(dom->idom);
+    mem_free(dom->order);
+    mem_free(dom->rank);
+    mem_free(dom->enter);
+    mem_free(dom->leave);
+    mem_free(dom->first_child);
+    mem_free(dom->next_sibling);
+    memset(dom, 0, sizeof(*dom));
+}
+
+// --------------------------------------------------------------------------
+// Dumping and verification
+// --------------------------------------------------------------------------
+
+static const char* op_names[IR_OP_COUNT] = {
+    "nop", "const", "phi", "add", "sub", "mul", "div", "shl", "eq", "ne", "lt", "gt",
+    "factorial", "read", "print", "jump", "branch", "return"
+};
+
+void ir_dump(FILE* out, const IrProgram* program) {
+    for (int b = 0; b < program->block_count; b++) {
+        const IrBlock* block = &program->blocks[b];
+        fprintf(out, "b%d:", b);
+        if (block->pred_count) {
+            fprintf(out, "  ; preds");
+            for (int p = 0; p < block->pred_count; p++)
+                fprintf(out, " b%d", block->preds[p]);
+        }
+        fprintf(out, "\n");
+        for (int i = 0; i < block->length; i++) {
+            int id = block->code[i];
+            const IrInstr* instr = &program->instrs[id];
+            switch (instr->op) {
+                case IR_CONST:
+                    fprintf(out, "    v%d = const %d\n", id, instr->imm);
+                    break;
+                case IR_PHI:
+                    fprintf(out, "    v%d = phi", id);
+                    for (int p = 0; p < block->pred_count; p++)
+                        fprintf(out, "%s [v%d, b%d]", p ? "," : "", instr->phi_args[p], block->preds[p]);
+                    fprintf(out, "\n");
+                    break;
+                case IR_FACTORIAL:
+                    fprintf(out, "    v%d = factorial v%d\n", id, instr->args[0]);
+                    break;
+                case IR_READ:
+                    fprintf(out, "    v%d = read\n", id);
+                    break;
+                case IR_PRINT:
+                    fprintf(out, "    print v%d\n", instr->args[0]);
+                    break;
+                case IR_JUMP:
+                    fprintf(out, "    jump b%d\n", block->succs[0]);
+                    break;
+                case IR_BRANCH:
+                    fprintf(out, "    branch v%d, b%d, b%d\n", instr->args[0], block->succs[0], block->succs[1]);
+                    break;
+                case IR_RETURN:
+                    fprintf(out, "    return\n");
+                    break;
+                default:
+                    fprintf(out, "    v%d = %s v%d, v%d\n", id, op_names[instr->op], instr->args[0], instr->args[1]);
+                    break;
+            }
+        }
+    }
+}
+
+static int operand_count(IrOp op) {
+    switch (op) {
+        case IR_CONST: case IR_PHI: case IR_READ: case IR_JUMP: case IR_RETURN: case IR_NOP:
+            return 0;
+        case IR_FACTORIAL: case IR_PRINT: case IR_BRANCH:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+static int is_terminator(IrOp op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+int ir_verify(const IrProgram* program, char* error, size_t size) {
+    int* position = table(program->instr_count, sizeof(int));
+    IrDominators dom;
+    ir_dominators(program, &dom);
+    int ok = 1;
+
+    for (int b = 0; ok && b < program->block_count; b++) {
+        const IrBlock* block = &program->blocks[b];
+        if (dom.rank[b] < 0) {
+            snprintf(error, size, "b%d is unreachable", b);
+            ok = 0;
+        } else if (!block->length || !is_terminator(program->instrs[block->code[block->length - 1]].op)) {
+            snprintf(error, size, "b%d does not end in a terminator", b);
+            ok = 0;
+        }
+        int successors = 0;
+        for (int s = 0; ok && s < 2; s++) {
+            int succ = block->succs[s];
+            if (succ < 0)
+                continue;
+            successors++;
+            if (ir_pred_index(program, succ, b) < 0) {
+                snprintf(error, size, "b%d is not a predecessor of its successor b%d", b, succ);
+                ok = 0;
+            }
+        }
+        for (int p = 0; ok && p < block->pred_count; p++) {
+            const IrBlock* pred = &program->blocks[block->preds[p]];
+            if (pred->succs[0] != b && pred->succs[1] != b) {
+                snprintf(error, size, "b%d lists b%d as a predecessor", b, block->preds[p]);
+                ok = 0;
+            }
+        }
+        int phis_done = 0;
+        for (int i = 0; ok && i < block->length; i++) {
+            int id = block->code[i];
+            const IrInstr* instr = &program->instrs[id];
+            position[id] = i;
+            if (instr->op == IR_NOP || instr->block != b) {
+                snprintf(error, size, "v%d is listed in b%d but not part of it", id, b);
+                ok = 0;
+            } else if (instr->op == IR_PHI && phis_done) {
+                snprintf(error, size, "phi v%d follows other instructions in b%d", id, b);
+                ok = 0;
+            } else if (is_terminator(instr->op) && i != block->length - 1) {
+                snprintf(error, size, "terminator v%d is not last in b%d", id, b);
+                ok = 0;
+            } else if (is_terminator(instr->op) &&
+                       successors != (instr->op == IR_BRANCH ? 2 : instr->op == IR_JUMP ? 1 : 0)) {
+                snprintf(error, size, "b%d has %d successors for its %s", b, successors, op_names[instr->op]);
+                ok = 0;
+            }
+            phis_done |= instr->op != IR_PHI;
+        }
+    }
+
+    // Every operand is defined where it is used: before it in the same
+    // block or in a dominating one, and for a phi at the end of the edge
+    for (int b = 0; ok && b < program->block_count; b++) {
+        const IrBlock* block = &program->blocks[b];
+        for (int i = 0; ok && i < block->length; i++) {
+            int id = block->code[i];
+            const IrInstr* instr = &program->instrs[id];
+            int count = instr->op == IR_PHI ? block->pred_count : operand_count(instr->op);
+            for (int k = 0; ok && k < count; k++) {
+                int arg = instr->op == IR_PHI ? instr->phi_args[k] : instr->args[k];
+                int use_block = instr->op == IR_PHI ? block->preds[k] : b;
+                const IrInstr* def = arg >= 0 && arg < program->instr_count ? &program->instrs[arg] : NULL;
+                if (!def || def->op == IR_NOP || def->block < 0 ||
+                    def->op == IR_PRINT || is_terminator(def->op)) {
+                    snprintf(error, size, "v%d uses v%d, which defines no value", id, arg);
+                    ok = 0;
+                } else if (def->block == use_block ? (instr->op != IR_PHI && position[arg] >= i)
+                                                   : !ir_dominates(&dom, def->block, use_block)) {
+                    snprintf(error, size, "v%d in b%d uses v%d, which does not dominate it", id, b, arg);
+                    ok = 0;
+                }
+            }
+        }
+    }
+    ir_free_dominators(&dom);
+    mem_free(position);
+    return ok;
+}
@@ -0,0 +1,759 @@
+/* passes.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/ir.h"
+#include "../../include/alloc.h"
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+static void* table(size_t count, size_t element) {
+    void* block = mem_calloc(MEM_IR, count ? count : 1, element);
+    if (!block)
+        out_of_memory();
+    return block;
+}
+
+static void* grow(void* block, size_t count, size_t element) {
+    void* grown = mem_realloc(MEM_IR, block, (count ? count : 1) * element);
+    if (!grown)
+        out_of_memory();
+    return grown;
+}
+
+static int is_constant(const IrProgram* program, int value, int* constant) {
+    if (program->instrs[value].op != IR_CONST)
+        return 0;
+    *constant = program->instrs[value].imm;
+    return 1;
+}
+
+// Side-effect free and cannot trap, so it may run where it did not before.
+static int is_speculatable(const IrProgram* program, const IrInstr* instr) {
+    int divisor;
+    switch (instr->op) {
+        case IR_CONST: case IR_ADD: case IR_SUB: case IR_MUL: case IR_SHL:
+        case IR_EQ: case IR_NE: case IR_LT: case IR_GT: case IR_FACTORIAL:
+            return 1;
+        case IR_DIV:
+            return is_constant(program, instr->args[1], &divisor) && divisor != 0;
+        default:
+            return 0;
+    }
+}
+
+// Points every operand at its replacement, following chains. Values from
+// count on were added since replacement was sized and stand for themselves.
+static void apply_replacements(IrProgram* program, const int* replacement, int count) {
+    for (int i = 0; i < program->instr_count; i++) {
+        IrInstr* instr = &program->instrs[i];
+        if (instr->op == IR_NOP)
+            continue;
+        int total = instr->op == IR_PHI ? program->blocks[instr->block].pred_count : 2;
+        for (int k = 0; k < total; k++) {
+            int* arg = instr->op == IR_PHI ? &instr->phi_args[k] : &instr->args[k];
+            while (*arg >= 0 && *arg < count && replacement[*arg] != *arg)
+                *arg = replacement[*arg];
+        }
+    }
+}
+
+static int* identity(int count) {
+    int* replacement = table(count, sizeof(int));
+    for (int i = 0; i < count; i++)
+        replacement[i] = i;
+    return replacement;
+}
+
+// --------------------------------------------------------------------------
+// Global value numbering
+// --------------------------------------------------------------------------
+//
+// Walks the dominator tree with a scoped table of the expressions available
+// at each point: an instruction computing one that a dominating instruction
+// already computed is replaced by it. Constants fold, algebraic identities
+// simplify, and a phi whose operands are all one value becomes that value.
+// Constants are not scoped; they all move to the entry block, one per value.
+
+typedef struct {
+    int value;
+    int next;                // Earlier entry in the same bucket
+    unsigned bucket;
+} GvnEntry;
+
+typedef struct {
+    IrProgram* program;
+    int* replacement;
+    int replacement_capacity;
+    int* buckets;            // Latest entry + 1, 0 if none
+    unsigned mask;
+    GvnEntry* entries;       // A stack: popped when leaving a dominator subtree
+    int entry_count;
+    int entry_capacity;
+    int* constants;          // Open-addressed by value: instruction + 1
+    unsigned constant_mask;
+    int constant_count;
+} Gvn;
+
+static int find(Gvn* gvn, int value) {
+    while (gvn->replacement[value] != value)
+        value = gvn->replacement[value];
+    return value;
+}
+
+static void replace(Gvn* gvn, int instr, int value) {
+    gvn->replacement[instr] = value;
+    ir_remove(gvn->program, instr);
+}
+
+static void track_new_instrs(Gvn* gvn) {
+    int count = gvn->program->instr_count;
+    if (count <= gvn->replacement_capacity)
+        return;
+    int capacity = gvn->replacement_capacity * 2 > count ? gvn->replacement_capacity * 2 : count;
+    gvn->replacement = grow(gvn->replacement, capacity, sizeof(int));
+    for (int i = gvn->replacement_capacity; i < capacity; i++)
+        gvn->replacement[i] = i;
+    gvn->replacement_capacity = capacity;
+}
+
+static unsigned mix(unsigned hash, unsigned value) {
+    return (hash ^ value) * 16777619u;
+}
+
+// The one constant instruction for value, created (outside any block) if needed.
+static int constant(Gvn* gvn, int value, int existing) {
+    unsigned mask = gvn->constant_mask;
+    unsigned i = mix(2166136261u, (unsigned)value) & mask;
+    while (gvn->constants[i]) {
+        int instr = gvn->constants[i] - 1;
+        if (gvn->program->instrs[instr].imm == value)
+            return instr;
+        i = (i + 1) & mask;
+    }
+    if (existing < 0) {
+        existing = ir_add_instr(gvn->program, IR_CONST, -1, -1, 0);
+        gvn->program->instrs[existing].imm = value;
+        track_new_instrs(gvn);
+    }
+    gvn->constants[i] = existing + 1;
+    if (2 * ++gvn->constant_count > (int)mask + 1) {
+        int* old = gvn->constants;
+        unsigned old_size = mask + 1;
+        gvn->constant_mask = 2 * old_size - 1;
+        gvn->constants = table(2 * old_size, sizeof(int));
+        for (unsigned k = 0; k < old_size; k++) {
+            if (!old[k])
+                continue;
+            unsigned j = mix(2166136261u, (unsigned)gvn->program->instrs[old[k] - 1].imm) & gvn->constant_mask;
+            while (gvn->constants[j])
+                j = (j + 1) & gvn->constant_mask;
+            gvn->constants[j] = old[k];
+        }
+        mem_free(old);
+    }
+    return existing;
+}
+
+static int operand_total(const IrProgram* program, const IrInstr* instr) {
+    return instr->op == IR_PHI ? program->blocks[instr->block].pred_count : 2;
+}
+
+static int operand(const IrInstr* instr, int k) {
+    return instr->op == IR_PHI ? instr->phi_args[k] : instr->args[k];
+}
+
+static unsigned expression_hash(Gvn* gvn, const IrInstr* instr) {
+    unsigned hash = mix(2166136261u, instr->op);
+    if (instr->op == IR_PHI)
+        hash = mix(hash, (unsigned)instr->block);
+    for (int k = 0; k < operand_total(gvn->program, instr); k++)
+        hash = mix(hash, (unsigned)operand(instr, k) + 1);
+    return hash;
+}
+
+static int same_expression(Gvn* gvn, const IrInstr* a, const IrInstr* b) {
+    if (a->op != b->op || (a->op == IR_PHI && a->block != b->block))
+        return 0;
+    for (int k = 0; k < operand_total(gvn->program, a); k++) {
+        int arg = operand(a, k);
+        if ((arg >= 0 ? find(gvn, arg) : arg) != operand(b, k))
+            return 0;
+    }
+    return 1;
+}
+
+// An earlier instruction computing the same as instr, or -1 after recording instr.
+static int available(Gvn* gvn, int instr) {
+    const IrInstr* expression = &gvn->program->instrs[instr];
+    unsigned bucket = expression_hash(gvn, expression) & gvn->mask;
+    for (int e = gvn->buckets[bucket] - 1; e >= 0; e = gvn->entries[e].next) {
+        int candidate = gvn->entries[e].value;
+        if (same_expression(gvn, &gvn->program->instrs[candidate], expression))
+            return candidate;
+    }
+    if (gvn->entry_count == gvn->entry_capacity) {
+        gvn->entry_capacity = gvn->entry_capacity ? gvn->entry_capacity * 2 : 256;
+        gvn->entries = grow(gvn->entries, gvn->entry_capacity, sizeof(GvnEntry));
+    }
+    GvnEntry* entry = &gvn->entries[gvn->entry_count];
+    entry->value = instr;
+    entry->bucket = bucket;
+    entry->next = gvn->buckets[bucket] - 1;
+    gvn->buckets[bucket] = ++gvn->entry_count;
+    return -1;
+}
+
+static void pop_entries(Gvn* gvn, int mark) {
+    while (gvn->entry_count > mark) {
+        GvnEntry* entry = &gvn->entries[--gvn->entry_count];
+        gvn->buckets[entry->bucket] = entry->next + 1;
+    }
+}
+
+// What instr simplifies to without a table lookup, or -1.
+static int simplify(Gvn* gvn, int instr) {
+    IrInstr* expression = &gvn->program->instrs[instr];
+    int a = expression->args[0], b = expression->args[1];
+    int ca = 0, cb = 0, result;
+    int a_constant = a >= 0 && is_constant(gvn->program, a, &ca);
+    int b_constant = b >= 0 && is_constant(gvn->program, b, &cb);
+    IrOp op = expression->op;
+
+    if (op == IR_FACTORIAL)
+        return a_constant && ir_evaluate(op, ca, 0, &result) ? constant(gvn, result, -1) : -1;
+    if (a_constant && b_constant)
+        return ir_evaluate(op, ca, cb, &result) ? constant(gvn, result, -1) : -1;
+    switch (op) {
+        case IR_ADD:
+            if (a_constant && ca == 0)
+                return b;
+            if (b_constant && cb == 0)
+                return a;
+            break;
+        case IR_SUB:
+            if (b_constant && cb == 0)
+                return a;
+            if (a == b)
+                return constant(gvn, 0, -1);
+            break;
+        case IR_MUL:
+            if ((a_constant && ca == 0) || (b_constant && cb == 0))
+                return constant(gvn, 0, -1);
+            if (a_constant && ca == 1)
+                return b;
+            if (b_constant && cb == 1)
+                return a;
+            break;
+        case IR_DIV:
+            if (b_constant && cb == 1)
+                return a;
+            break;
+        case IR_SHL:
+            if (b_constant && cb == 0)
+                return a;
+            break;
+        case IR_EQ:
+            if (a == b)
+                return constant(gvn, 1, -1);
+            break;
+        case IR_NE: case IR_LT: case IR_GT:
+            if (a == b)
+                return constant(gvn, 0, -1);
+            break;
+        default:
+            break;
+    }
+    // Commutative operands in a fixed order, so both spellings hash alike
+    if ((op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE) && a > b) {
+        expression->args[0] = b;
+        expression->args[1] = a;
+    }
+    return -1;
+}
+
+// The single value a phi's operands agree on, ignoring the phi itself, or -1.
+static int trivial_phi(Gvn* gvn, int phi) {
+    IrInstr* instr = &gvn->program->instrs[phi];
+    int same = -1;
+    for (int k = 0; k < gvn->program->blocks[instr->block].pred_count; k++) {
+        int arg = find(gvn, instr->phi_args[k]);
+        instr->phi_args[k] = arg;
+        if (arg == phi || arg == same)
+            continue;
+        if (same >= 0)
+            return -1;
+        same = arg;
+    }
+    return same;
+}
+
+static void number_block(Gvn* gvn, int b) {
+    IrProgram* program = gvn->program;
+    for (int i = 0; i < program->blocks[b].length; i++) {
+        int id = program->blocks[b].code[i];
+        IrInstr* instr = &program->instrs[id];
+        for (int k = 0; k < 2; k++)
+            if (instr->args[k] >= 0)
+                instr->args[k] = find(gvn, instr->args[k]);
+        int value = -1;
+        switch (instr->op) {
+            case IR_NOP: case IR_READ: case IR_PRINT: case IR_JUMP: case IR_BRANCH: case IR_RETURN:
+                continue;
+            case IR_CONST:
+                value = constant(gvn, instr->imm, id);
+                break;
+            case IR_PHI:
+                value = trivial_phi(gvn, id);
+                break;
+            default:
+                value = simplify(gvn, id);
+                break;
+        }
+        if (value < 0 && instr->op != IR_CONST)
+            value = available(gvn, id);
+        if (value >= 0 && value != id)
+            replace(gvn, id, value);
+    }
+}
+
+static int ascending(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+int ir_gvn(IrProgram* program) {
+    int before = ir_instruction_count(program);
+    Gvn gvn = {0};
+    gvn.program = program;
+    gvn.replacement_capacity = program->instr_count;
+    gvn.replacement = identity(program->instr_count);
+    unsigned size = 64;
+    while (size < 2u * (unsigned)program->instr_count)
+        size *= 2;
+    gvn.buckets = table(size, sizeof(int));
+    gvn.mask = size - 1;
+    gvn.constants = table(64, sizeof(int));
+    gvn.constant_mask = 63;
+
+    IrDominators dom;
+    ir_dominators(program, &dom);
+    int* stack = table(program->block_count, sizeof(int));
+    int* marks = table(program->block_count, sizeof(int));
+    int* next_child = table(program->block_count, sizeof(int));
+    int depth = 0;
+    stack[depth++] = 0;
+    marks[0] = gvn.entry_count;
+    number_block(&gvn, 0);
+    next_child[0] = dom.first_child[0];
+    while (depth) {
+        int b = stack[depth - 1];
+        int child = next_child[b];
+        if (child >= 0) {
+            next_child[b] = dom.next_sibling[child];
+            marks[child] = gvn.entry_count;
+            number_block(&gvn, child);
+            next_child[child] = dom.first_child[child];
+            stack[depth++] = child;
+        } else {
+            pop_entries(&gvn, marks[b]);
+            depth--;
+        }
+    }
+    ir_free_dominators(&dom);
+
+    // Back-edge operands were numbered after their phis were seen
+    apply_replacements(program, gvn.replacement, gvn.replacement_capacity);
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < program->instr_count; i++) {
+            int value;
+            if (program->instrs[i].op == IR_PHI && (value = trivial_phi(&gvn, i)) >= 0) {
+                replace(&gvn, i, value);
+                changed = 1;
+            }
+        }
+    }
+    apply_replacements(program, gvn.replacement, gvn.replacement_capacity);
+
+    // Every constant at the head of the entry block
+    for (int i = 0; i < program->instr_count; i++)
+        if (program->instrs[i].op == IR_CONST)
+            program->instrs[i].block = -1;
+    ir_compact(program);
+    int placed = 0;
+    for (unsigned k = 0; k <= gvn.constant_mask; k++)
+        if (gvn.constants[k] && program->instrs[gvn.constants[k] - 1].op == IR_CONST)
+            gvn.constants[placed++] = gvn.constants[k] - 1;
+    qsort(gvn.constants, placed, sizeof(int), ascending);
+    for (int k = 0; k < placed; k++)
+        ir_insert(program, 0, k, gvn.constants[k]);
+
+    mem_free(stack);
+    mem_free(marks);
+    mem_free(next_child);
+    mem_free(gvn.replacement);
+    mem_free(gvn.buckets);
+    mem_free(gvn.entries);
+    mem_free(gvn.constants);
+    return before - ir_instruction_count(program);
+}
+
+// --------------------------------------------------------------------------
+// Loops
+// --------------------------------------------------------------------------
+//
+// Natural loops of back edges (an edge to a block dominating its source).
+// Lowering gives each loop one back edge and a preheader: a block outside
+// the loop whose only successor is the header.
+
+typedef struct {
+    int header;
+    int latch;
+    int preheader;           // -1 if there is none
+    int* blocks;
+    int block_count;
+} Loop;
+
+static int by_size(const void* a, const void* b) {
+    return ((const Loop*)a)->block_count - ((const Loop*)b)->block_count;
+}
+
+// Loops smallest first, so an inner loop comes before the loops around it.
+static int find_loops(const IrProgram* program, const IrDominators* dom, Loop** found) {
+    Loop* loops = NULL;
+    int count = 0;
+    char* member = table(program->block_count, 1);
+    int* work = table(program->block_count, sizeof(int));
+    for (int i = 0; i < dom->count; i++) {
+        int latch = dom->order[i];
+        for (int s = 0; s < 2; s++) {
+            int header = program->blocks[latch].succs[s];
+            if (header < 0 || !ir_dominates(dom, header, latch))
+                continue;
+            loops = grow(loops, count + 1, sizeof(Loop));
+            Loop* loop = &loops[count++];
+            loop->header = header;
+            loop->latch = latch;
+            loop->blocks = table(program->block_count, sizeof(int));
+            loop->block_count = 0;
+            memset(member, 0, program->block_count);
+            member[header] = 1;
+            loop->blocks[loop->block_count++] = header;
+            int pending = 0;
+            if (!member[latch]) {
+                member[latch] = 1;
+                loop->blocks[loop->block_count++] = latch;
+                work[pending++] = latch;
+            }
+            while (pending) {
+                const IrBlock* block = &program->blocks[work[--pending]];
+                for (int p = 0; p < block->pred_count; p++)
+                    if (!member[block->preds[p]] && dom->rank[block->preds[p]] >= 0) {
+                        member[block->preds[p]] = 1;
+                        loop->blocks[loop->block_count++] = block->preds[p];
+                        work[pending++] = block->preds[p];
+                    }
+            }
+            loop->preheader = -1;
+            const IrBlock* head = &program->blocks[header];
+            for (int p = 0; p < head->pred_count; p++) {
+                int pred = head->preds[p];
+                if (member[pred])
+                    continue;
+                const IrBlock* outside = &program->blocks[pred];
+                int only = loop->preheader < 0 && outside->succs[1] < 0;
+                loop->preheader = only ? pred : -2;
+            }
+            if (loop->preheader < 0 || head->pred_count != 2)
+                loop->preheader = -1;
+        }
+    }
+    mem_free(member);
+    mem_free(work);
+    if (count)
+        qsort(loops, count, sizeof(Loop), by_size);
+    *found = loops;
+    return count;
+}
+
+static void free_loops(Loop* loops, int count) {
+    for (int i = 0; i < count; i++)
+        mem_free(loops[i].blocks);
+    mem_free(loops);
+}
+
+// --------------------------------------------------------------------------
+// Loop-invariant code motion
+// --------------------------------------------------------------------------
+//
+// Inner loops first, so code leaving an inner loop can go on leaving the
+// outer one. An instruction is invariant once every operand is defined
+// outside the loop; only speculatable ones move, since a while body may not
+// run at all.
+
+int ir_licm(IrProgram* program) {
+    IrDominators dom;
+    ir_dominators(program, &dom);
+    Loop* loops;
+    int loop_count = find_loops(program, &dom, &loops);
+    ir_free_dominators(&dom);
+
+    int* member = table(program->block_count, sizeof(int));
+    int hoisted = 0;
+    for (int l = 0; l < loop_count; l++) {
+        const Loop* loop = &loops[l];
+        if (loop->preheader < 0)
+            continue;
+        for (int i = 0; i < loop->block_count; i++)
+            member[loop->blocks[i]] = l + 1;
+        int moved = 1;
+        while (moved) {
+            moved = 0;
+            for (int i = 0; i < loop->block_count; i++) {
+                IrBlock* block = &program->blocks[loop->blocks[i]];
+                for (int c = 0; c < block->length; c++) {
+                    int id = block->code[c];
+                    IrInstr* instr = &program->instrs[id];
+                    if (instr->block != loop->blocks[i] || !is_speculatable(program, instr))
+                        continue;
+                    int invariant = 1;
+                    for (int k = 0; k < 2; k++)
+                        if (instr->args[k] >= 0 && member[program->instrs[instr->args[k]].block] == l + 1)
+                            invariant = 0;
+                    if (!invariant)
+                        continue;
+                    // Left in this block's code until compaction, which sees it moved
+                    IrBlock* preheader = &program->blocks[loop->preheader];
+                    ir_insert(program, loop->preheader, preheader->length - 1, id);
+                    block = &program->blocks[loop->blocks[i]];
+                    hoisted++;
+                    moved = 1;
+                }
+            }
+        }
+    }
+    ir_compact(program);
+    mem_free(member);
+    free_loops(loops, loop_count);
+    return hoisted;
+}
+
+// --------------------------------------------------------------------------
+// Strength reduction
+// --------------------------------------------------------------------------
+//
+// A multiply of a basic induction variable (a header phi stepped by a
+// constant each iteration) by a loop-invariant factor becomes a second
+// induction variable, started at initial * factor in the preheader and
+// stepped by step * factor: one add per iteration instead of a multiply.
+// Any other multiply by a power of two becomes a shift.
+
+typedef struct {
+    int base;                // Induction variable phi
+    int factor;
+    int reduced;             // Its replacement phi
+} Reduction;
+
+// The step of a basic induction variable, if phi is one.
+static int induction_step(const IrProgram* program, const Loop* loop, int phi, int* step, int* next) {
+    const IrInstr* instr = &program->instrs[phi];
+    int latch_index = ir_pred_index(program, loop->header, loop->latch);
+    *next = instr->phi_args[latch_index];
+    const IrInstr* update = &program->instrs[*next];
+    int c;
+    if (update->op == IR_ADD && update->args[0] == phi && is_constant(program, update->args[1], &c))
+        *step = c;
+    else if (update->op == IR_ADD && update->args[1] == phi && is_constant(program, update->args[0], &c))
+        *step = c;
+    else if (update->op == IR_SUB && update->args[0] == phi && is_constant(program, update->args[1], &c))
+        *step = (int)(0u - (unsigned)c);
+    else
+        return 0;
+    return 1;
+}
+
+// a * b, folded if both are constants, else computed in the preheader.
+static int preheader_product(IrProgram* program, const Loop* loop, int a, int b, int line) {
+    int ca, cb;
+    int a_constant = is_constant(program, a, &ca), b_constant = is_constant(program, b, &cb);
+    if (a_constant && b_constant)
+        return ir_constant(program, (int)((unsigned)ca * (unsigned)cb));
+    if ((a_constant && ca == 0) || (b_constant && cb == 0))
+        return ir_constant(program, 0);
+    if (a_constant && ca == 1)
+        return b;
+    if (b_constant && cb == 1)
+        return a;
+    int product = ir_add_instr(program, IR_MUL, a, b, line);
+    ir_insert(program, loop->preheader, program->blocks[loop->preheader].length - 1, product);
+    return product;
+}
+
+// The induction variable equal to base * factor, created if needed, or -1.
+static int reduce_induction(IrProgram* program, const Loop* loop, int mul, int base, int factor,
+                            Reduction** reductions, int* count) {
+    int step, next;
+    if (program->instrs[base].op != IR_PHI || program->instrs[base].block != loop->header ||
+        !induction_step(program, loop, base, &step, &next))
+        return -1;
+    for (int r = 0; r < *count; r++)
+        if ((*reductions)[r].base == base && (*reductions)[r].factor == factor)
+            return (*reductions)[r].reduced;
+
+    int pre_index = ir_pred_index(program, loop->header, loop->preheader);
+    int latch_index = 1 - pre_index;
+    int line = program->instrs[mul].line;
+    int initial = program->instrs[base].phi_args[pre_index];
+    int start = preheader_product(program, loop, initial, factor, line);
+    int increment = preheader_product(program, loop, ir_constant(program, step), factor, line);
+
+    int reduced = ir_add_instr(program, IR_PHI, -1, -1, line);
+    program->instrs[reduced].phi_args = table(2, sizeof(int));
+    program->instrs[reduced].phi_args[pre_index] = start;
+    ir_insert(program, loop->header, 0, reduced);
+    int stepped = ir_add_instr(program, IR_ADD, reduced, increment, line);
+    program->instrs[reduced].phi_args[latch_index] = stepped;
+    int update_block = program->instrs[next].block;
+    int position = 0;
+    while (program->blocks[update_block].code[position] != next)
+        position++;
+    ir_insert(program, update_block, position + 1, stepped);
+
+    *reductions = grow(*reductions, *count + 1, sizeof(Reduction));
+    (*reductions)[(*count)++] = (Reduction){base, factor, reduced};
+    return reduced;
+}
+
+int ir_strength_reduce(IrProgram* program) {
+    IrDominators dom;
+    ir_dominators(program, &dom);
+    Loop* loops;
+    int loop_count = find_loops(program, &dom, &loops);
+    ir_free_dominators(&dom);
+
+    int original_count = program->instr_count;
+    int* replacement = identity(original_count);
+    int* innermost = table(program->block_count, sizeof(int));
+    int* member = table(program->block_count, sizeof(int));
+    for (int l = loop_count - 1; l >= 0; l--)
+        for (int i = 0; i < loops[l].block_count; i++)
+            innermost[loops[l].blocks[i]] = l + 1;
+
+    // Induction variables, each loop's own multiplies at a time
+    int reduced = 0;
+    Reduction* reductions = NULL;
+    int reduction_count = 0;
+    int* code = NULL;
+    for (int l = 0; l < loop_count; l++) {
+        const Loop* loop = &loops[l];
+        if (loop->preheader < 0)
+            continue;
+        for (int i = 0; i < loop->block_count; i++)
+            member[loop->blocks[i]] = l + 1;
+        for (int i = 0; i < loop->block_count; i++) {
+            int b = loop->blocks[i];
+            if (innermost[b] != l + 1)
+                continue;
+            // Reducing inserts into the loop's blocks, so walk a copy
+            int length = program->blocks[b].length;
+            code = grow(code, length, sizeof(int));
+            memcpy(code, program->blocks[b].code, length * sizeof(int));
+            for (int c = 0; c < length; c++) {
+                int id = code[c];
+                if (program->instrs[id].op != IR_MUL)
+                    continue;
+                for (int side = 0; side < 2; side++) {
+                    int factor = program->instrs[id].args[side];
+                    int base = program->instrs[id].args[1 - side];
+                    if (member[program->instrs[factor].block] == l + 1)
+                        continue;
+                    int value = reduce_induction(program, loop, id, base, factor, &reductions, &reduction_count);
+                    if (value >= 0) {
+                        replacement[id] = value;
+                        ir_remove(program, id);
+                        reduced++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Shifts for what is left
+    for (int id = 0; id < program->instr_count; id++) {
+        IrInstr* instr = &program->instrs[id];
+        int c;
+        for (int side = 0; side < 2 && instr->op == IR_MUL; side++) {
+            if (!is_constant(program, instr->args[side], &c) || c < 2 || (c & (c - 1)))
+                continue;
+            int shift = 0;
+            while ((1 << shift) != c)
+                shift++;
+            int value = instr->args[1 - side];
+            int amount = ir_constant(program, shift);
+            instr = &program->instrs[id];
+            instr->op = IR_SHL;
+            instr->args[0] = value;
+            instr->args[1] = amount;
+            reduced++;
+        }
+    }
+    apply_replacements(program, replacement, original_count);
+    ir_compact(program);
+    mem_free(replacement);
+    mem_free(innermost);
+    mem_free(member);
+    mem_free(code);
+    mem_free(reductions);
+    free_loops(loops, loop_count);
+    return reduced;
+}
+
+// --------------------------------------------------------------------------
+// Dead code elimination
+// --------------------------------------------------------------------------
+//
+// Live: input, output, control flow, divisions that might trap, and everything
+// these use. The rest goes, which includes every store to a variable whose
+// value is never read again and loop-carried values nothing outside the
+// loop needs.
+
+int ir_dce(IrProgram* program) {
+    char* live = table(program->instr_count, 1);
+    int* work = table(program->instr_count, sizeof(int));
+    int pending = 0;
+    for (int i = 0; i < program->instr_count; i++) {
+        IrInstr* instr = &program->instrs[i];
+        IrOp op = instr->op;
+        if (op == IR_READ || op == IR_PRINT || op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN ||
+            (op == IR_DIV && !is_speculatable(program, instr))) {
+            live[i] = 1;
+            work[pending++] = i;
+        }
+    }
+    while (pending) {
+        const IrInstr* instr = &program->instrs[work[--pending]];
+        int count = instr->op == IR_PHI ? program->blocks[instr->block].pred_count : 2;
+        for (int k = 0; k < count; k++) {
+            int arg = instr->op == IR_PHI ? instr->phi_args[k] : instr->args[k];
+            if (arg >= 0 && !live[arg]) {
+                live[arg] = 1;
+                work[pending++] = arg;
+            }
+        }
+    }
+    int removed = 0;
+    for (int i = 0; i < program->instr_count; i++)
+        if (program->instrs[i].op != IR_NOP && !live[i]) {
+            ir_remove(program, i);
+            removed++;
+        }
+    ir_compact(program);
+    mem_free(live);
+    mem_free(work);
+    return removed;
+}
@@ -1,37 +1,135 @@
 /* lexer.c */
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include <string.h>
+#include <limits.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "../../include/tokens.h"
 #include "../../include/lexer.h"
+#include "../../include/lexer_dfa.h"
+#include "../../include/alloc.h"
+#include "../../include/trace.h"
+#include "../../include/intern.h"
+
+#define MAX_TOKEN_LENGTH 99
 
-static int current_line = 1;
-static int current_column =1;
 static char last_token_type = 'x';
 
-// Keywords table
-static struct {
-    const char* word;
-    TokenType type;
-} keywords[] = {
-    {"if", TOKEN_IF},
-    {"else", TOKEN_ELSE},     
-    {"int", TOKEN_INT},
-    {"print", TOKEN_PRINT},
-    {"while", TOKEN_WHILE},    
-    {"repeat", TOKEN_REPEAT},  
-    {"until", TOKEN_UNTIL}    
-};
+// Line-start index: sorted byte offsets of the first character of every line.
+// Built lazily from the source last handed to get_next_token, the first time a
+// diagnostic needs a line or column.
+static const char* indexed_source = NULL;
+static const char* current_source = NULL;
+static int* line_starts = NULL;
+static int line_count = 0;
+static int line_capacity = 0;
+
+static void add_line_start(int offset) {
+    if (line_count == line_capacity) {
+        int new_capacity = line_capacity ? line_capacity * 2 : 256;
+        int* grown = mem_realloc(MEM_LEXER, line_starts, new_capacity * sizeof(int));
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        line_starts = grown;
+        line_capacity = new_capacity;
+    }
+    line_starts[line_count++] = offset;
+}
+
+static void build_line_index(const char* input) {
+    TRACE_BEGIN("build_line_index");
+    size_t length = strlen(input);
+    size_t i = 0;
 
-static int is_keyword(const char* word) {
-    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
-        if (strcmp(word, keywords[i].word) == 0) {
-            return keywords[i].type;
+    line_count = 0;
+    add_line_start(0);
+#if defined(__SSE2__)
+    // Compare 16 bytes at a time against '\n' and walk the match mask.
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(input + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while (mask) {
+            add_line_start((int)(i + __builtin_ctz(mask) + 1));
+            mask &= mask - 1;
         }
     }
-    return 0;
+#endif
+    while (i < length) {
+        const char* nl = memchr(input + i, '\n', length - i);
+        if (!nl)
+            break;
+        i = (size_t)(nl - input) + 1;
+        add_line_start((int)i);
+    }
+    indexed_source = input;
+    TRACE_END();
+}
+
+static int find_line_index(int offset) {
+    if (current_source != indexed_source)
+        build_line_index(current_source);
+    int lo = 0;
+    int hi = line_count - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+        if (line_starts[mid] <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+int offset_to_line(int offset) {
+    if (!current_source)
+        return 1;
+    return find_line_index(offset) + 1;
+}
+
+int offset_to_column(int offset) {
+    if (!current_source)
+        return 1;
+    return offset - line_starts[find_line_index(offset)] + 1;
+}
+
+int line_to_offset(int line, int column) {
+    if (!current_source)
+        return 0;
+    if (current_source != indexed_source)
+        build_line_index(current_source);
+    if (line < 1)
+        return 0;
+    if (line > line_count)
+        return (int)strlen(current_source);
+    return line_starts[line - 1] + (column > 1 ? column - 1 : 0);
+}
+
+int token_line(Token token) {
+    return offset_to_line(token.offset);
+}
+
+int token_column(Token token) {
+    return offset_to_column(token.offset);
+}
+
+void lexer_set_source(const char* input) {
+    current_source = input;
+    indexed_source = NULL;
+    last_token_type = 'x';
+}
+
+void free_line_index(void) {
+    mem_free(line_starts);
+    line_starts = NULL;
+    line_count = 0;
+    line_capacity = 0;
+    indexed_source = NULL;
 }
 
 void print_error(ErrorType error, int line, const char* lexeme) {
@@ -52,14 +150,85 @@ void print_error(ErrorType error, int line, const char* lexeme) {
         case ERROR_UNEXPECTED_TOKEN:
             printf("Unexpected token '%s'\n", lexeme);
             break;
+        case ERROR_NUMBER_OVERFLOW:
+            printf("Number '%s' does not fit in a signed 64-bit integer\n", lexeme);
+            break;
         default:
             printf("Unknown error\n");
     }
 }
 
+// --------------------------------------------------------------------------
+// Token spelling
+// --------------------------------------------------------------------------
+
+static const char* const operator_spelling[OP_COUNT] = {
+    "", "==", "!=", "<", ">", "+", "-", "*", "/"
+};
+
+const char* operator_text(OperatorId op) {
+    return op < OP_COUNT ? operator_spelling[op] : "";
+}
+
+const char* token_name(const Token* token) {
+    return intern_string((int)token->value);
+}
+
+const char* token_text(const Token* token, char* buf, size_t size) {
+    const char* fixed = NULL;
+    switch (token->type) {
+        case TOKEN_EOF:        fixed = "EOF"; break;
+        case TOKEN_OPERATOR:   fixed = operator_text(token->op); break;
+        case TOKEN_IDENTIFIER: fixed = token_name(token); break;
+        case TOKEN_EQUALS:     fixed = "="; break;
+        case TOKEN_SEMICOLON:  fixed = ";"; break;
+        case TOKEN_LPAREN:     fixed = "("; break;
+        case TOKEN_RPAREN:     fixed = ")"; break;
+        case TOKEN_LBRACE:     fixed = "{"; break;
+        case TOKEN_RBRACE:     fixed = "}"; break;
+        case TOKEN_IF:         fixed = "if"; break;
+        case TOKEN_ELSE:       fixed = "else"; break;
+        case TOKEN_INT:        fixed = "int"; break;
+        case TOKEN_PRINT:      fixed = "print"; break;
+        case TOKEN_WHILE:      fixed = "while"; break;
+        case TOKEN_REPEAT:     fixed = "repeat"; break;
+        case TOKEN_UNTIL:      fixed = "until"; break;
+        case TOKEN_READ:       fixed = "read"; break;
+        case TOKEN_ERROR:
+            if (token->op != OP_NONE)
+                fixed = operator_text(token->op);
+            else if (token->error == ERROR_INVALID_CHAR) {
+                snprintf(buf, size, "%c", (char)token->value);
+                return buf;
+            } else if (token->error == ERROR_NUMBER_OVERFLOW && current_source) {
+                // No value was kept, so only the source still has the digits
+                snprintf(buf, size, "%.*s", (int)token->length, current_source + token->offset);
+                return buf;
+            } else
+                fixed = "";
+            break;
+        case TOKEN_NUMBER: {
+            // Leading zeros are all the value loses
+            char digits[24];
+            int count = snprintf(digits, sizeof(digits), "%lld", token->value);
+            size_t at = 0;
+            for (int i = count; i < token->length && at + 1 < size; i++)
+                buf[at++] = '0';
+            snprintf(buf + at, size - at, "%s", digits);
+            return buf;
+        }
+        default:
+            fixed = "";
+    }
+    snprintf(buf, size, "%s", fixed);
+    return buf;
+}
+
 void print_token(Token token) {
+    char text[TOKEN_TEXT_SIZE];
+    token_text(&token, text, sizeof(text));
     if (token.error != ERROR_NONE) {
-        print_error(token.error, token.line, token.lexeme);
+        print_error((ErrorType)token.error, token_line(token), text);
         return;
     }
 
@@ -80,135 +249,159 @@ void print_token(Token token) {
         case TOKEN_EOF:        printf("EOF"); break;
         default:              printf("UNKNOWN");
     }
-    printf(" | Lexeme: '%s' | Line: %d\n", token.lexeme, token.line);
+    printf(" | Lexeme: '%s' | Line: %d\n", text, token_line(token));
 }
 
-Token get_next_token(const char* input, int* pos) {
-    Token token = {TOKEN_ERROR, "", current_line, ERROR_NONE};
-    char c;
-
-    // Skip whitespace and track line numbers
-    while ((c = input[*pos]) != '\0' && (c == ' ' || c == '\n' || c == '\t')) {
-        if (c == '\n') {
-            current_line++;
-            current_column = 1;
-        } else {
-            current_column++;
+// Runs the DFA generated from lexer.rules (see tools/lexgen.c) over text and
+// returns the length of the longest accepted prefix, at most limit bytes, with
+// its final state in *accept (DFA_DEAD when nothing matches). The hot loop is
+// two table loads per byte; only a run that dies in a non-accepting state
+// (such as "!" not followed by "=") is rescanned to find the last accept.
+static int dfa_match(const unsigned char* text, int limit, int* accept) {
+    int state = DFA_START;
+    int last = DFA_DEAD;
+    int n = 0;
+    while (n < limit) {
+        state = dfa_next[(state << DFA_ROW_SHIFT) + dfa_class[text[n]]];
+        if (state == DFA_DEAD)
+            break;
+        last = state;
+        n++;
+    }
+    if (dfa_token[last] != DFA_REJECT || last == DFA_DEAD) {
+        *accept = last;
+        return n;
+    }
+    int length = 0;
+    *accept = DFA_DEAD;
+    state = DFA_START;
+    for (int i = 0; i < n; i++) {
+        state = dfa_next[(state << DFA_ROW_SHIFT) + dfa_class[text[i]]];
+        if (dfa_token[state] != DFA_REJECT) {
+            *accept = state;
+            length = i + 1;
         }
-        (*pos)++;
     }
+    return length;
+}
 
-    if (input[*pos] == '\0') {
-        token.type = TOKEN_EOF;
-        strcpy(token.lexeme, "EOF");
-        return token;
+// Decodes a [0-9]+ match. Returns 0, leaving the value unset, if it is
+// above the largest long long.
+static int decode_number(Token* token, const unsigned char* text, int length) {
+    long long value = 0;
+    for (int i = 0; i < length; i++) {
+        int digit = text[i] - '0';
+        if (value > (LLONG_MAX - digit) / 10)
+            return 0;
+        value = value * 10 + digit;
+    }
+    token->value = value;
+    return 1;
+}
+
+static OperatorId decode_operator(const unsigned char* text) {
+    switch (text[0]) {
+        case '=': return OP_EQ;
+        case '!': return OP_NE;
+        case '<': return OP_LT;
+        case '>': return OP_GT;
+        case '+': return OP_ADD;
+        case '-': return OP_SUB;
+        case '*': return OP_MUL;
+        case '/': return OP_DIV;
+        default:  return OP_NONE;
     }
+}
+
+int token_decode(Token* token, const char* text) {
+    size_t length = strlen(text);
+    token->op = OP_NONE;
+    token->value = 0;
+    token->length = length < MAX_TOKEN_LENGTH ? (unsigned char)length : MAX_TOKEN_LENGTH;
+    if (token->type == TOKEN_OPERATOR) {
+        token->op = (unsigned char)decode_operator((const unsigned char*)text);
+    } else if (token->type == TOKEN_NUMBER) {
+        if (!decode_number(token, (const unsigned char*)text, token->length))
+            return 0;
+    } else if (token->type == TOKEN_IDENTIFIER) {
+        int id = intern_name_length(text, token->length);
+        if (id < 0)
+            return 0;
+        token->value = id;
+    }
+    return 1;
+}
 
-    c = input[*pos];
+// The longest match wins, capped at MAX_TOKEN_LENGTH bytes, so over-long
+// numbers and names split into several tokens.
+Token get_next_token(const char* input, int* pos) {
+    Token token = {TOKEN_ERROR, OP_NONE, ERROR_NONE, 0, 0, 0};
+    const unsigned char* text;
+    int length;
+    int state;
 
-    // Handle numbers
-    if (isdigit(c)) {
-        int i = 0;
-        int token_column = current_column;
-        do {
-            token.lexeme[i++] = c;
-            (*pos)++;
-            current_column++;
-            c = input[*pos];
-        } while (isdigit(c) && i < sizeof(token.lexeme) - 1);
+    if (input != current_source) {
+        current_source = input;
+        indexed_source = NULL;
+    }
 
-        token.lexeme[i] = '\0';
-        token.type = TOKEN_NUMBER;
-        token.column = token_column;
-        return token;
+    // Whitespace is matched like any token and dropped; line numbers are
+    // recovered from the offset on demand.
+    for (;;) {
+        text = (const unsigned char*)input + *pos;
+        length = dfa_match(text, MAX_TOKEN_LENGTH, &state);
+        if (dfa_token[state] != DFA_SKIP)
+            break;
+        *pos += length;
     }
 
-    // Handle identifiers and keywords
-    if (isalpha(c) || c == '_') {
-        int i = 0;
-        int token_column = current_column;
-        do {
-            token.lexeme[i++] = c;
-            (*pos)++;
-            current_column++;
-            c = input[*pos];
-        } while ((isalnum(c) || c == '_') && i < sizeof(token.lexeme) - 1);
-
-        token.lexeme[i] = '\0';
-        //printf("DEBUG (lexer): Found identifier '%s' at line %d\n", token.lexeme, token.line);
-        // Check if it's a keyword
-        TokenType keyword_type = is_keyword(token.lexeme);
-        if (keyword_type) {
-            token.type = keyword_type;
-        } else {
-            token.type = TOKEN_IDENTIFIER;
+    token.offset = *pos;
+
+    if (state == DFA_DEAD) {
+        if (text[0] == '\0') {
+            token.type = TOKEN_EOF;
+            return token;
         }
-        last_token_type = token_column;
+        // No rule matches: a one-character invalid token
+        (*pos)++;
+        token.length = 1;
+        token.value = text[0];
+        token.error = ERROR_INVALID_CHAR;
         return token;
     }
 
-    // Handle operators and delimiters
-    int token_column = current_column;
-    (*pos)++;
-    token.lexeme[0] = c;
-    token.lexeme[1] = '\0';
-    token.column = token_column;
-
-    switch(c) {
-        case '+': case '-': case '*': case '/':
-            if (last_token_type == 'o') {
-                token.error = ERROR_CONSECUTIVE_OPERATORS;
-                return token;
-            }
-            token.type = TOKEN_OPERATOR;
-            last_token_type = 'o';
-            break;
-         case '>':
-            token.type = TOKEN_OPERATOR;
-            break;
-        case '<':
-            token.type = TOKEN_OPERATOR;
-            break;
-        case '=':
-            if (input[*pos] == '=') {
-                (*pos)++;
-                current_column++;
-                strcpy(token.lexeme, "==");
-                token.type = TOKEN_OPERATOR;
-            } else {
-                token.type = TOKEN_EQUALS;
-            }
-            break;
-        case '!':
-            if (input[*pos] == '=') {
-                (*pos)++;
-                current_column++;
-                strcpy(token.lexeme, "!=");
-                token.type = TOKEN_OPERATOR;
-            } else {
-                token.error = ERROR_INVALID_CHAR;
-            }
-            break;
-        case ';':
-            token.type = TOKEN_SEMICOLON;
-            break;
-        case '(':
-            token.type = TOKEN_LPAREN;
-            break;
-        case ')':
-            token.type = TOKEN_RPAREN;
-            break;
-        case '{':
-            token.type = TOKEN_LBRACE;
-            break;
-        case '}':
-            token.type = TOKEN_RBRACE;
-            break;
-        default:
-            token.error = ERROR_INVALID_CHAR;
-            break;
+    *pos += length;
+    token.length = (unsigned char)length;
+
+    TokenType type = (TokenType)dfa_token[state];
+    if (type == TOKEN_OPERATOR)
+        token.op = (unsigned char)decode_operator(text);
+
+    if (dfa_flags[state] & DFA_ARITH) {
+        if (last_token_type == 'o') {
+            token.error = ERROR_CONSECUTIVE_OPERATORS;
+            return token;
+        }
+        last_token_type = 'o';
+    } else if (dfa_flags[state] & DFA_IDENT) {
+        last_token_type = 'i';
     }
 
+    if (type == TOKEN_NUMBER) {
+        // Too large a literal is a bad token, like an invalid character
+        if (!decode_number(&token, text, length)) {
+            token.error = ERROR_NUMBER_OVERFLOW;
+            return token;
+        }
+    } else if (type == TOKEN_IDENTIFIER) {
+        int id = intern_name_length((const char*)text, (size_t)length);
+        if (id < 0) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        token.value = id;
+    }
+    token.type = (unsigned char)type;
     return token;
 }
 
@@ -0,0 +1,158 @@
+/* token_pipeline.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#ifndef SEMANTIC_NO_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "../../include/token_pipeline.h"
+#include "../../include/lexer.h"
+#include "../../include/alloc.h"
+#include "../../include/trace.h"
+
+#define CACHE_LINE 64
+#define SLOT_MASK (TOKEN_PIPELINE_SLOTS - 1)
+
+// Shared indices and each side's private state sit on separate cache lines,
+// so a side only touches the other's line when it publishes or refreshes.
+struct TokenPipeline {
+    _Alignas(CACHE_LINE) atomic_uint tail;   // Tokens published by the lexer
+    _Alignas(CACHE_LINE) atomic_uint head;   // Tokens released by the parser
+    _Alignas(CACHE_LINE) atomic_int stop;
+
+    // Lexer thread only
+    _Alignas(CACHE_LINE) unsigned produced;
+    unsigned published;
+    unsigned head_seen;
+    int position;
+    const char* input;
+
+    // Parser thread only
+    _Alignas(CACHE_LINE) unsigned consumed;
+    unsigned released;
+    unsigned tail_seen;
+
+    void* block;                             // Unaligned allocation
+#ifndef SEMANTIC_NO_THREADS
+    pthread_t thread;
+#endif
+    Token slots[TOKEN_PIPELINE_SLOTS];
+};
+
+#ifndef SEMANTIC_NO_THREADS
+
+// Spin briefly, then give the core away: the other side may share it.
+static void backoff(int* spins) {
+    if (++*spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+static void* lexer_thread(void* arg) {
+    TokenPipeline* pipeline = arg;
+    TRACE_BEGIN("lex_pipeline");
+    for (;;) {
+        if (pipeline->produced - pipeline->head_seen == TOKEN_PIPELINE_SLOTS) {
+            // Full: publish what is pending, then wait for the parser
+            atomic_store_explicit(&pipeline->tail, pipeline->produced, memory_order_release);
+            pipeline->published = pipeline->produced;
+            int spins = 0;
+            while ((pipeline->head_seen = atomic_load_explicit(&pipeline->head, memory_order_acquire)) +
+                   TOKEN_PIPELINE_SLOTS == pipeline->produced) {
+                if (atomic_load_explicit(&pipeline->stop, memory_order_relaxed))
+                    goto done;
+                backoff(&spins);
+            }
+        }
+        Token* token = &pipeline->slots[pipeline->produced & SLOT_MASK];
+        *token = get_next_token(pipeline->input, &pipeline->position);
+        pipeline->produced++;
+        int end = token->type == TOKEN_EOF;
+        if (end || pipeline->produced - pipeline->published == TOKEN_PIPELINE_BATCH) {
+            atomic_store_explicit(&pipeline->tail, pipeline->produced, memory_order_release);
+            pipeline->published = pipeline->produced;
+            if (end || atomic_load_explicit(&pipeline->stop, memory_order_relaxed))
+                break;
+        }
+    }
+done:
+    TRACE_END();
+    return NULL;
+}
+
+TokenPipeline* token_pipeline_start(const char* input) {
+    void* block = mem_alloc(MEM_LEXER, sizeof(TokenPipeline) + CACHE_LINE);
+    if (!block)
+        return NULL;
+    TokenPipeline* pipeline = (TokenPipeline*)(((uintptr_t)block + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+    atomic_init(&pipeline->tail, 0);
+    atomic_init(&pipeline->head, 0);
+    atomic_init(&pipeline->stop, 0);
+    pipeline->produced = pipeline->published = pipeline->head_seen = 0;
+    pipeline->consumed = pipeline->released = pipeline->tail_seen = 0;
+    pipeline->position = 0;
+    pipeline->input = input;
+    pipeline->block = block;
+    // The lexer thread must find the source already current, so it never
+    // writes the state token_line reads on the parser thread.
+    lexer_set_source(input);
+    if (pthread_create(&pipeline->thread, NULL, lexer_thread, pipeline) != 0) {
+        mem_free(block);
+        return NULL;
+    }
+    return pipeline;
+}
+
+Token token_pipeline_next(TokenPipeline* pipeline) {
+    if (pipeline->consumed == pipeline->tail_seen) {
+        // Empty: release what was read so far, then wait for the lexer
+        atomic_store_explicit(&pipeline->head, pipeline->consumed, memory_order_release);
+        pipeline->released = pipeline->consumed;
+        int spins = 0;
+        while ((pipeline->tail_seen = atomic_load_explicit(&pipeline->tail, memory_order_acquire)) ==
+               pipeline->consumed)
+            backoff(&spins);
+    }
+    Token token = pipeline->slots[pipeline->consumed & SLOT_MASK];
+    if (token.type == TOKEN_EOF)
+        return token;   // Stay on it; the lexer has finished
+    pipeline->consumed++;
+    if (pipeline->consumed - pipeline->released == TOKEN_PIPELINE_BATCH) {
+        atomic_store_explicit(&pipeline->head, pipeline->consumed, memory_order_release);
+        pipeline->released = pipeline->consumed;
+    }
+    return token;
+}
+
+void token_pipeline_stop(TokenPipeline* pipeline) {
+    if (!pipeline)
+        return;
+    atomic_store_explicit(&pipeline->stop, 1, memory_order_relaxed);
+    pthread_join(pipeline->thread, NULL);
+    mem_free(pipeline->block);
+}
+
+#else
+
+TokenPipeline* token_pipeline_start(const char* input) {
+    (void)input;
+    return NULL;
+}
+
+Token token_pipeline_next(TokenPipeline* pipeline) {
+    (void)pipeline;
+    Token token = {TOKEN_EOF, OP_NONE, ERROR_NONE, 0, 0, 0};
+    return token;
+}
+
+void token_pipeline_stop(TokenPipeline* pipeline) {
+    (void)pipeline;
+}
+
+#endif
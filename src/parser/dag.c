@@ -0,0 +1,210 @@
+/* dag.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/dag.h"
+#include "../../include/alloc.h"
+
+typedef struct {
+    ASTNode* node;
+    unsigned hash;
+    int cached;              // Last check passed and is still current
+    int* parents;            // dag_ids of the nodes using this one
+    int parent_count;
+    int parent_capacity;
+} DagEntry;
+
+static int enabled = 0;
+static DagEntry* entries = NULL;
+static int entry_count = 0;
+static int entry_capacity = 0;
+static int* buckets = NULL;          // Entry index + 1, 0 when empty
+static int bucket_capacity = 0;
+static int* walk_stack = NULL;       // Invalidation work list
+static DagStats stats = {0};
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+void dag_enable(int on) {
+    enabled = on;
+}
+
+int dag_enabled(void) {
+    return enabled;
+}
+
+// --------------------------------------------------------------------------
+// Interning
+// --------------------------------------------------------------------------
+
+// Tokens match when they spell the same: names by interned id, operators by
+// id, and numbers by value and length (so "07" stays distinct from "7").
+static int same_token(const Token* a, const Token* b) {
+    return a->type == b->type && a->op == b->op && a->value == b->value &&
+           (a->type != TOKEN_NUMBER || a->length == b->length);
+}
+
+static unsigned hash_key(ASTNodeType type, const Token* token, int left, int right) {
+    unsigned hash = 2166136261u;
+    unsigned long long value = (unsigned long long)token->value;
+    hash = (hash ^ (unsigned)(token->type | token->op << 8)) * 16777619u;
+    hash = (hash ^ (unsigned)value) * 16777619u;
+    hash = (hash ^ (unsigned)(value >> 32)) * 16777619u;
+    hash = (hash ^ (unsigned)type) * 16777619u;
+    hash = (hash ^ (unsigned)(left + 1)) * 16777619u;
+    hash = (hash ^ (unsigned)(right + 1)) * 16777619u;
+    return hash;
+}
+
+static int child_id(const ASTNode* child) {
+    return child ? child->dag_id : -1;
+}
+
+// Returns the bucket holding the matching entry, or the empty bucket to use.
+static int find_bucket(unsigned hash, ASTNodeType type, const Token* token,
+                       const ASTNode* left, const ASTNode* right) {
+    unsigned mask = (unsigned)bucket_capacity - 1;
+    unsigned i = hash & mask;
+    while (buckets[i]) {
+        const DagEntry* entry = &entries[buckets[i] - 1];
+        const ASTNode* node = entry->node;
+        if (entry->hash == hash && node->type == type && node->left == left &&
+            node->right == right && same_token(&node->token, token))
+            break;
+        i = (i + 1) & mask;
+    }
+    return (int)i;
+}
+
+static void grow_buckets(void) {
+    int capacity = bucket_capacity ? bucket_capacity * 2 : 1024;
+    int* grown = mem_calloc(MEM_DAG, capacity, sizeof(int));
+    if (!grown)
+        out_of_memory();
+    mem_free(buckets);
+    buckets = grown;
+    bucket_capacity = capacity;
+    unsigned mask = (unsigned)capacity - 1;
+    for (int e = 0; e < entry_count; e++) {
+        unsigned i = entries[e].hash & mask;
+        while (buckets[i])
+            i = (i + 1) & mask;
+        buckets[i] = e + 1;
+    }
+}
+
+static void add_parent(ASTNode* child, int parent) {
+    if (!child)
+        return;
+    DagEntry* entry = &entries[child->dag_id];
+    if (entry->parent_count && entry->parents[entry->parent_count - 1] == parent)
+        return;   // Both operands are the same node
+    if (entry->parent_count == entry->parent_capacity) {
+        int capacity = entry->parent_capacity ? entry->parent_capacity * 2 : 2;
+        int* grown = mem_realloc(MEM_DAG, entry->parents, capacity * sizeof(int));
+        if (!grown)
+            out_of_memory();
+        entry->parents = grown;
+        entry->parent_capacity = capacity;
+    }
+    entry->parents[entry->parent_count++] = parent;
+}
+
+ASTNode* dag_intern(ASTNode* node) {
+    stats.requested++;
+    if ((entry_count + 1) * 2 > bucket_capacity)
+        grow_buckets();
+    unsigned hash = hash_key(node->type, &node->token, child_id(node->left), child_id(node->right));
+    int bucket = find_bucket(hash, node->type, &node->token, node->left, node->right);
+    if (buckets[bucket]) {
+        mem_free(node);
+        return entries[buckets[bucket] - 1].node;
+    }
+    if (entry_count == entry_capacity) {
+        int capacity = entry_capacity ? entry_capacity * 2 : 1024;
+        DagEntry* grown = mem_realloc(MEM_DAG, entries, capacity * sizeof(DagEntry));
+        if (!grown)
+            out_of_memory();
+        entries = grown;
+        int* stack = mem_realloc(MEM_DAG, walk_stack, capacity * sizeof(int));
+        if (!stack)
+            out_of_memory();
+        walk_stack = stack;
+        entry_capacity = capacity;
+    }
+    DagEntry* entry = &entries[entry_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->node = node;
+    entry->hash = hash;
+    node->dag_id = entry_count++;
+    buckets[bucket] = node->dag_id + 1;
+    add_parent(node->left, node->dag_id);
+    add_parent(node->right, node->dag_id);
+    stats.unique = entry_count;
+    return node;
+}
+
+// --------------------------------------------------------------------------
+// Check cache
+// --------------------------------------------------------------------------
+
+int dag_check_cached(const ASTNode* node) {
+    if (entries[node->dag_id].cached) {
+        stats.check_hits++;
+        return 1;
+    }
+    stats.check_misses++;
+    return 0;
+}
+
+void dag_store_check(const ASTNode* node) {
+    entries[node->dag_id].cached = 1;
+}
+
+// A cached parent implies cached children, so the walk up stops at the first
+// node that is already clear.
+void dag_invalidate_name(const Token* name) {
+    if (!entry_count)
+        return;
+    unsigned hash = hash_key(AST_IDENTIFIER, name, -1, -1);
+    int bucket = find_bucket(hash, AST_IDENTIFIER, name, NULL, NULL);
+    if (!buckets[bucket] || !entries[buckets[bucket] - 1].cached)
+        return;
+    int* stack = walk_stack;
+    int top = 0;
+    stack[top++] = buckets[bucket] - 1;
+    entries[stack[0]].cached = 0;
+    while (top) {
+        DagEntry* entry = &entries[stack[--top]];
+        stats.invalidated++;
+        for (int i = 0; i < entry->parent_count; i++) {
+            DagEntry* parent = &entries[entry->parents[i]];
+            if (parent->cached) {
+                parent->cached = 0;
+                stack[top++] = entry->parents[i];
+            }
+        }
+    }
+}
+
+void dag_get_stats(DagStats* out) {
+    *out = stats;
+}
+
+void dag_free(void) {
+    for (int i = 0; i < entry_count; i++) {
+        mem_free(entries[i].parents);
+        mem_free(entries[i].node);
+    }
+    mem_free(entries);
+    mem_free(buckets);
+    mem_free(walk_stack);
+    entries = NULL;
+    buckets = NULL;
+    walk_stack = NULL;
+    entry_count = entry_capacity = bucket_capacity = 0;
+    memset(&stats, 0, sizeof(stats));
+}
@@ -2,9 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include "../../include/parser.h"
 #include "../../include/lexer.h"
 #include "../../include/tokens.h"
+#include "../../include/semantic.h"
+#include "../../include/alloc.h"
+#include "../../include/dag.h"
+#include "../../include/trace.h"
+#include "../../include/token_pipeline.h"
 
 /* Rename the parser's Symbol struct to ParserSymbol to avoid conflict with semantic's Symbol */
 typedef struct ParserSymbol {
@@ -16,28 +22,77 @@ static ParserSymbol *current_scope = NULL;
 
 void push_scope() {
     // Create a new empty scope by pushing a marker onto the stack.
-    ParserSymbol *new_scope = malloc(sizeof(ParserSymbol));
+    ParserSymbol *new_scope = mem_alloc(MEM_PARSER, sizeof(ParserSymbol));
     new_scope->name[0] = '\0';  // marker (empty name)
     new_scope->next = current_scope;
     current_scope = new_scope;
 }
 
 void pop_scope() {
-    if (current_scope) {
+    // Drop the scope's symbols along with its marker.
+    while (current_scope) {
         ParserSymbol *old = current_scope;
+        int marker = (old->name[0] == '\0');
         current_scope = current_scope->next;
-        free(old);
+        mem_free(old);
+        if (marker)
+            break;
+    }
+}
+
+static void clear_scopes(void) {
+    while (current_scope) {
+        ParserSymbol *old = current_scope;
+        current_scope = current_scope->next;
+        mem_free(old);
     }
 }
 
 /* Renamed function: add_parser_symbol */
 void add_parser_symbol(const char *name) {
-    ParserSymbol *sym = malloc(sizeof(ParserSymbol));
+    ParserSymbol *sym = mem_alloc(MEM_PARSER, sizeof(ParserSymbol));
     strcpy(sym->name, name);
     sym->next = current_scope;
     current_scope = sym;
 }
 
+// --------------------------------------------------------------------------
+// Fused parse-and-check state (see parse_checked)
+// --------------------------------------------------------------------------
+
+/* While check_table is set the parser resolves names against the semantic
+ * symbol table instead of its own scope stack. check_suppressed counts
+ * enclosing constructs that analyze_semantics never descends into (repeat
+ * bodies, the rest of a statement after a failed target check), so both
+ * paths report the same diagnostics. */
+static SymbolTable *check_table = NULL;
+static int check_suppressed = 0;
+static int check_failures = 0;
+
+/* With build_ast cleared every node request is served by one scratch node,
+ * so a validation-only parse allocates nothing and its memory is bounded by
+ * the nesting depth. */
+static int build_ast = 1;
+static ASTNode scratch_node;
+
+static int checking(void) {
+    return check_table != NULL && check_suppressed == 0;
+}
+
+static void open_scope(void) {
+    if (!check_table)
+        push_scope();
+    else if (!check_suppressed)
+        enter_scope(check_table);
+}
+
+static void close_scope(void) {
+    if (!check_table)
+        pop_scope();
+    else if (!check_suppressed)
+        exit_scope(check_table);
+}
+
 // --------------------------------------------------------------------------
 // Parser implementation
 // --------------------------------------------------------------------------
@@ -65,76 +120,195 @@ static ASTNode *parse_block(void);
 static ASTNode *parse_function_call(ASTNode *identifierNode);
 
 static ASTNode *parse_bool_expression(void);
-static ASTNode *parse_factor(void);
-static ASTNode *parse_term(void);
 static ASTNode *parse_expression(void);
 
-static int is_comparison_operator(const char *op) {
-    return (strcmp(op, "<") == 0 ||
-            strcmp(op, ">") == 0 ||
-            strcmp(op, "==") == 0 ||
-            strcmp(op, "!=") == 0);
-}
+// --------------------------------------------------------------------------
+// Operator table
+// --------------------------------------------------------------------------
 
-// Current token being processed
+/* Expressions are parsed by precedence climbing over this table. An infix
+ * binding power of 0 means the operator is not infix, a prefix power of 0
+ * that it is not prefix; all binary operators are left-associative. Prefix
+ * operators build an AST_BINOP with no left operand. Comparisons bind
+ * loosest and are only reached from conditions (parse_bool_expression). */
+enum {
+    BP_NONE = 0,
+    BP_COMPARISON = 10,
+    BP_ADDITIVE = 20,
+    BP_MULTIPLICATIVE = 30
+};
+
+typedef struct {
+    int infix;
+    int prefix;
+} Operator;
+
+// Indexed by the OperatorId the lexer decoded; OP_NONE binds nothing.
+static const Operator operators[OP_COUNT] = {
+    [OP_EQ]  = {BP_COMPARISON, BP_NONE},
+    [OP_NE]  = {BP_COMPARISON, BP_NONE},
+    [OP_LT]  = {BP_COMPARISON, BP_NONE},
+    [OP_GT]  = {BP_COMPARISON, BP_NONE},
+    [OP_ADD] = {BP_ADDITIVE, BP_NONE},
+    [OP_SUB] = {BP_ADDITIVE, BP_NONE},
+    [OP_MUL] = {BP_MULTIPLICATIVE, BP_NONE},
+    [OP_DIV] = {BP_MULTIPLICATIVE, BP_NONE},
+};
+
+// Current token being processed, and its operator (OP_NONE unless an operator)
 static Token current_token;
+static int current_op = OP_NONE;
 static int position = 0;
 static const char *source;
+static TokenPipeline *pipeline = NULL;   // Lexer thread feeding advance(), if any
+
+static ParseErrorSink error_sink = NULL;
+static void *error_context = NULL;
+
+void set_parse_error_sink(ParseErrorSink sink, void *context) {
+    error_sink = sink;
+    error_context = context;
+}
+
+// Print a finished diagnostic, or hand it to the sink.
+static void report(int line, const char *format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (error_sink)
+        error_sink(error_context, line, message);
+    else
+        fputs(message, stdout);
+}
+
+/* While a recovery point is set every node of the parse in progress is
+ * remembered, so a parse error can free the unfinished tree. */
+static jmp_buf *recovery = NULL;
+static ASTNode **pending_nodes = NULL;
+static int pending_count = 0;
+static int pending_capacity = 0;
+
+static void remember_node(ASTNode *node) {
+    if (pending_count == pending_capacity) {
+        int new_capacity = pending_capacity ? pending_capacity * 2 : 256;
+        ASTNode **grown = mem_realloc(MEM_PARSER, pending_nodes, new_capacity * sizeof(ASTNode *));
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        pending_nodes = grown;
+        pending_capacity = new_capacity;
+    }
+    pending_nodes[pending_count++] = node;
+}
+
+void parser_set_recovery(jmp_buf *point) {
+    recovery = point;
+    pending_count = 0;
+    if (!point) {
+        mem_free(pending_nodes);
+        pending_nodes = NULL;
+        pending_capacity = 0;
+    }
+}
+
+// Parse errors end the run; a pipelined lexer is stopped and joined first.
+// Under a recovery point the parser is reset and control returns there.
+static void parse_abort(void) {
+    parser_close();
+    if (!recovery)
+        exit(1);
+    for (int i = 0; i < pending_count; i++)
+        mem_free(pending_nodes[i]);
+    pending_count = 0;
+    clear_scopes();
+    check_table = NULL;
+    build_ast = 1;
+    longjmp(*recovery, 1);
+}
 
 static void parse_error(ParseError error, Token token) {
-    printf("Parse Error at line %d: ", token.line);
+    const char *format;
     switch (error) {
         case PARSE_ERROR_UNEXPECTED_TOKEN:
-            printf("Unexpected token '%s'\n", token.lexeme);
+            format = "Unexpected token '%s'";
             break;
         case PARSE_ERROR_MISSING_SEMICOLON:
-            printf("Missing semicolon after '%s'\n", token.lexeme);
+            format = "Missing semicolon after '%s'";
             break;
         case PARSE_ERROR_MISSING_IDENTIFIER:
-            printf("Expected identifier after '%s'\n", token.lexeme);
+            format = "Expected identifier after '%s'";
             break;
         case PARSE_ERROR_MISSING_EQUALS:
-            printf("Expected '=' after '%s'\n", token.lexeme);
+            format = "Expected '=' after '%s'";
             break;
         case PARSE_ERROR_INVALID_EXPRESSION:
-            printf("Invalid expression after '%s'\n", token.lexeme);
+            format = "Invalid expression after '%s'";
             break;
         case PARSE_ERROR_MISSING_LPAREN:
-            printf("Missing '(' near '%s'\n", token.lexeme);
+            format = "Missing '(' near '%s'";
             break;
         case PARSE_ERROR_MISSING_RPAREN:
-            printf("Missing ')' near '%s'\n", token.lexeme);
+            format = "Missing ')' near '%s'";
             break;
         case PARSE_ERROR_MISSING_BLOCK:
-            printf("Missing block braces near '%s'\n", token.lexeme);
+            format = "Missing block braces near '%s'";
             break;
         case PARSE_ERROR_INVALID_OPERATOR:
-            printf("Invalid operator '%s'\n", token.lexeme);
+            format = "Invalid operator '%s'";
             break;
         case PARSE_ERROR_FUNCTION_CALL_ERROR:
-            printf("Function call error near '%s'\n", token.lexeme);
+            format = "Function call error near '%s'";
             break;
         default:
-            printf("Unknown error\n");
+            format = "Unknown error";
     }
+    char text[TOKEN_TEXT_SIZE];
+    char detail[160];
+    snprintf(detail, sizeof(detail), format, token_text(&token, text, sizeof(text)));
+    int line = token_line(token);
+    report(line, "Parse Error at line %d: %s\n", line, detail);
+}
+
+static void parse_expected(const char *what) {
+    int line = token_line(current_token);
+    char text[TOKEN_TEXT_SIZE];
+    // Numbers only start expressions, so this is where a too large one ends up
+    const char *why = current_token.error == ERROR_NUMBER_OVERFLOW
+                          ? ", which does not fit in a signed 64-bit integer" : "";
+    report(line, "Parse Error at line %d: Expected %s, but found '%s'%s\n", line, what,
+           token_text(&current_token, text, sizeof(text)), why);
 }
 
 static void advance(void) {
-    current_token = get_next_token(source, &position);
+    current_token = pipeline ? token_pipeline_next(pipeline) : get_next_token(source, &position);
+    current_op = current_token.type == TOKEN_OPERATOR ? current_token.op : OP_NONE;
 }
 
 static ASTNode *create_node(ASTNodeType type) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = build_ast ? mem_alloc(MEM_AST, sizeof(ASTNode)) : &scratch_node;
+    if (node && recovery && build_ast)
+        remember_node(node);
     if (node) {
         node->type = type;
         node->token = current_token;
         node->left = NULL;
         node->right = NULL;
         node->next = NULL;  // Initialize the chaining pointer
+        node->symbol_id = -1;
+        node->slot = -1;
+        node->dag_id = -1;
     }
     return node;
 }
 
+// Expression nodes go through the DAG when it is enabled for a tree parse.
+static ASTNode *share(ASTNode *node) {
+    return (dag_enabled() && !check_table) ? dag_intern(node) : node;
+}
+
 static int match(TokenType type) {
     return current_token.type == type;
 }
@@ -165,17 +339,17 @@ static ASTNode *parse_if_statement(void) {
     advance();  // consume 'if'
     
     if (!match(TOKEN_LPAREN)) {
-        printf("Parse Error at line %d: Expected '(' after 'if', but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("'(' after 'if'");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance(); // consume '('
 
     node->left = parse_bool_expression();
     if (!match(TOKEN_RPAREN)) {
-        printf("Parse Error at line %d: Expected ')' after if condition, but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("')' after if condition");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance(); // consume ')'
     
@@ -194,16 +368,16 @@ static ASTNode *parse_while_statement(void) {
     ASTNode *node = create_node(AST_WHILE);
     advance();  // consume 'while'
     if (!match(TOKEN_LPAREN)) {
-        printf("Parse Error at line %d: Expected '(' after 'while', but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("'(' after 'while'");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance(); // consume '('
     node->left = parse_bool_expression();
     if (!match(TOKEN_RPAREN)) {
-        printf("Parse Error at line %d: Expected ')' after while condition, but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("')' after while condition");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance(); // consume ')'
     node->right = parse_block();
@@ -213,31 +387,33 @@ static ASTNode *parse_while_statement(void) {
 static ASTNode *parse_repeat_statement(void) {
     ASTNode *node = create_node(AST_REPEAT);
     advance(); // consume 'repeat'
+    check_suppressed++;  // analyze_semantics does not look inside repeat-until
     node->left = parse_block();
     if (!match(TOKEN_UNTIL)) {
-        printf("Parse Error at line %d: Expected 'until' after repeat block, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("'until' after repeat block");
+        parse_abort();
     }
     advance(); // consume 'until'
     if (!match(TOKEN_LPAREN)) {
-        printf("Parse Error at line %d: Expected '(' after 'until', but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("'(' after 'until'");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance();
     ASTNode *condition = parse_bool_expression();
     node->right = condition;
     if (!match(TOKEN_RPAREN)) {
-        printf("Parse Error at line %d: Expected ')' after repeat condition, but found '%s'\n", current_token.line, current_token.lexeme);
+        parse_expected("')' after repeat condition");
         synchronize();
-        exit(1);
+        parse_abort();
     }
     advance();
     if (!match(TOKEN_SEMICOLON)) {
-        printf("Parse Error at line %d: Expected ';' after repeat statement, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("';' after repeat statement");
+        parse_abort();
     }
     advance(); // consume ';'
+    check_suppressed--;
     return node;
 }
 
@@ -246,15 +422,39 @@ static ASTNode *parse_print_statement(void) {
     advance(); // consume 'print'
     node->left = parse_expression();
     if (!match(TOKEN_SEMICOLON)) {
-        printf("Parse Error at line %d: Expected ';' after print statement, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("';' after print statement");
+        parse_abort();
+    }
+    advance(); // consume ';'
+    return node;
+}
+
+// read x; stores the next input value, so it initializes x like an assignment
+static ASTNode *parse_read_statement(void) {
+    ASTNode *node = create_node(AST_READ);
+    advance(); // consume 'read'
+    if (!match(TOKEN_IDENTIFIER)) {
+        parse_expected("identifier after 'read'");
+        parse_abort();
+    }
+    node->left = create_node(AST_IDENTIFIER);
+    if (checking()) {
+        Symbol *target = NULL;
+        if (!check_assigned_name(&current_token, check_table, &target))
+            check_failures++;
+        resolve_node(node->left, check_table, target);
+    }
+    advance();
+    if (!match(TOKEN_SEMICOLON)) {
+        parse_expected("';' after read statement");
+        parse_abort();
     }
     advance(); // consume ';'
     return node;
 }
 
 static ASTNode *parse_block(void) {
-    push_scope();
+    open_scope();
     ASTNode *node = create_node(AST_BLOCK);
     expect(TOKEN_LBRACE);
     ASTNode *firstStmt = NULL;
@@ -271,7 +471,7 @@ static ASTNode *parse_block(void) {
     }
     expect(TOKEN_RBRACE);
     node->left = firstStmt;  // The block's statements are in the left subtree
-    pop_scope();
+    close_scope();
     return node;
 }
 
@@ -291,24 +491,43 @@ static ASTNode *parse_declaration(void) {
     advance(); // consume 'int'
 
     if (!match(TOKEN_IDENTIFIER)) {
-        printf("Parse Error at line %d: Expected identifier after 'int', but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("identifier after 'int'");
+        parse_abort();
     }
     
     node->token = current_token;
-    /* Use the renamed function for the parser's own symbol table */
-    add_parser_symbol(current_token.lexeme);
+    Symbol *declared = NULL;
+    int check_init = checking();
+    if (check_init) {
+        if (check_declared_name(&current_token, check_table)) {
+            declared = check_table->head;
+            resolve_node(node, check_table, declared);
+        } else
+            check_failures++;
+    } else if (!check_table) {
+        /* Use the renamed function for the parser's own symbol table */
+        add_parser_symbol(token_name(&current_token));
+    }
     advance();
 
     if (match(TOKEN_EQUALS)) {
+        if (declared)
+            record_initializer(check_table, declared, &node->token, node);
         advance(); // consume '='
+        int failures_before = check_failures;
+        if (check_init && !declared)
+            check_suppressed++;
         ASTNode *initExpr = parse_expression();
+        if (check_init && !declared)
+            check_suppressed--;
+        else if (declared && check_failures == failures_before)
+            mark_initialized(check_table, declared, current_token.offset);
         node->right = initExpr;
     }
 
     if (!match(TOKEN_SEMICOLON)) {
-        printf("Parse Error at line %d: Expected ';' at end of declaration, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("';' at end of declaration");
+        parse_abort();
     }
     
     advance();
@@ -319,19 +538,31 @@ static ASTNode *parse_assignment(void) {
     ASTNode *node = create_node(AST_ASSIGN);
     node->left = create_node(AST_IDENTIFIER);
     node->left->token = current_token;
+    int target_valid = 1;
+    if (checking()) {
+        Symbol *target = NULL;
+        if (!(target_valid = check_assigned_name(&current_token, check_table, &target)))
+            check_failures++;
+        resolve_node(node, check_table, target);
+        resolve_node(node->left, check_table, target);
+    }
     advance();
 
     if (!match(TOKEN_EQUALS)) {
-        printf("Parse Error at line %d: Expected '=' after identifier in assignment, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("'=' after identifier in assignment");
+        parse_abort();
     }
     advance();
 
+    if (!target_valid)
+        check_suppressed++;
     node->right = parse_expression();
+    if (!target_valid)
+        check_suppressed--;
 
     if (!match(TOKEN_SEMICOLON)) {
-        printf("Parse Error at line %d: Expected ';' after assignment, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("';' after assignment");
+        parse_abort();
     }
     advance();
     return node;
@@ -350,105 +581,166 @@ static ASTNode *parse_statement(void) {
         return parse_repeat_statement();
     } else if (match(TOKEN_PRINT)) {
         return parse_print_statement();
+    } else if (match(TOKEN_READ)) {
+        return parse_read_statement();
     } else if (match(TOKEN_LBRACE)) {
         return parse_block();
     }
 
-    printf("Syntax Error: Unexpected token '%s' at line %d\n", current_token.lexeme, current_token.line);
-    exit(1);
+    char text[TOKEN_TEXT_SIZE];
+    report(token_line(current_token), "Syntax Error: Unexpected token '%s' at line %d\n",
+           token_text(&current_token, text, sizeof(text)), token_line(current_token));
+    parse_abort();
     return NULL;
 }
 
-static ASTNode *parse_factor(void) {
+static ASTNode *parse_binary(int min_bp);
+
+// A primary: number, identifier, call, parenthesized expression, or a prefix
+// operator applied to its operand.
+static ASTNode *parse_operand(void) {
     ASTNode *node = NULL;
+    int op;
     if (match(TOKEN_NUMBER)) {
-        node = create_node(AST_NUMBER);
+        node = share(create_node(AST_NUMBER));
         advance();
     } else if (match(TOKEN_IDENTIFIER)) {
-        //printf("DEBUG: creating identifier node for '%s' at line %d\n", current_token.lexeme, current_token.line);
         node = create_node(AST_IDENTIFIER);
-        node->token = current_token;
         advance();
         if (match(TOKEN_LPAREN)) {
-            node = parse_function_call(node);
+            int callee_valid = 1;
+            if (checking() && !(callee_valid = check_callee_name(&node->token, &current_token)))
+                check_failures++;
+            if (!callee_valid)
+                check_suppressed++;
+            node = share(parse_function_call(share(node)));
+            if (!callee_valid)
+                check_suppressed--;
+        } else if (checking()) {
+            Symbol *symbol = NULL;
+            if (!check_identifier_use(&node->token, check_table, &symbol))
+                check_failures++;
+            resolve_node(node, check_table, symbol);
+        } else {
+            node = share(node);
         }
     } else if (match(TOKEN_LPAREN)) {
         advance();
         node = parse_expression();
         expect(TOKEN_RPAREN);
+    } else if ((op = current_op) != OP_NONE && operators[op].prefix) {
+        node = create_node(AST_BINOP);
+        advance();
+        node->right = parse_binary(operators[op].prefix);
+        node = share(node);
     } else {
-        printf("Parse Error at line %d: Expected number, identifier, or '(' in expression, but found '%s'\n", current_token.line, current_token.lexeme);
-        exit(1);
+        parse_expected("number, identifier, or '(' in expression");
+        parse_abort();
     }
     return node;
 }
 
-static ASTNode *parse_term(void) {
-    ASTNode *node = parse_factor();
-    while (match(TOKEN_OPERATOR) &&
-          (current_token.lexeme[0] == '*' || current_token.lexeme[0] == '/')) {
+// Parses operators binding at least min_bp, one call per operator.
+static ASTNode *parse_binary(int min_bp) {
+    ASTNode *node = parse_operand();
+    int op;
+    while ((op = current_op) != OP_NONE && operators[op].infix >= min_bp) {
         ASTNode *binOpNode = create_node(AST_BINOP);
-        binOpNode->token = current_token;
         advance();
         binOpNode->left = node;
-        binOpNode->right = parse_factor();
-        node = binOpNode;
+        binOpNode->right = parse_binary(operators[op].infix + 1);
+        node = share(binOpNode);
     }
     return node;
 }
 
 static ASTNode *parse_expression(void) {
-    ASTNode *node = parse_term();
-    while (match(TOKEN_OPERATOR) &&
-          (current_token.lexeme[0] == '+' || current_token.lexeme[0] == '-')) {
-        ASTNode *binOpNode = create_node(AST_BINOP);
-        binOpNode->token = current_token;
-        advance();
-        binOpNode->left = node;
-        binOpNode->right = parse_term();
-        node = binOpNode;
-    }
-    return node;
+    return parse_binary(BP_ADDITIVE);
 }
 
 static ASTNode *parse_bool_expression(void) {
-    ASTNode *node = parse_expression();
-    while (match(TOKEN_OPERATOR) && is_comparison_operator(current_token.lexeme)) {
-        ASTNode *binOpNode = create_node(AST_BINOP);
-        binOpNode->token = current_token;
-        advance();
-        binOpNode->left = node;
-        binOpNode->right = parse_expression();
-        node = binOpNode;
-    }
-    return node;
+    return parse_binary(BP_COMPARISON);
 }
 
 static ASTNode *parse_program(void) {
+    TRACE_BEGIN("parse_program");
     ASTNode *program = create_node(AST_PROGRAM);
     ASTNode *current = program;
     while (!match(TOKEN_EOF)) {
+        TRACE_BEGIN_AT("parse_statement", current_token.offset);
         current->left = parse_statement();
+        TRACE_END();
         if (!match(TOKEN_EOF)) {
             current->next = create_node(AST_PROGRAM);
             current = current->next;
         }
     }
+    TRACE_END();
     return program;
 }
 
 void parser_init(const char *input) {
+    parser_close();
     source = input;
     position = 0;
+    lexer_set_source(input);
     advance();
 }
 
+int parser_init_pipelined(const char *input) {
+    parser_close();
+    source = input;
+    position = 0;
+    lexer_set_source(input);
+    pipeline = token_pipeline_start(input);
+    advance();
+    return pipeline != NULL;
+}
+
+void parser_close(void) {
+    token_pipeline_stop(pipeline);
+    pipeline = NULL;
+}
+
 ASTNode *parse(void) {
-    return parse_program();
+    ASTNode *program = parse_program();
+    clear_scopes();   // Global declarations have no marker to pop to
+    return program;
+}
+
+ASTNode *parse_next_statement(void) {
+    if (match(TOKEN_EOF)) {
+        clear_scopes();
+        return NULL;
+    }
+    TRACE_BEGIN_AT("parse_statement", current_token.offset);
+    ASTNode *statement = parse_statement();
+    TRACE_END();
+    return statement;
+}
+
+ASTNode *parse_checked(SymbolTable *table, int build, int *result) {
+    check_table = table;
+    check_suppressed = 0;
+    check_failures = 0;
+    build_ast = build;
+    ASTNode *program = parse_program();
+    clear_scopes();
+    *result = (check_failures == 0);
+    check_table = NULL;
+    build_ast = 1;
+    return build ? program : NULL;
+}
+
+static void print_slot(const ASTNode *node) {
+    if (node->symbol_id >= 0)
+        printf(" [symbol %d, slot %d]", node->symbol_id, node->slot);
+    printf("\n");
 }
 
 void print_ast(ASTNode *node, int level) {
     if (!node) return;
+    char text[TOKEN_TEXT_SIZE];
     for (int i = 0; i < level; i++) printf("  ");
     // Print node info based on type...
     switch (node->type) {
@@ -456,16 +748,19 @@ void print_ast(ASTNode *node, int level) {
             printf("Program\n");
             break;
         case AST_VARDECL:
-            printf("VarDecl: %s\n", node->token.lexeme);
+            printf("VarDecl: %s", token_name(&node->token));
+            print_slot(node);
             break;
         case AST_ASSIGN:
-            printf("Assign\n");
+            printf("Assign");
+            print_slot(node);
             break;
         case AST_NUMBER:
-            printf("Number: %s\n", node->token.lexeme);
+            printf("Number: %s\n", token_text(&node->token, text, sizeof(text)));
             break;
         case AST_IDENTIFIER:
-            printf("Identifier: %s\n", node->token.lexeme);
+            printf("Identifier: %s", token_name(&node->token));
+            print_slot(node);
             break;
         case AST_IF:
             printf("If Statement\n");
@@ -480,13 +775,16 @@ void print_ast(ASTNode *node, int level) {
             printf("Block\n");
             break;
         case AST_BINOP:
-            printf("BinaryOp: %s\n", node->token.lexeme);
+            printf("BinaryOp: %s\n", operator_text(node->token.op));
             break;
         case AST_PRINT:
             printf("Print Statement\n");
             break;
         case AST_FUNC_CALL:
-            printf("Function Call: %s\n", node->left->token.lexeme);
+            printf("Function Call: %s\n", token_name(&node->left->token));
+            break;
+        case AST_READ:
+            printf("Read Statement\n");
             break;
         default:
             printf("Unknown node type\n");
@@ -500,10 +798,15 @@ void print_ast(ASTNode *node, int level) {
 
 
 void free_ast(ASTNode *node) {
-    if (!node) return;
-    free_ast(node->left);
-    free_ast(node->right);
-    free(node);
+    // Statement chains are freed iteratively; only children recurse. Shared
+    // expression nodes are left to dag_free.
+    while (node && node->dag_id < 0) {
+        ASTNode *next = node->next;
+        free_ast(node->left);
+        free_ast(node->right);
+        mem_free(node);
+        node = next;
+    }
 }
 
 /* 
@@ -0,0 +1,973 @@
+/* parallel.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#ifndef SEMANTIC_NO_THREADS
+#include <pthread.h>
+#endif
+#include "../../include/semantic.h"
+#include "../../include/psymtab.h"
+#include "../../include/lexer.h"
+#include "../../include/alloc.h"
+#include "../../include/trace.h"
+#include "../../include/intern.h"
+
+// Statement ranges lighter than this many AST nodes per side are not split.
+#ifndef PARALLEL_GRAIN
+#define PARALLEL_GRAIN 4096
+#endif
+
+/* Parallel checking model
+ *
+ * A Task checks a run of statements against its own version of a persistent
+ * symbol table, buffering diagnostics and recording which names it looked at
+ * (reads) and changed (writes: declarations, initialization, "already
+ * reported" marks). Sibling ranges are forked from the same snapshot: the
+ * left half runs inline, the right half on a helper thread. At the join the
+ * left half is taken as is; the right half is valid only if it read nothing
+ * the left half wrote, since symbols declared in a block stay visible to the
+ * statements that follow it. Valid results are merged by copying the right
+ * half's entries for the names it wrote; otherwise the right half is checked
+ * again on the merged table. Either way the diagnostics, their order and the
+ * final table are the ones the sequential checker produces. */
+
+typedef struct {
+    const char** names;
+    unsigned* hashes;
+    int count;
+    int capacity;           // Power of two, or 0
+} NameSet;
+
+typedef struct {
+    PSymTab table;
+    PArena arena;
+    NameSet reads;
+    NameSet writes;
+    PDecl** decls;          // Declarations in order
+    int decl_count;
+    int decl_capacity;
+    char* diags;            // Buffered diagnostics
+    size_t diag_length;
+    size_t diag_capacity;
+    int result;
+    int base_reported;      // table.reported_count at fork time
+    int report_attempts;    // Names this task tried to mark reported
+    struct ExternalSet* external;  // Map-reduce chunks only, see below
+    long lookups;           // Names looked up by the work kept (semantic_lookups)
+} Task;
+
+typedef struct {
+    Task* task;
+    ASTNode** items;
+    const long* prefix;     // prefix[i] = weight of items[0..i)
+    int begin;
+    int end;
+} RangeJob;
+
+static atomic_int free_helpers;
+static int max_helpers = 0;
+
+static int task_check_statement(Task* task, ASTNode* node);
+static void task_check_range(Task* task, ASTNode** items, const long* prefix, int begin, int end);
+
+static void* grow(void* data, int* capacity, int count, size_t element_size) {
+    if (count < *capacity)
+        return data;
+    int new_capacity = *capacity ? *capacity * 2 : 16;
+    void* grown = mem_realloc(MEM_PARALLEL, data, new_capacity * element_size);
+    if (!grown) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+// --------------------------------------------------------------------------
+// Name sets (open addressing; names point into the AST)
+// --------------------------------------------------------------------------
+
+static int nameset_slot(const NameSet* set, const char* name, unsigned hash) {
+    unsigned mask = (unsigned)set->capacity - 1;
+    unsigned i = hash & mask;
+    while (set->names[i] && (set->hashes[i] != hash || strcmp(set->names[i], name) != 0))
+        i = (i + 1) & mask;
+    return (int)i;
+}
+
+static int nameset_contains(const NameSet* set, const char* name, unsigned hash) {
+    if (!set->count)
+        return 0;
+    return set->names[nameset_slot(set, name, hash)] != NULL;
+}
+
+static void nameset_add(NameSet* set, const char* name, unsigned hash) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        NameSet bigger = {0};
+        bigger.capacity = set->capacity ? set->capacity * 2 : 16;
+        bigger.names = mem_calloc(MEM_PARALLEL, bigger.capacity, sizeof(const char*));
+        bigger.hashes = mem_calloc(MEM_PARALLEL, bigger.capacity, sizeof(unsigned));
+        if (!bigger.names || !bigger.hashes) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        for (int i = 0; i < set->capacity; i++) {
+            if (set->names[i]) {
+                int slot = nameset_slot(&bigger, set->names[i], set->hashes[i]);
+                bigger.names[slot] = set->names[i];
+                bigger.hashes[slot] = set->hashes[i];
+                bigger.count++;
+            }
+        }
+        mem_free(set->names);
+        mem_free(set->hashes);
+        *set = bigger;
+    }
+    int slot = nameset_slot(set, name, hash);
+    if (!set->names[slot]) {
+        set->names[slot] = name;
+        set->hashes[slot] = hash;
+        set->count++;
+    }
+}
+
+static void nameset_free(NameSet* set) {
+    mem_free(set->names);
+    mem_free(set->hashes);
+    memset(set, 0, sizeof(*set));
+}
+
+// --------------------------------------------------------------------------
+// External names of a chunk (map-reduce)
+// --------------------------------------------------------------------------
+//
+// A chunk of top-level statements is checked on its own, starting from an
+// empty table. A name it has not declared itself must come from an earlier
+// chunk, so the check assumes the most likely answer and records the
+// assumption: a name used or assigned is declared, a name used before the
+// chunk assigns it is initialized, and a name the chunk declares at some
+// scope level has no earlier declaration at that level. Names are kept by
+// interned id.
+
+#define EXTERNAL_DECLARED    1
+#define EXTERNAL_INITIALIZED 2
+#define EXTERNAL_ASSIGNED    4   // The chunk initializes the earlier declaration
+
+typedef struct {
+    int name_id;
+    int level;
+} Absence;
+
+typedef struct ExternalSet {
+    int* ids;               // Open-addressed, -1 when empty
+    unsigned char* flags;
+    int count;
+    int capacity;           // Power of two, or 0
+    Absence* absent;        // Declarations assumed new at their level
+    int absent_count;
+    int absent_capacity;
+} ExternalSet;
+
+static int external_slot(const ExternalSet* set, int id) {
+    unsigned mask = (unsigned)set->capacity - 1;
+    unsigned i = ((unsigned)id * 2654435761u) & mask;
+    while (set->ids[i] >= 0 && set->ids[i] != id)
+        i = (i + 1) & mask;
+    return (int)i;
+}
+
+static unsigned char* external_flags(ExternalSet* set, int id) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        ExternalSet bigger = *set;
+        bigger.capacity = set->capacity ? set->capacity * 2 : 64;
+        bigger.ids = mem_alloc(MEM_PARALLEL, bigger.capacity * sizeof(int));
+        bigger.flags = mem_calloc(MEM_PARALLEL, bigger.capacity, 1);
+        if (!bigger.ids || !bigger.flags) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        memset(bigger.ids, -1, bigger.capacity * sizeof(int));
+        for (int i = 0; i < set->capacity; i++) {
+            if (set->ids[i] >= 0) {
+                int slot = external_slot(&bigger, set->ids[i]);
+                bigger.ids[slot] = set->ids[i];
+                bigger.flags[slot] = set->flags[i];
+            }
+        }
+        mem_free(set->ids);
+        mem_free(set->flags);
+        *set = bigger;
+    }
+    int slot = external_slot(set, id);
+    if (set->ids[slot] < 0) {
+        set->ids[slot] = id;
+        set->count++;
+    }
+    return &set->flags[slot];
+}
+
+static void external_free(ExternalSet* set) {
+    mem_free(set->ids);
+    mem_free(set->flags);
+    mem_free(set->absent);
+    memset(set, 0, sizeof(*set));
+}
+
+static void assume_used(Task* task, const Token* name) {
+    unsigned char* flags = external_flags(task->external, (int)name->value);
+    *flags |= EXTERNAL_DECLARED;
+    if (!(*flags & EXTERNAL_ASSIGNED))
+        *flags |= EXTERNAL_INITIALIZED;
+}
+
+static void assume_assigned(Task* task, const Token* name) {
+    *external_flags(task->external, (int)name->value) |= EXTERNAL_DECLARED | EXTERNAL_ASSIGNED;
+}
+
+static void assume_absent(Task* task, const Token* name, int level) {
+    ExternalSet* set = task->external;
+    set->absent = grow(set->absent, &set->absent_capacity, set->absent_count, sizeof(Absence));
+    set->absent[set->absent_count++] = (Absence){(int)name->value, level};
+}
+
+// --------------------------------------------------------------------------
+// Tasks
+// --------------------------------------------------------------------------
+
+static void task_fork(const Task* parent, Task* child) {
+    memset(child, 0, sizeof(*child));
+    child->table = parent->table;
+    child->result = 1;
+    child->base_reported = parent->table.reported_count;
+}
+
+static void task_free(Task* task) {
+    parena_free(&task->arena);
+    nameset_free(&task->reads);
+    nameset_free(&task->writes);
+    mem_free(task->decls);
+    mem_free(task->diags);
+}
+
+// Only fork-join compares reads and writes; chunk tasks are never forked.
+static void task_read(Task* task, const char* name) {
+    if (!task->external)
+        nameset_add(&task->reads, name, psymtab_hash(name));
+}
+
+static void task_write(Task* task, const char* name) {
+    if (!task->external)
+        nameset_add(&task->writes, name, psymtab_hash(name));
+}
+
+static void task_error(Task* task, SemanticErrorType error, const char* name, int line) {
+    char message[256];
+    int length = format_semantic_error(message, sizeof(message), error, name, line);
+    if (length < 0)
+        return;
+    if ((size_t)length >= sizeof(message))
+        length = sizeof(message) - 1;
+    if (task->diag_length + length > task->diag_capacity) {
+        size_t capacity = task->diag_capacity ? task->diag_capacity * 2 : 1024;
+        while (capacity < task->diag_length + length)
+            capacity *= 2;
+        char* grown = mem_realloc(MEM_PARALLEL, task->diags, capacity);
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        task->diags = grown;
+        task->diag_capacity = capacity;
+    }
+    memcpy(task->diags + task->diag_length, message, length);
+    task->diag_length += length;
+}
+
+// The right task's effects, checked against a snapshot taken before the left
+// task ran, still hold after it unless the left task changed something the
+// right one looked at.
+static int tasks_conflict(const Task* left, const Task* right) {
+    for (int i = 0; i < left->writes.capacity; i++) {
+        const char* name = left->writes.names[i];
+        if (name && nameset_contains(&right->reads, name, left->writes.hashes[i]))
+            return 1;
+    }
+    int reported = left->table.reported_count;
+    return reported != right->base_reported &&
+           reported + right->report_attempts > MAX_REPORTED_ERRORS;
+}
+
+static void task_append(Task* parent, Task* child);
+
+static void task_join(Task* parent, Task* child, int rebase) {
+    if (!rebase) {
+        parent->table = child->table;
+    } else {
+        for (int i = 0; i < child->writes.capacity; i++) {
+            const char* name = child->writes.names[i];
+            const PEntry* entry = name ? psymtab_entry(&child->table, name) : NULL;
+            if (entry)
+                psymtab_put_entry(&parent->arena, &parent->table, entry);
+        }
+        parent->table.reported_count += child->table.reported_count - child->base_reported;
+    }
+    for (int i = 0; i < child->reads.capacity; i++) {
+        if (child->reads.names[i])
+            nameset_add(&parent->reads, child->reads.names[i], child->reads.hashes[i]);
+    }
+    for (int i = 0; i < child->writes.capacity; i++) {
+        if (child->writes.names[i])
+            nameset_add(&parent->writes, child->writes.names[i], child->writes.hashes[i]);
+    }
+    task_append(parent, child);
+}
+
+// Declarations, diagnostics and memory of child follow the parent's; frees
+// child.
+static void task_append(Task* parent, Task* child) {
+    parent->lookups += child->lookups;
+    for (int i = 0; i < child->decl_count; i++) {
+        parent->decls = grow(parent->decls, &parent->decl_capacity, parent->decl_count, sizeof(PDecl*));
+        parent->decls[parent->decl_count++] = child->decls[i];
+    }
+    if (child->diag_length) {
+        size_t needed = parent->diag_length + child->diag_length;
+        if (needed > parent->diag_capacity) {
+            char* grown = mem_realloc(MEM_PARALLEL, parent->diags, needed);
+            if (!grown) {
+                perror("Memory allocation error");
+                exit(1);
+            }
+            parent->diags = grown;
+            parent->diag_capacity = needed;
+        }
+        memcpy(parent->diags + parent->diag_length, child->diags, child->diag_length);
+        parent->diag_length = needed;
+    }
+    parent->result &= child->result;
+    parent->report_attempts += child->report_attempts;
+    parena_adopt(&parent->arena, &child->arena);
+    task_free(child);
+}
+
+// --------------------------------------------------------------------------
+// Checks (mirror the tree walker in semantic.c)
+// --------------------------------------------------------------------------
+
+static void report_undeclared(Task* task, const char* name, int line) {
+    const PEntry* entry = psymtab_entry(&task->table, name);
+    if (entry && entry->reported)
+        return;
+    task_error(task, SEM_ERROR_UNDECLARED_VARIABLE, name, line);
+    task->report_attempts++;
+    if (task->table.reported_count < MAX_REPORTED_ERRORS) {
+        psymtab_set_reported(&task->arena, &task->table, name);
+        task_write(task, name);
+    }
+}
+
+static int task_check_expression(Task* task, ASTNode* node) {
+    if (!node)
+        return 0;
+    if (node->type == AST_NUMBER) {
+        return 1;
+    } else if (node->type == AST_IDENTIFIER) {
+        const char* name = token_name(&node->token);
+        task_read(task, name);
+        task->lookups++;
+        const PBinding* binding = psymtab_lookup(&task->table, name);
+        if (!binding && task->external) {
+            assume_used(task, &node->token);
+            return 1;
+        }
+        if (!binding) {
+            report_undeclared(task, name, token_line(node->token));
+            return 0;
+        }
+        if (!binding->is_initialized) {
+            task_error(task, SEM_ERROR_UNINITIALIZED_VARIABLE, name, token_line(node->token));
+            return 0;
+        }
+        return 1;
+    } else if (node->type == AST_BINOP) {
+        // A prefix operator has no left operand
+        int left_valid = node->left ? task_check_expression(task, node->left) : 1;
+        int right_valid = task_check_expression(task, node->right);
+        return left_valid & right_valid;
+    } else if (node->type == AST_FUNC_CALL) {
+        if (node->left->type != AST_IDENTIFIER) {
+            task_error(task, SEM_ERROR_INVALID_OPERATION, "Invalid function call", token_line(node->token));
+            return 0;
+        }
+        const char* callee = token_name(&node->left->token);
+        if (strcmp(callee, "factorial") != 0) {
+            task_error(task, SEM_ERROR_INVALID_OPERATION, callee, token_line(node->token));
+            return 0;
+        }
+        return task_check_expression(task, node->right);
+    }
+    return 1;
+}
+
+static int task_check_declaration(Task* task, ASTNode* node) {
+    const char* name = token_name(&node->token);
+    task_read(task, name);
+    task->lookups++;
+    if (psymtab_lookup_current_scope(&task->table, name)) {
+        task_error(task, SEM_ERROR_REDECLARED_VARIABLE, name, token_line(node->token));
+        return 0;
+    }
+    if (task->external)
+        assume_absent(task, &node->token, task->table.scope_level);
+    PDecl* decl = parena_alloc(&task->arena, sizeof(PDecl));
+    decl->name = name;
+    decl->name_id = (int)node->token.value;
+    decl->scope_level = task->table.scope_level;
+    decl->line_declared = token_line(node->token);
+    decl->is_initialized = 0;
+    psymtab_declare(&task->arena, &task->table, decl);
+    task_write(task, name);
+    task->decls = grow(task->decls, &task->decl_capacity, task->decl_count, sizeof(PDecl*));
+    task->decls[task->decl_count++] = decl;
+    if (node->right) {
+        if (!task_check_expression(task, node->right))
+            return 0;
+        psymtab_mark_initialized(&task->arena, &task->table, name);
+    }
+    return 1;
+}
+
+// The target of an assignment or read statement.
+static int task_check_target(Task* task, ASTNode* target) {
+    const char* name = token_name(&target->token);
+    task_read(task, name);
+    task->lookups++;
+    if (!psymtab_lookup(&task->table, name) && task->external) {
+        assume_assigned(task, &target->token);
+        return 1;
+    }
+    if (!psymtab_lookup(&task->table, name)) {
+        report_undeclared(task, name, token_line(target->token));
+        return 0;
+    }
+    psymtab_mark_initialized(&task->arena, &task->table, name);
+    task_write(task, name);
+    return 1;
+}
+
+static int task_check_assignment(Task* task, ASTNode* node) {
+    if (!node->left || !task_check_target(task, node->left))
+        return 0;
+    return task_check_expression(task, node->right);
+}
+
+static long tree_weight(const ASTNode* node) {
+    long weight = 0;
+    for (; node; node = node->next)
+        weight += 1 + tree_weight(node->left) + tree_weight(node->right);
+    return weight;
+}
+
+static int task_check_list(Task* task, ASTNode** items, int count) {
+    long* prefix = mem_alloc(MEM_PARALLEL, (count + 1) * sizeof(long));
+    if (!prefix) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    prefix[0] = 0;
+    for (int i = 0; i < count; i++)
+        prefix[i + 1] = prefix[i] + 1 + tree_weight(items[i]->left) + tree_weight(items[i]->right);
+    int saved = task->result;
+    task->result = 1;
+    task_check_range(task, items, prefix, 0, count);
+    int result = task->result;
+    task->result = saved;
+    mem_free(prefix);
+    return result;
+}
+
+static int task_check_block(Task* task, ASTNode* node) {
+    if (!node || node->type != AST_BLOCK)
+        return 0;
+    int result = 1;
+    task->table.scope_level++;
+    ASTNode* first = node->left;
+    if (max_helpers > 0 && first && first->next) {
+        int count = 0;
+        for (ASTNode* stmt = first; stmt; stmt = stmt->next)
+            count++;
+        ASTNode** items = mem_alloc(MEM_PARALLEL, count * sizeof(ASTNode*));
+        if (!items) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        count = 0;
+        for (ASTNode* stmt = first; stmt; stmt = stmt->next)
+            items[count++] = stmt;
+        result = task_check_list(task, items, count);
+        mem_free(items);
+    } else {
+        for (ASTNode* stmt = first; stmt; stmt = stmt->next)
+            result = task_check_statement(task, stmt) & result;
+    }
+    if (task->table.scope_level > 0)
+        task->table.scope_level--;
+    return result;
+}
+
+static int task_check_statement(Task* task, ASTNode* node) {
+    if (!node)
+        return 1;
+    switch (node->type) {
+        case AST_VARDECL:
+            return task_check_declaration(task, node);
+        case AST_ASSIGN:
+            return task_check_assignment(task, node);
+        case AST_PRINT:
+            return task_check_expression(task, node->left);
+        case AST_READ:
+            return node->left ? task_check_target(task, node->left) : 0;
+        case AST_IF: {
+            int condValid = task_check_expression(task, node->left);
+            ASTNode* elseBlock = (node->right) ? node->right->right : NULL;
+            if (max_helpers > 0 && elseBlock && node->right->type == AST_BLOCK &&
+                elseBlock->type == AST_BLOCK) {
+                ASTNode* branches[2] = {node->right, elseBlock};
+                return condValid & task_check_list(task, branches, 2);
+            }
+            int thenValid = (node->right) ? task_check_block(task, node->right) : 1;
+            int elseValid = (elseBlock) ? task_check_block(task, elseBlock) : 1;
+            return condValid & thenValid & elseValid;
+        }
+        case AST_WHILE: {
+            int condValid = task_check_expression(task, node->left);
+            int bodyValid = (node->right) ? task_check_block(task, node->right) : 1;
+            return condValid & bodyValid;
+        }
+        case AST_BLOCK:
+            return task_check_block(task, node);
+        default:
+            return task_check_expression(task, node);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Fork-join over statement ranges
+// --------------------------------------------------------------------------
+
+static int acquire_helper(void) {
+    int available = atomic_load(&free_helpers);
+    while (available > 0) {
+        if (atomic_compare_exchange_weak(&free_helpers, &available, available - 1))
+            return 1;
+    }
+    return 0;
+}
+
+static void* range_thread(void* arg) {
+    RangeJob* job = arg;
+    TRACE_BEGIN_AT("check_range", job->items[job->begin]->token.offset);
+    task_check_range(job->task, job->items, job->prefix, job->begin, job->end);
+    TRACE_END();
+    return NULL;
+}
+
+static void task_check_range(Task* task, ASTNode** items, const long* prefix, int begin, int end) {
+    long total = prefix[end] - prefix[begin];
+    if (end - begin >= 2 && total >= 2 * PARALLEL_GRAIN && acquire_helper()) {
+        int mid = begin + 1;
+        while (mid < end - 1 && (prefix[mid] - prefix[begin]) * 2 < total)
+            mid++;
+
+        Task left, right;
+        task_fork(task, &left);
+        task_fork(task, &right);
+        RangeJob job = {&right, items, prefix, mid, end};
+#ifndef SEMANTIC_NO_THREADS
+        pthread_t thread;
+        int spawned = pthread_create(&thread, NULL, range_thread, &job) == 0;
+#else
+        int spawned = 0;
+#endif
+        task_check_range(&left, items, prefix, begin, mid);
+#ifndef SEMANTIC_NO_THREADS
+        if (spawned)
+            pthread_join(thread, NULL);
+#endif
+        if (!spawned)
+            range_thread(&job);
+        atomic_fetch_add(&free_helpers, 1);
+
+        int conflict = tasks_conflict(&left, &right);
+        task_join(task, &left, 0);
+        if (conflict) {
+            task_free(&right);
+            task_check_range(task, items, prefix, mid, end);
+        } else {
+            task_join(task, &right, 1);
+        }
+        return;
+    }
+    for (int i = begin; i < end; i++)
+        task->result = task_check_statement(task, items[i]) & task->result;
+}
+
+static void flatten_program(ASTNode* node, ASTNode*** items, int* count, int* capacity) {
+    for (; node; node = node->next) {
+        if (node->left) {
+            *items = grow(*items, capacity, *count, sizeof(ASTNode*));
+            (*items)[(*count)++] = node->left;
+        }
+        if (node->right)
+            flatten_program(node->right, items, count, capacity);
+    }
+}
+
+// Prints the root task's diagnostics and, if there were none, its symbols
+// in declaration order, as analyze_semantics does. With finalize the
+// declarations take their initialization state from the root's table.
+static int finish_analysis(Task* root, int finalize) {
+    if (root->diag_length)
+        fwrite(root->diags, 1, root->diag_length, stdout);
+    semantic_lookups = root->lookups;
+
+    if (root->result) {
+        if (finalize)
+            psymtab_finalize(&root->table);
+        SymbolTable* table = init_symbol_table();
+        for (int i = 0; i < root->decl_count; i++) {
+            PDecl* decl = root->decls[i];
+            table->current_scope = decl->scope_level;
+            add_symbol(table, decl->name, TOKEN_INT, decl->line_declared);
+            table->head->is_initialized = decl->is_initialized;
+        }
+        table->current_scope = 0;
+        dump_symbol_table(table);
+        free_symbol_table(table);
+    }
+    free_program_symbols();
+
+    int result = root->result;
+    task_free(root);
+    return result;
+}
+
+int analyze_semantics_parallel(ASTNode* ast, int threads) {
+    Task root;
+    memset(&root, 0, sizeof(root));
+    psymtab_init(&root.table);
+    root.result = 1;
+
+#ifdef SEMANTIC_NO_THREADS
+    threads = 1;
+#endif
+    max_helpers = threads > 1 ? threads - 1 : 0;
+    atomic_store(&free_helpers, max_helpers);
+
+    // Build the line index now; tasks only read it.
+    offset_to_line(0);
+
+    ASTNode** items = NULL;
+    int count = 0;
+    int capacity = 0;
+    flatten_program(ast, &items, &count, &capacity);
+    if (count > 0)
+        root.result = task_check_list(&root, items, count);
+    mem_free(items);
+    return finish_analysis(&root, 1);
+}
+
+// --------------------------------------------------------------------------
+// Map-reduce over top-level chunks
+// --------------------------------------------------------------------------
+//
+// The top-level statements are cut into chunks of similar weight, and every
+// chunk is checked on its own from an empty table (map), recording what it
+// assumed about the names it did not declare. Chunks are then applied in
+// order (reduce): a chunk whose assumptions hold contributes its
+// diagnostics, declarations and initializations as they are; any other
+// chunk is checked again, against a persistent table of everything before
+// it. The reduce costs a lookup per name a chunk shares with earlier ones
+// rather than per occurrence, and needs the persistent table only once a
+// chunk is checked again.
+
+typedef struct {
+    ASTNode** items;
+    int begin;
+    int end;
+    Task task;
+    ExternalSet external;
+    int done;               // Guarded by ChunkQueue.lock
+} Chunk;
+
+typedef struct {
+    Chunk* chunks;
+    int count;
+    atomic_int next;        // Next chunk to map
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t mapped;
+#endif
+} ChunkQueue;
+
+// What the reduce knows of one name after the chunks applied so far. The
+// newest declaration's PDecl holds its current initialization state.
+typedef struct {
+    PDecl* latest;          // NULL if never declared
+    unsigned levels;        // Scope levels declared at; bit 31 for 31 and deeper
+    int in_table;           // latest is in the reducer's persistent table
+} ReducedName;
+
+typedef struct {
+    Task root;              // Diagnostics and declarations in order
+    ReducedName* names;     // By interned id
+    int materialized;       // root.decls in root.table
+    int rechecked;
+} Reducer;
+
+static unsigned level_bit(int level) {
+    return 1u << (level < 31 ? level : 31);
+}
+
+static void map_chunk(Chunk* chunk) {
+    TRACE_BEGIN_AT("map_chunk", chunk->items[chunk->begin]->token.offset);
+    Task* task = &chunk->task;
+    memset(task, 0, sizeof(*task));
+    psymtab_init(&task->table);
+    task->result = 1;
+    task->external = &chunk->external;
+    for (int i = chunk->begin; i < chunk->end; i++)
+        task->result = task_check_statement(task, chunk->items[i]) & task->result;
+    psymtab_finalize(&task->table);
+    TRACE_END();
+}
+
+// Maps the next unclaimed chunk; 0 once every chunk is claimed.
+static int map_next(ChunkQueue* queue) {
+    int index = atomic_fetch_add(&queue->next, 1);
+    if (index >= queue->count)
+        return 0;
+    map_chunk(&queue->chunks[index]);
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_lock(&queue->lock);
+    queue->chunks[index].done = 1;
+    pthread_cond_broadcast(&queue->mapped);
+    pthread_mutex_unlock(&queue->lock);
+#else
+    queue->chunks[index].done = 1;
+#endif
+    return 1;
+}
+
+#ifndef SEMANTIC_NO_THREADS
+static void* map_thread(void* arg) {
+    while (map_next(arg))
+        ;
+    return NULL;
+}
+#endif
+
+// Chunks are claimed in order, so one not yet done is either being mapped
+// or next in line.
+static void wait_for_chunk(ChunkQueue* queue, Chunk* chunk) {
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_lock(&queue->lock);
+    while (!chunk->done) {
+        pthread_mutex_unlock(&queue->lock);
+        int mapped = map_next(queue);
+        pthread_mutex_lock(&queue->lock);
+        if (!mapped && !chunk->done)
+            pthread_cond_wait(&queue->mapped, &queue->lock);
+    }
+    pthread_mutex_unlock(&queue->lock);
+#else
+    while (!chunk->done && map_next(queue))
+        ;
+#endif
+}
+
+static int assumptions_hold(const Reducer* reducer, const ExternalSet* external) {
+    for (int i = 0; i < external->capacity; i++) {
+        if (external->ids[i] < 0)
+            continue;
+        const PDecl* latest = reducer->names[external->ids[i]].latest;
+        if (!latest || ((external->flags[i] & EXTERNAL_INITIALIZED) && !latest->is_initialized))
+            return 0;
+    }
+    for (int i = 0; i < external->absent_count; i++) {
+        const Absence* absence = &external->absent[i];
+        if (reducer->names[absence->name_id].levels & level_bit(absence->level))
+            return 0;
+    }
+    return 1;
+}
+
+// Initializations of earlier declarations first, then the chunk's own
+// declarations in order, each already in the state it ended the chunk in.
+static void reduce_chunk(Reducer* reducer, Chunk* chunk) {
+    Task* root = &reducer->root;
+    ExternalSet* external = &chunk->external;
+    for (int i = 0; i < external->capacity; i++) {
+        if (external->ids[i] < 0 || !(external->flags[i] & EXTERNAL_ASSIGNED))
+            continue;
+        ReducedName* name = &reducer->names[external->ids[i]];
+        name->latest->is_initialized = 1;
+        if (name->in_table)
+            psymtab_mark_initialized(&root->arena, &root->table, name->latest->name);
+    }
+    for (int i = 0; i < chunk->task.decl_count; i++) {
+        PDecl* decl = chunk->task.decls[i];
+        ReducedName* name = &reducer->names[decl->name_id];
+        name->latest = decl;
+        name->levels |= level_bit(decl->scope_level);
+        name->in_table = 0;
+    }
+    task_append(root, &chunk->task);
+}
+
+// Checks the chunk's statements against everything before them, bringing
+// the persistent table up to date first.
+static void recheck_chunk(Reducer* reducer, Chunk* chunk) {
+    Task* root = &reducer->root;
+    for (; reducer->materialized < root->decl_count; reducer->materialized++) {
+        PDecl* decl = root->decls[reducer->materialized];
+        root->table.scope_level = decl->scope_level;
+        psymtab_declare(&root->arena, &root->table, decl);
+        if (decl->is_initialized)
+            psymtab_mark_initialized(&root->arena, &root->table, decl->name);
+        if (reducer->names[decl->name_id].latest == decl)
+            reducer->names[decl->name_id].in_table = 1;
+    }
+    root->table.scope_level = 0;
+
+    nameset_free(&root->reads);
+    nameset_free(&root->writes);
+    for (int i = chunk->begin; i < chunk->end; i++)
+        root->result = task_check_statement(root, chunk->items[i]) & root->result;
+    reducer->materialized = root->decl_count;
+
+    // Names the check declared or initialized take their state from the table
+    for (int i = 0; i < root->writes.capacity; i++) {
+        const char* text = root->writes.names[i];
+        const PBinding* binding = text ? psymtab_lookup(&root->table, text) : NULL;
+        if (!binding)
+            continue;
+        ReducedName* name = &reducer->names[binding->decl->name_id];
+        name->latest = binding->decl;
+        name->in_table = 1;
+        name->levels = 0;
+        for (const PBinding* b = binding; b; b = b->next) {
+            b->decl->is_initialized = b->is_initialized;
+            name->levels |= level_bit(b->scope_level);
+        }
+    }
+    reducer->rechecked++;
+}
+
+int analyze_semantics_map_reduce(ASTNode* ast, int threads) {
+    Reducer reducer;
+    memset(&reducer, 0, sizeof(reducer));
+    psymtab_init(&reducer.root.table);
+    reducer.root.result = 1;
+    reducer.names = mem_calloc(MEM_PARALLEL, intern_count() + 1, sizeof(ReducedName));
+    if (!reducer.names) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+
+#ifdef SEMANTIC_NO_THREADS
+    threads = 1;
+#endif
+    if (threads < 1)
+        threads = 1;
+    // Nested blocks stay inside their chunk's task
+    max_helpers = 0;
+    atomic_store(&free_helpers, 0);
+    offset_to_line(0);
+
+    ASTNode** items = NULL;
+    int count = 0;
+    int capacity = 0;
+    flatten_program(ast, &items, &count, &capacity);
+    long* prefix = mem_alloc(MEM_PARALLEL, (count + 1) * sizeof(long));
+    if (!prefix) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    prefix[0] = 0;
+    for (int i = 0; i < count; i++)
+        prefix[i + 1] = prefix[i] + 1 + tree_weight(items[i]->left) + tree_weight(items[i]->right);
+
+    // Several chunks per thread, so a chunk checked again costs little and a
+    // slow chunk holds nobody up, but none lighter than the grain.
+    long chunk_count = (long)threads * 8;
+    if (chunk_count > prefix[count] / PARALLEL_GRAIN)
+        chunk_count = prefix[count] / PARALLEL_GRAIN;
+    if (chunk_count > count)
+        chunk_count = count;
+    if (chunk_count < 1)
+        chunk_count = 1;
+    ChunkQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.chunks = mem_calloc(MEM_PARALLEL, chunk_count, sizeof(Chunk));
+    if (!queue.chunks) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    int begin = 0;
+    for (long c = 0; c < chunk_count && begin < count; c++) {
+        long target = prefix[count] * (c + 1) / chunk_count;
+        int end = begin + 1;
+        while (end < count && prefix[end] < target)
+            end++;
+        if (c == chunk_count - 1)
+            end = count;
+        queue.chunks[queue.count++] = (Chunk){.items = items, .begin = begin, .end = end};
+        begin = end;
+    }
+
+    int workers = 0;
+#ifndef SEMANTIC_NO_THREADS
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.mapped, NULL);
+    pthread_t* thread_ids = mem_alloc(MEM_PARALLEL, threads * sizeof(pthread_t));
+    if (!thread_ids) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    // The calling thread maps too while it waits to reduce
+    while (workers < threads - 1 && workers < queue.count - 1 &&
+           pthread_create(&thread_ids[workers], NULL, map_thread, &queue) == 0)
+        workers++;
+#endif
+
+    for (int c = 0; c < queue.count; c++) {
+        Chunk* chunk = &queue.chunks[c];
+        wait_for_chunk(&queue, chunk);
+        TRACE_BEGIN_AT("reduce_chunk", items[chunk->begin]->token.offset);
+        if (assumptions_hold(&reducer, &chunk->external)) {
+            reduce_chunk(&reducer, chunk);
+        } else {
+            task_free(&chunk->task);
+            recheck_chunk(&reducer, chunk);
+        }
+        external_free(&chunk->external);
+        TRACE_END();
+    }
+
+#ifndef SEMANTIC_NO_THREADS
+    for (int i = 0; i < workers; i++)
+        pthread_join(thread_ids[i], NULL);
+    mem_free(thread_ids);
+    pthread_mutex_destroy(&queue.lock);
+    pthread_cond_destroy(&queue.mapped);
+#endif
+    fprintf(stderr, "Map-reduce: %d chunks on %d threads, %d checked again in order\n",
+            queue.count, workers + 1, reducer.rechecked);
+    mem_free(queue.chunks);
+    mem_free(prefix);
+    mem_free(items);
+    mem_free(reducer.names);
+    return finish_analysis(&reducer.root, 0);
+}
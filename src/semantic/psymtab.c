@@ -0,0 +1,264 @@
+/* psymtab.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/psymtab.h"
+#include "../../include/alloc.h"
+
+#define PARENA_CHUNK_SIZE (64 * 1024)
+#define PARENA_ALIGN 16
+
+struct PArenaChunk {
+    struct PArenaChunk* next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+typedef struct {
+    const PNode* node;       // Exactly one of node/entry is set
+    const PEntry* entry;
+} PSlot;
+
+struct PNode {
+    unsigned bitmap;         // Which of the 32 hash fragments are present
+    PSlot slots[];           // popcount(bitmap) slots, in fragment order
+};
+
+// --------------------------------------------------------------------------
+// Arena
+// --------------------------------------------------------------------------
+
+void* parena_alloc(PArena* arena, size_t size) {
+    size = (size + PARENA_ALIGN - 1) & ~(size_t)(PARENA_ALIGN - 1);
+    PArenaChunk* chunk = arena->head;
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > PARENA_CHUNK_SIZE ? size : PARENA_CHUNK_SIZE;
+        chunk = mem_alloc(MEM_PARALLEL, sizeof(PArenaChunk) + chunk_size);
+        if (!chunk) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+    void* result = chunk->data + chunk->used;
+    chunk->used += size;
+    return result;
+}
+
+void parena_adopt(PArena* arena, PArena* other) {
+    if (!other->head)
+        return;
+    // Keep arena's current chunk in front so its free space is still used.
+    PArenaChunk* last = other->head;
+    while (last->next)
+        last = last->next;
+    if (arena->head) {
+        last->next = arena->head->next;
+        arena->head->next = other->head;
+    } else {
+        arena->head = other->head;
+    }
+    other->head = NULL;
+}
+
+void parena_free(PArena* arena) {
+    PArenaChunk* chunk = arena->head;
+    while (chunk) {
+        PArenaChunk* next = chunk->next;
+        mem_free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+}
+
+// --------------------------------------------------------------------------
+// Hash array mapped trie
+// --------------------------------------------------------------------------
+
+unsigned psymtab_hash(const char* name) {
+    unsigned hash = 2166136261u;   // FNV-1a
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static PNode* new_node(PArena* arena, int count) {
+    return parena_alloc(arena, sizeof(PNode) + count * sizeof(PSlot));
+}
+
+static const PEntry* find_entry(const PNode* node, const char* name, unsigned hash) {
+    int shift = 0;
+    while (node) {
+        unsigned bit = 1u << ((hash >> shift) & 31);
+        if (!(node->bitmap & bit))
+            return NULL;
+        const PSlot* slot = &node->slots[__builtin_popcount(node->bitmap & (bit - 1))];
+        if (slot->entry) {
+            for (const PEntry* e = slot->entry; e; e = e->collision) {
+                if (e->hash == hash && strcmp(e->name, name) == 0)
+                    return e;
+            }
+            return NULL;
+        }
+        node = slot->node;
+        shift += 5;
+    }
+    return NULL;
+}
+
+// Copy of a collision chain with value's name replaced (or added).
+static const PEntry* chain_put(PArena* arena, const PEntry* chain, const PEntry* value) {
+    PEntry* head = parena_alloc(arena, sizeof(PEntry));
+    *head = *value;
+    head->collision = NULL;
+    PEntry* tail = head;
+    for (const PEntry* e = chain; e; e = e->collision) {
+        if (strcmp(e->name, value->name) == 0)
+            continue;
+        PEntry* copy = parena_alloc(arena, sizeof(PEntry));
+        *copy = *e;
+        copy->collision = NULL;
+        tail->collision = copy;
+        tail = copy;
+    }
+    return head;
+}
+
+static const PNode* node_put(PArena* arena, const PNode* node, int shift, const PEntry* value) {
+    unsigned bit = 1u << ((value->hash >> shift) & 31);
+    if (!node) {
+        PNode* fresh = new_node(arena, 1);
+        fresh->bitmap = bit;
+        fresh->slots[0].node = NULL;
+        fresh->slots[0].entry = chain_put(arena, NULL, value);
+        return fresh;
+    }
+
+    int count = __builtin_popcount(node->bitmap);
+    int index = __builtin_popcount(node->bitmap & (bit - 1));
+    if (!(node->bitmap & bit)) {
+        PNode* grown = new_node(arena, count + 1);
+        grown->bitmap = node->bitmap | bit;
+        memcpy(grown->slots, node->slots, index * sizeof(PSlot));
+        grown->slots[index].node = NULL;
+        grown->slots[index].entry = chain_put(arena, NULL, value);
+        memcpy(grown->slots + index + 1, node->slots + index, (count - index) * sizeof(PSlot));
+        return grown;
+    }
+
+    PSlot replacement = {NULL, NULL};
+    const PSlot* slot = &node->slots[index];
+    if (slot->node) {
+        replacement.node = node_put(arena, slot->node, shift + 5, value);
+    } else if (slot->entry->hash == value->hash) {
+        replacement.entry = chain_put(arena, slot->entry, value);
+    } else {
+        // Two different hashes share this fragment: push the old chain down.
+        PNode* pushed = new_node(arena, 1);
+        pushed->bitmap = 1u << ((slot->entry->hash >> (shift + 5)) & 31);
+        pushed->slots[0] = *slot;
+        replacement.node = node_put(arena, pushed, shift + 5, value);
+    }
+
+    PNode* copy = new_node(arena, count);
+    copy->bitmap = node->bitmap;
+    memcpy(copy->slots, node->slots, count * sizeof(PSlot));
+    copy->slots[index] = replacement;
+    return copy;
+}
+
+static void node_finalize(const PNode* node) {
+    int count = __builtin_popcount(node->bitmap);
+    for (int i = 0; i < count; i++) {
+        if (node->slots[i].node) {
+            node_finalize(node->slots[i].node);
+            continue;
+        }
+        for (const PEntry* e = node->slots[i].entry; e; e = e->collision) {
+            for (const PBinding* b = e->bindings; b; b = b->next)
+                b->decl->is_initialized = b->is_initialized;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// Symbol table operations
+// --------------------------------------------------------------------------
+
+void psymtab_init(PSymTab* table) {
+    table->root = NULL;
+    table->scope_level = 0;
+    table->reported_count = 0;
+}
+
+const PEntry* psymtab_entry(const PSymTab* table, const char* name) {
+    return find_entry(table->root, name, psymtab_hash(name));
+}
+
+const PBinding* psymtab_lookup(const PSymTab* table, const char* name) {
+    const PEntry* entry = psymtab_entry(table, name);
+    return entry ? entry->bindings : NULL;
+}
+
+const PBinding* psymtab_lookup_current_scope(const PSymTab* table, const char* name) {
+    for (const PBinding* b = psymtab_lookup(table, name); b; b = b->next) {
+        if (b->scope_level == table->scope_level)
+            return b;
+    }
+    return NULL;
+}
+
+static PEntry entry_for_update(const PSymTab* table, const char* name) {
+    unsigned hash = psymtab_hash(name);
+    const PEntry* existing = find_entry(table->root, name, hash);
+    PEntry value = {name, hash, 0, NULL, NULL};
+    if (existing)
+        value = *existing;
+    return value;
+}
+
+void psymtab_declare(PArena* arena, PSymTab* table, PDecl* decl) {
+    PEntry value = entry_for_update(table, decl->name);
+    PBinding* binding = parena_alloc(arena, sizeof(PBinding));
+    binding->decl = decl;
+    binding->scope_level = table->scope_level;
+    binding->is_initialized = 0;
+    binding->next = value.bindings;
+    value.bindings = binding;
+    table->root = node_put(arena, table->root, 0, &value);
+}
+
+void psymtab_mark_initialized(PArena* arena, PSymTab* table, const char* name) {
+    PEntry value = entry_for_update(table, name);
+    if (!value.bindings || value.bindings->is_initialized)
+        return;
+    PBinding* binding = parena_alloc(arena, sizeof(PBinding));
+    *binding = *value.bindings;
+    binding->is_initialized = 1;
+    value.bindings = binding;
+    table->root = node_put(arena, table->root, 0, &value);
+}
+
+void psymtab_set_reported(PArena* arena, PSymTab* table, const char* name) {
+    PEntry value = entry_for_update(table, name);
+    if (value.reported)
+        return;
+    value.reported = 1;
+    table->root = node_put(arena, table->root, 0, &value);
+    table->reported_count++;
+}
+
+void psymtab_put_entry(PArena* arena, PSymTab* table, const PEntry* entry) {
+    table->root = node_put(arena, table->root, 0, entry);
+}
+
+void psymtab_finalize(const PSymTab* table) {
+    if (table->root)
+        node_finalize(table->root);
+}
@@ -0,0 +1,210 @@
+/* query.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/query.h"
+#include "../../include/lexer.h"
+#include "../../include/intern.h"
+#include "../../include/alloc.h"
+
+struct QueryEngine {
+    ASTNode** statements;    // Top-level statements in source order
+    int statement_count;
+    int checked;             // Frontier: statements [0, checked) are done
+    SymbolTable* table;
+
+    int* previous_same_name; // Per symbol: the earlier symbol of its name, or -1
+    int linked;              // Symbols entered in the two name maps so far
+    int symbol_capacity;
+    int* latest_by_name;     // Per interned name: its latest symbol, or -1
+    int* seen;               // Per interned name: stamp of the last query_visible
+    int name_capacity;
+    int stamp;
+
+    QueryDiagnostic* diagnostics;
+    int diagnostic_count;
+    int diagnostic_capacity;
+};
+
+static void out_of_memory(void) {
+    perror("Memory allocation error");
+    exit(1);
+}
+
+static void* grow(void* data, int* capacity, int needed, size_t element_size) {
+    if (needed <= *capacity)
+        return data;
+    int new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+    void* grown = mem_realloc(MEM_SYMBOLS, data, new_capacity * element_size);
+    if (!grown)
+        out_of_memory();
+    *capacity = new_capacity;
+    return grown;
+}
+
+QueryEngine* query_open(ASTNode* ast) {
+    QueryEngine* engine = mem_calloc(MEM_SYMBOLS, 1, sizeof(QueryEngine));
+    if (!engine)
+        return NULL;
+    int capacity = 0;
+    for (ASTNode* program = ast; program; program = program->next) {
+        if (!program->left)
+            continue;
+        engine->statements = grow(engine->statements, &capacity, engine->statement_count + 1, sizeof(ASTNode*));
+        engine->statements[engine->statement_count++] = program->left;
+    }
+    engine->table = init_symbol_table();
+    if (!engine->table)
+        out_of_memory();
+    reset_semantic_errors();
+    return engine;
+}
+
+void query_close(QueryEngine* engine) {
+    if (!engine)
+        return;
+    free_symbol_table(engine->table);
+    mem_free(engine->statements);
+    mem_free(engine->previous_same_name);
+    mem_free(engine->latest_by_name);
+    mem_free(engine->seen);
+    mem_free(engine->diagnostics);
+    mem_free(engine);
+}
+
+// --------------------------------------------------------------------------
+// Frontier
+// --------------------------------------------------------------------------
+
+static void keep_diagnostic(void* context, SemanticErrorType error, const char* name, int line) {
+    QueryEngine* engine = context;
+    engine->diagnostics = grow(engine->diagnostics, &engine->diagnostic_capacity,
+                               engine->diagnostic_count + 1, sizeof(QueryDiagnostic));
+    QueryDiagnostic* diagnostic = &engine->diagnostics[engine->diagnostic_count++];
+    diagnostic->line = line;
+    format_semantic_error(diagnostic->message, sizeof(diagnostic->message), error, name, line);
+}
+
+// Enter symbols declared since the last call into the per-name maps.
+static void link_new_symbols(QueryEngine* engine) {
+    const ProgramSymbols* program = &engine->table->program;
+    if (program->symbol_count == engine->linked)
+        return;
+    engine->previous_same_name = grow(engine->previous_same_name, &engine->symbol_capacity,
+                                      program->symbol_count, sizeof(int));
+    int names = 0;
+    for (int id = engine->linked; id < program->symbol_count; id++)
+        if (program->symbols[id].name_id >= names)
+            names = program->symbols[id].name_id + 1;
+    if (names > engine->name_capacity) {
+        int old_capacity = engine->name_capacity;
+        int seen_capacity = old_capacity;
+        engine->latest_by_name = grow(engine->latest_by_name, &engine->name_capacity, names, sizeof(int));
+        engine->seen = grow(engine->seen, &seen_capacity, names, sizeof(int));
+        for (int i = old_capacity; i < engine->name_capacity; i++) {
+            engine->latest_by_name[i] = -1;
+            engine->seen[i] = 0;
+        }
+    }
+    for (int id = engine->linked; id < program->symbol_count; id++) {
+        int name = program->symbols[id].name_id;
+        engine->previous_same_name[id] = engine->latest_by_name[name];
+        engine->latest_by_name[name] = id;
+    }
+    engine->linked = program->symbol_count;
+}
+
+// Check every top-level statement that starts at or before offset.
+static void advance_to(QueryEngine* engine, int offset) {
+    if (engine->checked == engine->statement_count ||
+        engine->statements[engine->checked]->token.offset > offset)
+        return;
+    set_diagnostic_sink(keep_diagnostic, engine);
+    while (engine->checked < engine->statement_count &&
+           engine->statements[engine->checked]->token.offset <= offset)
+        check_statement(engine->statements[engine->checked++], engine->table);
+    set_diagnostic_sink(NULL, NULL);
+    link_new_symbols(engine);
+}
+
+// --------------------------------------------------------------------------
+// Queries
+// --------------------------------------------------------------------------
+
+const ResolvedSymbol* query_symbol(const QueryEngine* engine, int id) {
+    return &engine->table->program.symbols[id];
+}
+
+// Symbols are declared in source order, so those visible at offset are a
+// prefix of the id range.
+static int declared_before(const QueryEngine* engine, int offset) {
+    const ResolvedSymbol* symbols = engine->table->program.symbols;
+    int lo = 0;
+    int hi = engine->table->program.symbol_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (symbols[mid].declared_at <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+int query_visible(QueryEngine* engine, int offset, int* ids, int max) {
+    advance_to(engine, offset);
+    const ResolvedSymbol* symbols = engine->table->program.symbols;
+    int stamp = ++engine->stamp;
+    int count = 0;
+    for (int id = declared_before(engine, offset) - 1; id >= 0; id--) {
+        int name = symbols[id].name_id;
+        if (engine->seen[name] == stamp)
+            continue;   // Shadowed by a later declaration
+        engine->seen[name] = stamp;
+        if (count < max)
+            ids[count] = id;
+        count++;
+    }
+    return count;
+}
+
+int query_initialized(QueryEngine* engine, const char* name, int offset) {
+    advance_to(engine, offset);
+    int name_id = intern_lookup(name);
+    if (name_id < 0 || name_id >= engine->name_capacity)
+        return -1;
+    const ResolvedSymbol* symbols = engine->table->program.symbols;
+    int id = engine->latest_by_name[name_id];
+    while (id >= 0 && symbols[id].declared_at > offset)
+        id = engine->previous_same_name[id];
+    if (id < 0)
+        return -1;
+    return symbols[id].initialized_at >= 0 && symbols[id].initialized_at < offset;
+}
+
+int query_diagnostics(QueryEngine* engine, int first_line, int last_line,
+                      const QueryDiagnostic** first) {
+    advance_to(engine, line_to_offset(last_line + 1, 1) - 1);
+    int lo = 0;
+    int hi = engine->diagnostic_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (engine->diagnostics[mid].line < first_line)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int end = lo;
+    while (end < engine->diagnostic_count && engine->diagnostics[end].line <= last_line)
+        end++;
+    *first = engine->diagnostics + lo;
+    return end - lo;
+}
+
+int query_checked(const QueryEngine* engine, int* total) {
+    if (total)
+        *total = engine->statement_count;
+    return engine->checked;
+}
@@ -2,11 +2,28 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#ifdef __unix__
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
 #include "../../include/semantic.h"
 #include "../../include/parser.h"
 #include "../../include/lexer.h"
-
-#define MAX_REPORTED_ERRORS 100
+#include "../../include/export.h"
+#include "../../include/alloc.h"
+#include "../../include/dag.h"
+#include "../../include/xref.h"
+#include "../../include/trace.h"
+#include "../../include/intern.h"
+#include "../../include/query.h"
+#include "../../include/analyzer.h"
+#include "../../include/ingest.h"
+#include "../../include/watch.h"
+#include "../../include/ir.h"
+#include "../../include/perfcount.h"
 
 static char reportedErrors[MAX_REPORTED_ERRORS][100];
 static int reportedErrorCount = 0;
@@ -28,27 +45,82 @@ void addReportedError(const char* name) {
     }
 }
 
+void reset_semantic_errors(void) {
+    reportedErrorCount = 0;
+}
+
+
+static ProgramSymbols published = {0};
+
+static int open_scope_range(ProgramSymbols* program, int parent, int level) {
+    if (program->scope_count == program->scope_capacity) {
+        int capacity = program->scope_capacity ? program->scope_capacity * 2 : 16;
+        ScopeRange* grown = mem_realloc(MEM_SYMBOLS, program->scopes, capacity * sizeof(ScopeRange));
+        if (!grown)
+            return -1;
+        program->scopes = grown;
+        program->scope_capacity = capacity;
+    }
+    ScopeRange* range = &program->scopes[program->scope_count];
+    range->parent = parent;
+    range->level = level;
+    range->first_symbol = program->symbol_count;
+    range->end_symbol = program->symbol_count;
+    range->frame_size = 0;
+    return program->scope_count++;
+}
 
 SymbolTable* init_symbol_table() {
-    SymbolTable* table = malloc(sizeof(SymbolTable));
+    SymbolTable* table = mem_alloc(MEM_SYMBOLS, sizeof(SymbolTable));
     if (table) {
         table->head = NULL;
         table->current_scope = 0;
+        memset(&table->program, 0, sizeof(table->program));
+        table->refs = NULL;
+        table->ref_count = table->ref_capacity = 0;
+        table->pending_ref = -1;
+        table->lookups = 0;
+        table->current_scope_id = open_scope_range(&table->program, -1, 0);
     }
     return table;
 }
 
 void add_symbol(SymbolTable* table, const char* name, int type, int line) {
-    Symbol* symbol = malloc(sizeof(Symbol));
+    ProgramSymbols* program = &table->program;
+    if (program->symbol_count == program->symbol_capacity) {
+        int capacity = program->symbol_capacity ? program->symbol_capacity * 2 : 64;
+        ResolvedSymbol* grown = mem_realloc(MEM_SYMBOLS, program->symbols, capacity * sizeof(ResolvedSymbol));
+        if (!grown)
+            return;
+        program->symbols = grown;
+        program->symbol_capacity = capacity;
+    }
+    int name_id = intern_name(name);
+    if (name_id < 0)
+        return;
+    Symbol* symbol = mem_alloc(MEM_SYMBOLS, sizeof(Symbol));
     if (symbol) {
-        strncpy(symbol->name, name, sizeof(symbol->name) - 1);
-        symbol->name[sizeof(symbol->name) - 1] = '\0';
+        symbol->name = intern_string(name_id);
+        symbol->name_id = name_id;
         symbol->type = type;
         symbol->scope_level = table->current_scope;
         symbol->line_declared = line;
         symbol->is_initialized = 0;
+        symbol->id = program->symbol_count++;
         symbol->next = table->head;
         table->head = symbol;
+
+        ResolvedSymbol* resolved = &program->symbols[symbol->id];
+        resolved->name = symbol->name;
+        resolved->name_id = name_id;
+        resolved->type = type;
+        resolved->scope = table->current_scope_id;
+        resolved->scope_level = table->current_scope;
+        resolved->slot = program->scopes[table->current_scope_id].frame_size++;
+        resolved->line_declared = line;
+        resolved->is_initialized = 0;
+        resolved->declared_at = -1;
+        resolved->initialized_at = -1;
     }
 }
 
@@ -73,8 +145,24 @@ Symbol* lookup_symbol_current_scope(SymbolTable* table, const char* name) {
     return NULL;
 }
 
+long semantic_lookups = 0;
+
+// The checker's lookups: a token carries its interned name id, so no
+// string compares.
+static Symbol* lookup_token(SymbolTable* table, const Token* name, int current_scope_only) {
+    int name_id = (int)name->value;
+    for (Symbol* current = table->head; current; current = current->next)
+        if (current->name_id == name_id &&
+            (!current_scope_only || current->scope_level == table->current_scope))
+            return current;
+    return NULL;
+}
+
 void enter_scope(SymbolTable* table) {
     table->current_scope++;
+    int id = open_scope_range(&table->program, table->current_scope_id, table->current_scope);
+    if (id >= 0)
+        table->current_scope_id = id;
 }
 
 void remove_symbols_in_current_scope(SymbolTable* table) {
@@ -84,11 +172,11 @@ void remove_symbols_in_current_scope(SymbolTable* table) {
         if (current->scope_level == table->current_scope) {
             if (prev == NULL) {
                 table->head = current->next;
-                free(current);
+                mem_free(current);
                 current = table->head;
             } else {
                 prev->next = current->next;
-                free(current);
+                mem_free(current);
                 current = prev->next;
             }
         } else {
@@ -99,8 +187,12 @@ void remove_symbols_in_current_scope(SymbolTable* table) {
 }
 
 void exit_scope(SymbolTable* table) {
-    if (table->current_scope > 0)
+    if (table->current_scope > 0) {
+        ScopeRange* range = &table->program.scopes[table->current_scope_id];
+        range->end_symbol = table->program.symbol_count;
+        table->current_scope_id = range->parent;
         table->current_scope--;
+    }
 }
 
 void free_symbol_table(SymbolTable* table) {
@@ -108,9 +200,37 @@ void free_symbol_table(SymbolTable* table) {
     while (current) {
         Symbol* temp = current;
         current = current->next;
-        free(temp);
+        mem_free(temp);
+    }
+    mem_free(table->program.symbols);
+    mem_free(table->program.scopes);
+    mem_free(table->refs);
+    mem_free(table);
+}
+
+// Hand the table's dense arrays over to get_program_symbols(), with the
+// final initialization state of every symbol, and index its occurrences.
+static void publish_program_symbols(SymbolTable* table, int keep_nodes) {
+    ProgramSymbols* program = &table->program;
+    for (Symbol* sym = table->head; sym != NULL; sym = sym->next) {
+        program->symbols[sym->id].is_initialized = sym->is_initialized;
     }
-    free(table);
+    program->scopes[0].end_symbol = program->symbol_count;
+    free_program_symbols();
+    publish_cross_reference(table->refs, table->ref_count, program->symbol_count, keep_nodes);
+    published = *program;
+    memset(program, 0, sizeof(*program));
+}
+
+const ProgramSymbols* get_program_symbols(void) {
+    return &published;
+}
+
+void free_program_symbols(void) {
+    mem_free(published.symbols);
+    mem_free(published.scopes);
+    memset(&published, 0, sizeof(published));
+    free_cross_reference();
 }
 
 void print_symbol_table(SymbolTable* table) {
@@ -127,79 +247,230 @@ void print_symbol_table(SymbolTable* table) {
     }
 }
 
+static int dump_enabled = 1;
+
+void set_symbol_table_dump(int enabled) {
+    dump_enabled = enabled;
+}
+
 void dump_symbol_table(SymbolTable *table) {
-    int count = 0;
-    for (Symbol *sym = table->head; sym != NULL; sym = sym->next) {
-        count++;
-    }
-    Symbol **symbols = malloc(count * sizeof(Symbol *));
-    int index = 0;
+    // The dense array is already in declaration order; only the
+    // initialization flags live on the linked list.
+    ProgramSymbols *program = &table->program;
     for (Symbol *sym = table->head; sym != NULL; sym = sym->next) {
-        symbols[index++] = sym;
+        program->symbols[sym->id].is_initialized = sym->is_initialized;
     }
-    
+    if (!dump_enabled)
+        return;
+    TRACE_BEGIN("dump_symbol_table");
+    PERF_BEGIN(PERF_DUMP);
+    PERF_UNITS(PERF_DUMP, program->symbol_count);
+
     printf("== SYMBOL TABLE DUMP ==\n");
-    printf("Total symbols: %d\n\n", count);
-    
-    for (int i = count - 1; i >= 0; i--) {
-        int printedIndex = count - 1 - i;
-        printf("Symbol[%d]:\n", printedIndex);
-        printf("  Name: %s\n", symbols[i]->name);
-        printf("  Type: %s\n", (symbols[i]->type == TOKEN_INT ? "int" : "unknown"));
-        printf("  Scope Level: %d\n", symbols[i]->scope_level);
-        printf("  Line Declared: %d\n", symbols[i]->line_declared);
-        printf("  Initialized: %s\n\n", (symbols[i]->is_initialized ? "Yes" : "No"));
+    printf("Total symbols: %d\n\n", program->symbol_count);
+
+    for (int i = 0; i < program->symbol_count; i++) {
+        const ResolvedSymbol *sym = &program->symbols[i];
+        printf("Symbol[%d]:\n", i);
+        printf("  Name: %s\n", sym->name);
+        printf("  Type: %s\n", (sym->type == TOKEN_INT ? "int" : "unknown"));
+        printf("  Scope Level: %d\n", sym->scope_level);
+        printf("  Line Declared: %d\n", sym->line_declared);
+        printf("  Initialized: %s\n\n", (sym->is_initialized ? "Yes" : "No"));
     }
     printf("===================\n");
-    free(symbols);
+    PERF_END();
+    TRACE_END();
 }
 
 
 
-void semantic_error(SemanticErrorType error, const char* name, int line) {
-    printf("Semantic Error at line %d: ", line);
+static const char* semantic_error_format(SemanticErrorType error) {
     switch (error) {
         case SEM_ERROR_UNDECLARED_VARIABLE:
-            printf("Undeclared variable '%s'\n", name);
-            break;
+            return "Undeclared variable '%s'\n";
         case SEM_ERROR_REDECLARED_VARIABLE:
-            printf("Variable '%s' already declared in this scope\n", name);
-            break;
+            return "Variable '%s' already declared in this scope\n";
         case SEM_ERROR_TYPE_MISMATCH:
-            printf("Type mismatch involving '%s'\n", name);
-            break;
+            return "Type mismatch involving '%s'\n";
         case SEM_ERROR_UNINITIALIZED_VARIABLE:
-            printf("Variable '%s' used without initialization\n", name);
-            break;
+            return "Variable '%s' used without initialization\n";
         case SEM_ERROR_INVALID_OPERATION:
-            printf("Invalid operation involving '%s'\n", name);
-            break;
+            return "Invalid operation involving '%s'\n";
         default:
-            printf("Generic semantic error with '%s'\n", name);
-            break;
+            return "Generic semantic error with '%s'\n";
     }
 }
 
-// Forward declaration for statement checking helper.
-static int check_statement(ASTNode* node, SymbolTable* table);
+int format_semantic_error(char* buffer, size_t size, SemanticErrorType error, const char* name, int line) {
+    int prefix = snprintf(buffer, size, "Semantic Error at line %d: ", line);
+    if (prefix < 0)
+        return prefix;
+    size_t used = (size_t)prefix < size ? (size_t)prefix : size;
+    int message = snprintf(buffer + used, size - used, semantic_error_format(error), name);
+    return message < 0 ? message : prefix + message;
+}
+
+static DiagnosticSink diagnostic_sink = NULL;
+static void* diagnostic_context = NULL;
+
+void set_diagnostic_sink(DiagnosticSink sink, void* context) {
+    diagnostic_sink = sink;
+    diagnostic_context = context;
+}
+
+void semantic_error(SemanticErrorType error, const char* name, int line) {
+    if (diagnostic_sink) {
+        diagnostic_sink(diagnostic_context, error, name, line);
+        return;
+    }
+    printf("Semantic Error at line %d: ", line);
+    printf(semantic_error_format(error), name);
+}
+
+// --------------------------------------------------------------------------
+// Leaf checks shared by the tree walker below and the fused parser
+// --------------------------------------------------------------------------
+
+// Append an occurrence of symbol; resolve_node fills in the node later.
+static void record_reference(SymbolTable* table, const Symbol* symbol, XrefKind kind, int offset) {
+    table->pending_ref = -1;
+    if (!symbol || !xref_enabled())
+        return;
+    if (table->ref_count == table->ref_capacity) {
+        int capacity = table->ref_capacity ? table->ref_capacity * 2 : 256;
+        XrefRecord* grown = mem_realloc(MEM_SYMBOLS, table->refs, capacity * sizeof(XrefRecord));
+        if (!grown)
+            return;
+        table->refs = grown;
+        table->ref_capacity = capacity;
+    }
+    XrefRecord* record = &table->refs[table->ref_count];
+    record->symbol = symbol->id;
+    record->kind = kind;
+    record->offset = offset;
+    record->node = NULL;
+    table->pending_ref = table->ref_count++;
+}
+
+int check_declared_name(const Token* name, SymbolTable* table) {
+    const char* text = token_name(name);
+    table->lookups++;
+    Symbol* existing = lookup_token(table, name, 1);
+    if (existing) {
+        semantic_error(SEM_ERROR_REDECLARED_VARIABLE, text, token_line(*name));
+        return 0;
+    }
+    add_symbol(table, text, TOKEN_INT, token_line(*name));
+    table->program.symbols[table->head->id].declared_at = name->offset;
+    dag_invalidate_name(name);
+    record_reference(table, table->head, XREF_DECL, name->offset);
+    return 1;
+}
+
+int check_assigned_name(const Token* name, SymbolTable* table, Symbol** resolved) {
+    const char* text = token_name(name);
+    table->lookups++;
+    Symbol* symbol = lookup_token(table, name, 0);
+    if (resolved)
+        *resolved = symbol;
+    if (!symbol) {
+        if (!errorAlreadyReported(text)) {
+            semantic_error(SEM_ERROR_UNDECLARED_VARIABLE, text, token_line(*name));
+            addReportedError(text);
+        }
+        table->pending_ref = -1;
+        return 0;
+    }
+    mark_initialized(table, symbol, name->offset);
+    record_reference(table, symbol, XREF_DEF, name->offset);
+    return 1;
+}
+
+int check_identifier_use(const Token* name, SymbolTable* table, Symbol** resolved) {
+    const char* text = token_name(name);
+    table->lookups++;
+    Symbol* symbol = lookup_token(table, name, 0);
+    if (resolved)
+        *resolved = symbol;
+    if (!symbol) {
+        if (!errorAlreadyReported(text)) {
+            semantic_error(SEM_ERROR_UNDECLARED_VARIABLE, text, token_line(*name));
+            addReportedError(text);
+        }
+        table->pending_ref = -1;
+        return 0;
+    }
+    record_reference(table, symbol, XREF_USE, name->offset);
+    if (!symbol->is_initialized) {
+        semantic_error(SEM_ERROR_UNINITIALIZED_VARIABLE, text, token_line(*name));
+        return 0;
+    }
+    return 1;
+}
+
+int check_callee_name(const Token* callee, const Token* call) {
+    const char* text = token_name(callee);
+    if (strcmp(text, "factorial") != 0) {
+        semantic_error(SEM_ERROR_INVALID_OPERATION, text, token_line(*call));
+        return 0;
+    }
+    return 1;
+}
+
+void mark_initialized(SymbolTable* table, Symbol* symbol, int offset) {
+    symbol->is_initialized = 1;
+    ResolvedSymbol* resolved = &table->program.symbols[symbol->id];
+    if (resolved->initialized_at < 0)
+        resolved->initialized_at = offset;
+}
+
+void record_initializer(SymbolTable* table, const Symbol* declared, const Token* name, ASTNode* node) {
+    record_reference(table, declared, XREF_DEF, name->offset);
+    if (table->pending_ref >= 0)
+        table->refs[table->pending_ref].node = node;
+    table->pending_ref = -1;
+}
+
+// --------------------------------------------------------------------------
+// Tree walker
+// --------------------------------------------------------------------------
+
+void resolve_node(ASTNode* node, SymbolTable* table, const Symbol* symbol) {
+    if (!node || !symbol)
+        return;
+    node->symbol_id = symbol->id;
+    node->slot = table->program.symbols[symbol->id].slot;
+    if (table->pending_ref >= 0) {
+        table->refs[table->pending_ref].node = node;
+        table->pending_ref = -1;
+    }
+}
+
+static int last_offset(const ASTNode* node) {
+    int offset = node->token.offset;
+    int left = node->left ? last_offset(node->left) : -1;
+    int right = node->right ? last_offset(node->right) : -1;
+    if (left > offset)
+        offset = left;
+    return right > offset ? right : offset;
+}
 
 int check_declaration(ASTNode* node, SymbolTable* table) {
     if (!node || node->type != AST_VARDECL)
         return 0;
-    const char* name = node->token.lexeme;
-    Symbol* existing = lookup_symbol_current_scope(table, name);
-    if (existing) {
-        semantic_error(SEM_ERROR_REDECLARED_VARIABLE, name, node->token.line);
+    if (!check_declared_name(&node->token, table))
         return 0;
-    }
-    add_symbol(table, name, TOKEN_INT, node->token.line);
+    resolve_node(node, table, table->head);
     if (node->right) {
+        record_initializer(table, table->head, &node->token, node);
         int initValid = check_expression(node->right, table);
         if (!initValid)
             return 0;
-        Symbol* sym = lookup_symbol(table, name);
+        // Initialized from just past the initializer's last token
+        Symbol* sym = lookup_token(table, &node->token, 0);
         if (sym)
-            sym->is_initialized = 1;
+            mark_initialized(table, sym, last_offset(node->right) + 1);
     }
     return 1;
 }
@@ -209,58 +480,78 @@ int check_assignment(ASTNode* node, SymbolTable* table) {
         return 0;
     if (!node->left)
         return 0;
-    const char* name = node->left->token.lexeme;
-    Symbol* symbol = lookup_symbol(table, name);
-    if (!symbol) {
-        if (!errorAlreadyReported(name)) {
-            semantic_error(SEM_ERROR_UNDECLARED_VARIABLE, name, node->token.line);
-            addReportedError(name);
-        }
+    Symbol* symbol = NULL;
+    int targetValid = check_assigned_name(&node->left->token, table, &symbol);
+    resolve_node(node, table, symbol);
+    resolve_node(node->left, table, symbol);
+    if (!targetValid)
         return 0;
-    }
-    symbol->is_initialized = 1;
     int rightValid = check_expression(node->right, table);
     return rightValid;
 }
 
-int check_expression(ASTNode* node, SymbolTable* table) {
-    if (!node)
+int check_read(ASTNode* node, SymbolTable* table) {
+    if (!node || node->type != AST_READ || !node->left)
         return 0;
+    Symbol* symbol = NULL;
+    int valid = check_assigned_name(&node->left->token, table, &symbol);
+    resolve_node(node->left, table, symbol);
+    return valid;
+}
+
+// Offset of the statement being checked. A shared expression node carries
+// the token of its first occurrence, so diagnostics inside one are placed on
+// the current statement's line instead.
+static int statement_offset = 0;
+
+static const Token* occurrence(const ASTNode* node, Token* copy) {
+    if (node->dag_id < 0)
+        return &node->token;
+    *copy = node->token;
+    copy->offset = statement_offset;
+    return copy;
+}
+
+static int check_expression_node(ASTNode* node, SymbolTable* table) {
+    Token copy;
     if (node->type == AST_NUMBER) {
         return 1;
     } else if (node->type == AST_IDENTIFIER) {
-        //printf("DEBUG: checking identifier '%s' at line %d\n", node->token.lexeme, node->token.line);
-        Symbol* symbol = lookup_symbol(table, node->token.lexeme);
-        if (!symbol) {
-            if (!errorAlreadyReported(node->token.lexeme)) {
-                semantic_error(SEM_ERROR_UNDECLARED_VARIABLE, node->token.lexeme, node->token.line);
-                addReportedError(node->token.lexeme);
-            }
-            return 0;
-        }
-        if (!symbol->is_initialized) {
-            semantic_error(SEM_ERROR_UNINITIALIZED_VARIABLE, node->token.lexeme, node->token.line);
-            return 0;
-        }
-        return 1;
+        Symbol* symbol = NULL;
+        int valid = check_identifier_use(occurrence(node, &copy), table, &symbol);
+        resolve_node(node, table, symbol);
+        return valid;
     } else if (node->type == AST_BINOP) {
-        int left_valid = check_expression(node->left, table);
+        // A prefix operator has no left operand
+        int left_valid = node->left ? check_expression(node->left, table) : 1;
         int right_valid = check_expression(node->right, table);
         return left_valid & right_valid;
     } else if (node->type == AST_FUNC_CALL) {
+        const Token* call = occurrence(node, &copy);
         if (node->left->type != AST_IDENTIFIER) {
-            semantic_error(SEM_ERROR_INVALID_OPERATION, "Invalid function call", node->token.line);
+            semantic_error(SEM_ERROR_INVALID_OPERATION, "Invalid function call", token_line(*call));
             return 0;
         }
-        if (strcmp(node->left->token.lexeme, "factorial") != 0) {
-            semantic_error(SEM_ERROR_INVALID_OPERATION, node->left->token.lexeme, node->token.line);
+        if (!check_callee_name(&node->left->token, call))
             return 0;
-        }
         return check_expression(node->right, table);
     }
     return 1;
 }
 
+int check_expression(ASTNode* node, SymbolTable* table) {
+    if (!node)
+        return 0;
+    if (node->dag_id < 0)
+        return check_expression_node(node, table);
+    if (dag_check_cached(node))
+        return 1;
+    int valid = check_expression_node(node, table);
+    if (valid)
+        dag_store_check(node);
+    return valid;
+}
+
 int check_block(ASTNode* node, SymbolTable* table) {
     if (!node || node->type != AST_BLOCK)
         return 0;
@@ -281,10 +572,11 @@ int check_condition(ASTNode* node, SymbolTable* table) {
     return check_expression(node->left, table);
 }
 
-static int check_statement(ASTNode* node, SymbolTable* table) {
+int check_statement(ASTNode* node, SymbolTable* table) {
     int result = 1;
     if (!node)
         return 1;
+    statement_offset = node->token.offset;
     switch (node->type) {
         case AST_VARDECL:
             result = check_declaration(node, table);
@@ -295,10 +587,15 @@ static int check_statement(ASTNode* node, SymbolTable* table) {
         case AST_PRINT:
             result = check_expression(node->left, table);
             break;
+        case AST_READ:
+            result = check_read(node, table);
+            break;
         case AST_IF: {
             int condValid = check_expression(node->left, table);
             int thenValid = (node->right) ? check_block(node->right, table) : 1;
-            int elseValid = (node->next) ? check_block(node->next, table) : 1;
+            // parse_if_statement hangs the else block off the then block
+            ASTNode* elseBlock = (node->right) ? node->right->right : NULL;
+            int elseValid = (elseBlock) ? check_block(elseBlock, table) : 1;
             result = condValid & thenValid & elseValid;
             break;
         }
@@ -322,8 +619,11 @@ static int check_program(ASTNode* node, SymbolTable* table) {
     if (!node)
         return 1;
     int result = 1;
-    if (node->left)
+    if (node->left) {
+        TRACE_BEGIN_AT("check_statement", node->left->token.offset);
         result &= check_statement(node->left, table);
+        TRACE_END();
+    }
     if (node->right)
         result &= check_program(node->right, table);
     if (node->next)
@@ -333,18 +633,818 @@ static int check_program(ASTNode* node, SymbolTable* table) {
 
 int analyze_semantics(ASTNode* ast) {
     reportedErrorCount = 0;
+    semantic_lookups = 0;
     SymbolTable* table = init_symbol_table();
     int result = check_program(ast, table);
     if (result) {
         dump_symbol_table(table); 
     }
+    semantic_lookups = table->lookups;
+    publish_program_symbols(table, 1);
+    free_symbol_table(table);
+    return result;
+}
+
+// Table of an analysis that runs inside the parser, which a recovered parse
+// error can jump out of (see abandon_analysis).
+static SymbolTable* parsing_table = NULL;
+
+void abandon_analysis(void) {
+    if (parsing_table)
+        free_symbol_table(parsing_table);
+    parsing_table = NULL;
+}
+
+int analyze_fused(ASTNode** out_ast) {
+    reportedErrorCount = 0;
+    semantic_lookups = 0;
+    SymbolTable* table = init_symbol_table();
+    int result = 1;
+    parsing_table = table;
+    ASTNode* ast = parse_checked(table, out_ast != NULL, &result);
+    parsing_table = NULL;
+    if (out_ast)
+        *out_ast = ast;
+    if (result) {
+        dump_symbol_table(table);
+    }
+    semantic_lookups = table->lookups;
+    // Without a tree every node the parser handed out was its scratch node
+    publish_program_symbols(table, out_ast != NULL);
     free_symbol_table(table);
     return result;
 }
 
 
-int main(void) {
+int analyze_streaming(void) {
+    reportedErrorCount = 0;
+    semantic_lookups = 0;
+    SymbolTable* table = init_symbol_table();
+    int result = 1;
+    ASTNode* statement;
+    while ((statement = parse_next_statement()) != NULL) {
+        TRACE_BEGIN_AT("check_statement", statement->token.offset);
+        result &= check_statement(statement, table);
+        TRACE_END();
+        free_ast(statement);
+    }
+    if (result) {
+        dump_symbol_table(table);
+    }
+    semantic_lookups = table->lookups;
+    publish_program_symbols(table, 0);
+    free_symbol_table(table);
+    return result;
+}
+
+// --------------------------------------------------------------------------
+// Command-line driver (compiled out of the library, see analyzer.h)
+// --------------------------------------------------------------------------
+
+#ifndef SEMANTIC_NO_MAIN
+static int default_thread_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0)
+        return (int)cpus;
+#endif
+    return 4;
+}
+
+// AST nodes reachable from node; statement lists are walked, not recursed.
+static long count_nodes(const ASTNode* node) {
+    long count = 0;
+    for (; node; node = node->next)
+        count += 1 + count_nodes(node->left) + count_nodes(node->right);
+    return count;
+}
+
+// --perf: one get_next_token loop over the whole input, on its own, so the
+// lexer's rates are not mixed with the parser's. The parser lexes again.
+static void profile_lexer(const char* input) {
+    long tokens = 0;
+    int pos = 0;
+    PERF_BEGIN(PERF_LEX);
+    lexer_set_source(input);
+    for (;;) {
+        int before = pos;
+        Token token = get_next_token(input, &pos);
+        tokens++;
+        if (token.type == TOKEN_EOF || pos == before)
+            break;
+    }
+    PERF_UNITS(PERF_LEX, tokens);
+    PERF_END();
+}
+
+// Write the AST and published symbols to path, as binary or JSON lines.
+static int export_program(const char* path, int binary, const ASTNode* ast) {
+    FILE* out = fopen(path, binary ? "wb" : "w");
+    if (!out) {
+        perror("Error opening export file");
+        return 0;
+    }
+    ExportWriter writer;
+    if (!export_writer_open(&writer, out, EXPORT_BUFFER_SIZE)) {
+        fclose(out);
+        return 0;
+    }
+    if (binary) {
+        export_ast_binary(&writer, ast);
+        export_symbols_binary(&writer, get_program_symbols());
+    } else {
+        export_ast_jsonl(&writer, ast);
+        export_symbols_jsonl(&writer, get_program_symbols());
+    }
+    int ok = export_writer_close(&writer) == 0;
+    if (fclose(out) != 0)
+        ok = 0;
+    return ok;
+}
+
+// Answer what is known at the end of one line, checking only the statements
+// that start up to there. Returns nonzero if the line has no diagnostics.
+static int run_query(ASTNode* ast, int line) {
+    QueryEngine* engine = query_open(ast);
+    if (!engine) {
+        perror("Memory allocation error");
+        return 0;
+    }
+    int position = line_to_offset(line + 1, 1) - 1;
+    int ids[64];
+    int visible = query_visible(engine, position, ids, 64);
+    const QueryDiagnostic* diagnostics;
+    int diagnostic_count = query_diagnostics(engine, line, line, &diagnostics);
+    int total;
+    int checked = query_checked(engine, &total);
+
+    printf("== QUERY AT LINE %d ==\n", line);
+    printf("Statements checked: %d of %d\n\n", checked, total);
+    printf("Visible declarations: %d\n", visible);
+    for (int i = 0; i < visible && i < 64; i++) {
+        const ResolvedSymbol* sym = query_symbol(engine, ids[i]);
+        int initialized = query_initialized(engine, sym->name, position);
+        printf("  %s (line %d, scope level %d): %s\n", sym->name, sym->line_declared,
+               sym->scope_level, initialized > 0 ? "initialized" : "not initialized");
+    }
+    if (visible > 64)
+        printf("  ... %d more\n", visible - 64);
+    printf("\nDiagnostics on line %d: %d\n", line, diagnostic_count);
+    for (int i = 0; i < diagnostic_count; i++)
+        printf("  %s", diagnostics[i].message);
+    printf("===================\n");
+    query_close(engine);
+    return diagnostic_count == 0;
+}
+
+#define IR_STEP_LIMIT 50000000L
+
+// One row of the pass table: the program as it now stands, checked for
+// well-formedness and run against the reference result.
+static void report_ir_stage(const char* stage, const IrProgram* program, int before, int changed,
+                            const IrRun* reference, int dump) {
+    char error[160];
+    IrRun run = {0};
+    const char* verdict = "same output";
+    if (!ir_verify(program, error, sizeof(error))) {
+        verdict = error;
+    } else {
+        ir_run(program, NULL, 0, IR_STEP_LIMIT, &run);
+        if (!ir_runs_agree(&run, reference))
+            verdict = "OUTPUT DIFFERS";
+        else if (run.status == IR_RUN_STEP_LIMIT || reference->status == IR_RUN_STEP_LIMIT)
+            verdict = "same output up to the step limit";
+    }
+    int count = ir_instruction_count(program);
+    printf("%-9s %8d %8d %8d %12ld %10ld  %s\n", stage, count, before - count, changed,
+           run.steps, run.multiplies, verdict);
+    if (dump) {
+        printf("\n");
+        ir_dump(stdout, program);
+        printf("\n");
+    }
+}
+
+// Lowers the checked tree to SSA and runs each pass in turn, printing how
+// much it changed and checking the result against the tree's own semantics.
+static void run_ir(const ASTNode* ast, int dump) {
+    static const struct {
+        const char* name;
+        int (*run)(IrProgram*);
+    } passes[] = {
+        {"gvn", ir_gvn}, {"licm", ir_licm}, {"strength", ir_strength_reduce}, {"dce", ir_dce}
+    };
+    char error[160];
+    IrProgram* program = ir_lower(ast, error, sizeof(error));
+    if (!program) {
+        printf("Cannot lower to IR: %s\n", error);
+        return;
+    }
+    IrRun reference;
+    ir_run_ast(ast, NULL, 0, IR_STEP_LIMIT, &reference);
+
+    printf("\n== IR PASSES ==\n");
+    printf("Reference run: %ld values printed, %ld nodes evaluated%s\n", reference.printed, reference.steps,
+           reference.status == IR_RUN_DIVIDE_BY_ZERO ? ", stopped by division by zero" :
+           reference.status == IR_RUN_STEP_LIMIT ? ", stopped at the step limit" : "");
+    printf("%-9s %8s %8s %8s %12s %10s  %s\n", "Stage", "Instrs", "Removed", "Changed",
+           "Executed", "Mul/Div", "Check");
+    int count = ir_instruction_count(program);
+    report_ir_stage("lowered", program, count, 0, &reference, dump);
+    for (size_t i = 0; i < sizeof(passes) / sizeof(passes[0]); i++) {
+        count = ir_instruction_count(program);
+        int changed = passes[i].run(program);
+        report_ir_stage(passes[i].name, program, count, changed, &reference, dump);
+    }
+    printf("===================\n");
+    ir_free(program);
+}
+
+#define RUN_ITERATION_LIMIT 1000000L
+
+// Runs the checked program once per line of inputPath ("-" for stdin),
+// writing what each run printed to outputPath (stdout if NULL). The vector
+// path runs IR_LANES inputs at a time; the scalar one runs the optimized IR
+// on each input in turn. Prints throughput to stderr.
+static void run_inputs(const ASTNode* ast, const char* inputPath, const char* outputPath, int scalar) {
+    char error[160];
+    FILE* in = strcmp(inputPath, "-") == 0 ? stdin : fopen(inputPath, "r");
+    if (!in) {
+        fprintf(stderr, "Cannot read '%s': %s\n", inputPath, strerror(errno));
+        return;
+    }
+    FILE* out = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Cannot write '%s': %s\n", outputPath, strerror(errno));
+        if (in != stdin)
+            fclose(in);
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    IrStreamStats stats = {0};
+    int ok = 0;
+    if (scalar) {
+        IrProgram* program = ir_lower(ast, error, sizeof(error));
+        if (program) {
+            ir_gvn(program);
+            ir_licm(program);
+            ir_strength_reduce(program);
+            ir_dce(program);
+            ok = ir_scalar_stream(program, in, out, IR_STEP_LIMIT, &stats, error, sizeof(error));
+            ir_free(program);
+        }
+    } else {
+        IrBatchProgram* program = ir_batch_compile(ast, error, sizeof(error));
+        if (program) {
+            ok = ir_batch_stream(program, in, out, RUN_ITERATION_LIMIT, &stats, error, sizeof(error));
+            ir_batch_free(program);
+        }
+    }
+    fflush(out);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!ok)
+        fprintf(stderr, "Run stopped: %s\n", error);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    char mode[64];
+    if (scalar)
+        snprintf(mode, sizeof(mode), "one at a time");
+    else
+        snprintf(mode, sizeof(mode), "%d lanes, %d per vector", IR_LANES, ir_batch_vector_width());
+    fprintf(stderr, "Ran %ld inputs (%s) in %.3f s: %.0f inputs/s, %.0f inputs/s executing only\n",
+            stats.rows, mode, elapsed, elapsed > 0 ? stats.rows / elapsed : 0.0,
+            stats.execute_seconds > 0 ? stats.rows / stats.execute_seconds : 0.0);
+    if (out != stdout)
+        fclose(out);
+    if (in != stdin)
+        fclose(in);
+}
+
+static double seconds_of(struct timeval t) {
+    return t.tv_sec + t.tv_usec / 1e6;
+}
+
+// Analyze every file named or found under inputs while an I/O thread reads
+// ahead; prints one verdict per file, then throughput to stderr.
+static void run_batch(const char* const* inputs, int count) {
+    IngestPaths list = {0};
+    for (int i = 0; i < count; i++)
+        if (!ingest_add_path(&list, inputs[i]))
+            fprintf(stderr, "Cannot read '%s': %s\n", inputs[i], strerror(errno));
+
+    struct rusage before, after;
+    struct timespec start, end;
+    getrusage(RUSAGE_SELF, &before);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    AnalyzerContext* analyzer = analyzer_create(NULL);
+    Ingest* ingest = ingest_start((const char* const*)list.paths, list.count, NULL);
+    if (!analyzer || !ingest) {
+        perror("Memory allocation error");
+        ingest_finish(ingest);
+        analyzer_destroy(analyzer);
+        ingest_free_paths(&list);
+        return;
+    }
+
+    size_t bytes = 0;
+    int failed = 0;
+    IngestFile* file;
+    while ((file = ingest_next(ingest)) != NULL) {
+        const AnalyzerResult* result = NULL;
+        if (file->error)
+            printf("%s: %s\n", file->path, strerror(file->error));
+        else if (!(result = analyzer_run(analyzer, file->data, file->length, NULL)))
+            printf("%s: %s\n", file->path, strerror(ENOMEM));
+        else
+            printf("%s: %s\n", file->path, result->ok ? "OK" : "errors");
+        for (int i = 0; result && i < result->diagnostic_count; i++)
+            printf("  %s", result->diagnostics[i].message);
+        if (!result || !result->ok)
+            failed++;
+        bytes += file->length;
+        ingest_release(ingest, file);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &after);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double user = seconds_of(after.ru_utime) - seconds_of(before.ru_utime);
+    double system = seconds_of(after.ru_stime) - seconds_of(before.ru_stime);
+    fprintf(stderr, "Checked %d files (%.1f MB, %d with errors) using %s reads in %.3f s: "
+            "%.0f files/s, CPU %.0f%% (user %.3f s, system %.3f s)\n",
+            list.count, bytes / 1e6, failed, ingest_backend(ingest), elapsed,
+            elapsed > 0 ? list.count / elapsed : 0.0,
+            elapsed > 0 ? 100.0 * (user + system) / elapsed : 0.0, user, system);
+    ingest_finish(ingest);
+    analyzer_destroy(analyzer);
+    ingest_free_paths(&list);
+}
+
+// --------------------------------------------------------------------------
+// Watch mode
+// --------------------------------------------------------------------------
+
+// Last verdict on a watched file; its messages back to back, each ending in
+// a newline.
+typedef struct {
+    char* path;
+    int ok;
+    char* diagnostics;
+    int diagnostic_count;
+} WatchedFile;
+
+typedef struct {
+    WatchedFile* files;      // Sorted by path
+    int count;
+    int capacity;
+} WatchedFiles;
+
+static double now_seconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// The file for path, or where it would go.
+static int find_watched(const WatchedFiles* set, const char* path, int* found) {
+    int low = 0, high = set->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int order = strcmp(set->files[mid].path, path);
+        if (order == 0) {
+            *found = 1;
+            return mid;
+        }
+        if (order < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    *found = 0;
+    return low;
+}
+
+static WatchedFile* add_watched(WatchedFiles* set, const char* path) {
+    int found;
+    int at = find_watched(set, path, &found);
+    if (found)
+        return &set->files[at];
+    if (set->count == set->capacity) {
+        int new_capacity = set->capacity ? set->capacity * 2 : 64;
+        WatchedFile* grown = mem_realloc(MEM_IO, set->files, new_capacity * sizeof(WatchedFile));
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        set->files = grown;
+        set->capacity = new_capacity;
+    }
+    memmove(&set->files[at + 1], &set->files[at], (set->count - at) * sizeof(WatchedFile));
+    set->count++;
+    WatchedFile* file = &set->files[at];
+    memset(file, 0, sizeof(*file));
+    file->ok = 1;
+    file->path = mem_alloc(MEM_IO, strlen(path) + 1);
+    if (!file->path) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    strcpy(file->path, path);
+    return file;
+}
+
+// Prints the messages of mine that theirs lacks, each message of theirs
+// matching at most one. Returns how many were printed.
+static int print_unmatched(const char* mine, const char* theirs, int their_count, char sign) {
+    char* used = mem_calloc(MEM_IO, their_count ? their_count : 1, 1);
+    if (!used) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    int printed = 0;
+    for (const char* line = mine; line && *line;) {
+        size_t length = strcspn(line, "\n");
+        int matched = 0;
+        const char* other = theirs;
+        for (int i = 0; i < their_count && !matched; i++) {
+            size_t other_length = strcspn(other, "\n");
+            if (!used[i] && other_length == length && memcmp(other, line, length) == 0)
+                used[i] = matched = 1;
+            other += other_length + 1;
+        }
+        if (!matched) {
+            printf("  %c %.*s\n", sign, (int)length, line);
+            printed++;
+        }
+        line += length + (line[length] == '\n');
+    }
+    mem_free(used);
+    return printed;
+}
+
+// Records the file's new verdict and prints what changed about it, if
+// anything did. Takes diagnostics. Returns whether it printed.
+static int update_watched(WatchedFile* file, int ok, char* diagnostics, int diagnostic_count,
+                          const char* verdict) {
+    const char* old = file->diagnostics ? file->diagnostics : "";
+    int same = file->ok == ok && file->diagnostic_count == diagnostic_count &&
+               strcmp(old, diagnostics ? diagnostics : "") == 0;
+    if (!same) {
+        printf("%s: %s\n", file->path, verdict);
+        print_unmatched(old, diagnostics, diagnostic_count, '-');
+        print_unmatched(diagnostics, old, file->diagnostic_count, '+');
+    }
+    mem_free(file->diagnostics);
+    file->ok = ok;
+    file->diagnostics = diagnostics;
+    file->diagnostic_count = diagnostic_count;
+    return !same;
+}
+
+static void remove_watched(WatchedFiles* set, int at, int* changed) {
+    WatchedFile* file = &set->files[at];
+    *changed += update_watched(file, 1, NULL, 0, "removed");
+    mem_free(file->path);
+    memmove(file, file + 1, (set->count - at - 1) * sizeof(WatchedFile));
+    set->count--;
+}
+
+// Reads paths on the ingest thread and analyzes each as it arrives. Returns
+// how many files' verdicts changed.
+static int analyze_watched(WatchedFiles* set, AnalyzerContext* analyzer, const IngestPaths* paths) {
+    if (paths->count == 0)
+        return 0;
+    Ingest* ingest = ingest_start((const char* const*)paths->paths, paths->count, NULL);
+    if (!ingest) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    int changed = 0;
+    IngestFile* file;
+    while ((file = ingest_next(ingest)) != NULL) {
+        int found;
+        int at = find_watched(set, file->path, &found);
+        const AnalyzerResult* result = NULL;
+        if (file->error == ENOENT) {
+            // Gone again before it could be read
+            if (found)
+                remove_watched(set, at, &changed);
+        } else if (file->error || !(result = analyzer_run(analyzer, file->data, file->length, NULL))) {
+            changed += update_watched(add_watched(set, file->path), 0, NULL, 0,
+                                      strerror(file->error ? file->error : ENOMEM));
+        } else {
+            size_t length = 0;
+            for (int i = 0; i < result->diagnostic_count; i++)
+                length += strlen(result->diagnostics[i].message);
+            char* diagnostics = mem_alloc(MEM_IO, length + 1);
+            if (!diagnostics) {
+                perror("Memory allocation error");
+                exit(1);
+            }
+            diagnostics[0] = '\0';
+            for (int i = 0, at_byte = 0; i < result->diagnostic_count; i++)
+                at_byte += sprintf(diagnostics + at_byte, "%s", result->diagnostics[i].message);
+            changed += update_watched(add_watched(set, file->path), result->ok, diagnostics,
+                                      result->diagnostic_count, result->ok ? "OK" : "errors");
+        }
+        ingest_release(ingest, file);
+    }
+    ingest_finish(ingest);
+    return changed;
+}
+
+static volatile sig_atomic_t watch_stopping = 0;
+
+static void stop_watching(int signal_number) {
+    (void)signal_number;
+    watch_stopping = 1;
+}
+
+// Analyze everything under inputs once, then again each file that changes,
+// printing only verdicts and diagnostics that differ from the last ones.
+// Files are read ahead on the ingest thread; the analyzer keeps process-wide
+// state, so they are analyzed one at a time. SIGINT or SIGTERM ends the
+// watch normally; a second one, should the first land just before the wait,
+// kills the process as usual. Returns nonzero if watching failed.
+static int run_watch(const char* const* inputs, int count, int debounce_ms) {
+    IngestPaths list = {0};
+    for (int i = 0; i < count; i++)
+        if (!ingest_add_path(&list, inputs[i]))
+            fprintf(stderr, "Cannot read '%s': %s\n", inputs[i], strerror(errno));
+    Watch* watch = watch_start(inputs, count);
+    if (!watch) {
+        fprintf(stderr, "Cannot watch the inputs: %s\n", strerror(errno));
+        ingest_free_paths(&list);
+        return 1;
+    }
+    AnalyzerContext* analyzer = analyzer_create(NULL);
+    if (!analyzer) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+
+    WatchedFiles set = {0};
+    double start = now_seconds();
+    analyze_watched(&set, analyzer, &list);
+    ingest_free_paths(&list);
+    int failing = 0;
+    for (int i = 0; i < set.count; i++)
+        failing += !set.files[i].ok;
+    fflush(stdout);
+    fprintf(stderr, "Watching %d files in %d directories, %d with errors (analyzed in %.3f s)\n",
+            set.count, watch_directory_count(watch), failing, now_seconds() - start);
+
+    struct sigaction stop;
+    memset(&stop, 0, sizeof(stop));
+    stop.sa_handler = stop_watching;
+    stop.sa_flags = SA_RESETHAND;    // No SA_RESTART: the wait returns EINTR
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    WatchBurst burst = {0};
+    int failed = 0;
+    while (!watch_stopping) {
+        if (!watch_next(watch, debounce_ms, &burst)) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Watch stopped: %s\n", strerror(errno));
+            failed = 1;
+            break;
+        }
+        IngestPaths changed = {0};
+        int printed = 0;
+        if (burst.overflowed) {
+            // Events were lost: whatever is there now is checked again
+            fprintf(stderr, "Too many changes at once; rescanning\n");
+            for (int i = 0; i < count; i++)
+                ingest_add_path(&changed, inputs[i]);
+            for (int i = set.count - 1; i >= 0; i--) {
+                int listed = 0;
+                for (int j = 0; j < changed.count && !listed; j++)
+                    listed = strcmp(changed.paths[j], set.files[i].path) == 0;
+                if (!listed)
+                    remove_watched(&set, i, &printed);
+            }
+        }
+        for (int i = 0; i < burst.count; i++) {
+            const WatchChange* change = &burst.changes[i];
+            if (change->kind == WATCH_CHANGED) {
+                if (!ingest_add_path(&changed, change->path) && errno != ENOENT)
+                    fprintf(stderr, "Cannot read '%s': %s\n", change->path, strerror(errno));
+                continue;
+            }
+            size_t length = strlen(change->path);
+            for (int j = set.count - 1; j >= 0; j--) {
+                const char* path = set.files[j].path;
+                if (change->directory ? strncmp(path, change->path, length) == 0 && path[length] == '/'
+                                      : strcmp(path, change->path) == 0)
+                    remove_watched(&set, j, &printed);
+            }
+        }
+        double analyze_start = now_seconds();
+        printed += analyze_watched(&set, analyzer, &changed);
+        fflush(stdout);
+        double done = now_seconds();
+        fprintf(stderr, "Re-analyzed %d of %d files, %d changed: %.1f ms from the first event "
+                "(%.1f ms waiting for quiet, %.1f ms analyzing)\n",
+                changed.count, set.count, printed, (done - burst.first_event) * 1000,
+                (analyze_start - burst.first_event) * 1000, (done - analyze_start) * 1000);
+        ingest_free_paths(&changed);
+    }
+
+    watch_free_burst(&burst);
+    for (int i = 0; i < set.count; i++) {
+        mem_free(set.files[i].path);
+        mem_free(set.files[i].diagnostics);
+    }
+    mem_free(set.files);
+    watch_finish(watch);
+    analyzer_destroy(analyzer);
+    return failed;
+}
+
+int main(int argc, char** argv) {
     const char *filePath = "./test/input_semantic_error.txt"; 
+    int fused = 0;
+    int stream = 0;
+    int pipelined = 0;
+    int threads = 0;
+    int mapReduce = 0;
+    const char *exportPath = NULL;
+    int exportBinary = 0;
+    int memReport = 0;
+    int shareExpressions = 0;
+    int xrefReport = 0;
+    const char *tracePath = NULL;
+    int queryLine = 0;
+    int batch = 0;
+    int lowerToIr = 0;
+    const char *runPath = NULL;
+    const char *runOutputPath = NULL;
+    int runScalar = 0;
+    int perfReport = 0;
+    int watch = 0;
+    int debounceMs = 50;
+    const char *inputs[argc > 0 ? argc : 1];
+    int inputCount = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fused") == 0)
+            fused = 1;
+        else if (strcmp(argv[i], "--stream") == 0)
+            stream = 1;
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            pipelined = 1;
+        else if (strncmp(argv[i], "--export-bin=", 13) == 0)
+            exportPath = argv[i] + 13, exportBinary = 1;
+        else if (strncmp(argv[i], "--export-jsonl=", 15) == 0)
+            exportPath = argv[i] + 15, exportBinary = 0;
+        else if (strncmp(argv[i], "--parallel", 10) == 0)
+            threads = (argv[i][10] == '=') ? atoi(argv[i] + 11) : default_thread_count();
+        else if (strncmp(argv[i], "--map-reduce", 12) == 0)
+            threads = (argv[i][12] == '=') ? atoi(argv[i] + 13) : default_thread_count(), mapReduce = 1;
+        else if (strcmp(argv[i], "--mem-report") == 0)
+            memReport = 1;
+        else if (strcmp(argv[i], "--dag") == 0)
+            shareExpressions = 1;
+        else if (strcmp(argv[i], "--xref-report") == 0)
+            xrefReport = 1;
+        else if (strncmp(argv[i], "--trace=", 8) == 0)
+            tracePath = argv[i] + 8;
+        else if (strncmp(argv[i], "--query=", 8) == 0)
+            queryLine = atoi(argv[i] + 8);
+        else if (strcmp(argv[i], "--batch") == 0)
+            batch = 1;
+        else if (strcmp(argv[i], "--ir") == 0)
+            lowerToIr = lowerToIr ? lowerToIr : 1;
+        else if (strcmp(argv[i], "--ir-dump") == 0)
+            lowerToIr = 2;
+        else if (strncmp(argv[i], "--run=", 6) == 0)
+            runPath = argv[i] + 6;
+        else if (strncmp(argv[i], "--run-output=", 13) == 0)
+            runOutputPath = argv[i] + 13;
+        else if (strcmp(argv[i], "--run-scalar") == 0)
+            runScalar = 1;
+        else if (strcmp(argv[i], "--perf") == 0)
+            perfReport = 1;
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch = 1;
+        else if (strncmp(argv[i], "--watch-debounce=", 17) == 0)
+            debounceMs = atoi(argv[i] + 17);
+        else
+            filePath = inputs[inputCount++] = argv[i];
+    }
+
+    // Streaming frees each statement right after checking it
+    if (stream && fused) {
+        fprintf(stderr, "--fused never builds the tree; ignoring --stream\n");
+        stream = 0;
+    }
+    if (stream && shareExpressions) {
+        fprintf(stderr, "--stream keeps no shared nodes; ignoring --dag\n");
+        shareExpressions = 0;
+    }
+    if (stream && threads) {
+        fprintf(stderr, "--stream checks sequentially; ignoring --parallel\n");
+        threads = 0;
+    }
+
+    if ((batch || watch) && (fused || stream || threads || shareExpressions || queryLine || exportPath ||
+                             xrefReport || lowerToIr || runPath || perfReport))
+        fprintf(stderr, "%s checks every file with the plain analysis; ignoring other modes\n",
+                watch ? "--watch" : "--batch");
+    if (batch && watch) {
+        fprintf(stderr, "--watch analyzes everything first; ignoring --batch\n");
+        batch = 0;
+    }
+    if (debounceMs < 1)
+        debounceMs = 1;
+
+    // A query walks the tree statement by statement, up to its line only
+    if (queryLine && (fused || stream)) {
+        fprintf(stderr, "--query needs the whole tree; ignoring --fused and --stream\n");
+        fused = stream = 0;
+    }
+    if (queryLine && (shareExpressions || threads || xrefReport)) {
+        fprintf(stderr, "--query checks only what it needs; ignoring --dag, --parallel and --xref-report\n");
+        shareExpressions = threads = xrefReport = 0;
+    }
+
+    // An export writes the checked tree, which only the two-pass modes keep
+    if (exportPath && (fused || stream)) {
+        fprintf(stderr, "--export-%s writes the whole tree; ignoring --fused and --stream\n",
+                exportBinary ? "bin" : "jsonl");
+        fused = stream = 0;
+    }
+
+    // Lowering walks the whole tree, one node per occurrence
+    if (lowerToIr && (fused || stream || queryLine)) {
+        fprintf(stderr, "--ir lowers the checked tree; ignoring --fused, --stream and --query\n");
+        fused = stream = queryLine = 0;
+    }
+    if (lowerToIr && shareExpressions) {
+        fprintf(stderr, "--ir needs one node per occurrence; ignoring --dag\n");
+        shareExpressions = 0;
+    }
+    if (runPath && (fused || stream || queryLine)) {
+        fprintf(stderr, "--run executes the checked tree; ignoring --fused, --stream and --query\n");
+        fused = stream = queryLine = 0;
+    }
+    if (runPath && shareExpressions) {
+        fprintf(stderr, "--run needs one node per occurrence; ignoring --dag\n");
+        shareExpressions = 0;
+    }
+    if ((runScalar || runOutputPath) && !runPath)
+        fprintf(stderr, "--run-scalar and --run-output need --run; ignoring them\n");
+
+    // The report needs every occurrence visited and published
+    if (xrefReport && shareExpressions) {
+        fprintf(stderr, "--xref-report checks every expression; ignoring --dag\n");
+        shareExpressions = 0;
+    }
+
+    // The parallel checkers leave the tree unresolved and publish no symbols
+    // (see semantic.h), so whatever reads them checks sequentially
+    const char *symbolReader = exportPath ? (exportBinary ? "--export-bin" : "--export-jsonl")
+                               : xrefReport ? "--xref-report" : NULL;
+    if (symbolReader && threads) {
+        fprintf(stderr, "%s needs resolved symbols; ignoring %s\n", symbolReader,
+                mapReduce ? "--map-reduce" : "--parallel");
+        threads = 0;
+    }
+
+    // Tracking is switched on before the first allocation so every block
+    // freed later was also counted.
+    mem_tracking_enable(memReport);
+    mem_phase_begin("read");
+    xref_enable(xrefReport);
+    if (tracePath)
+        trace_start();
+    if (perfReport && !batch && !watch)
+        perf_start();
+
+    // Runs until interrupted
+    if (watch) {
+        mem_phase_begin("watch");
+        return run_watch(inputs, inputCount, debounceMs);
+    }
+
+    if (batch) {
+        mem_phase_begin("batch");
+        run_batch(inputs, inputCount);
+        if (tracePath && !trace_write(tracePath))
+            fprintf(stderr, "Trace to '%s' failed\n", tracePath);
+        trace_free();
+        if (memReport)
+            mem_report(stderr);
+        return 0;
+    }
+
+    TRACE_BEGIN("load_file");
+    PERF_BEGIN(PERF_LOAD);
 
     FILE *fp = fopen(filePath, "r");
     if (!fp) {
@@ -356,7 +1456,7 @@ int main(void) {
     long filesize = ftell(fp);
     rewind(fp);
 
-    char *input = malloc(filesize + 1);
+    char *input = mem_alloc(MEM_IO, filesize + 1);
     if (!input) {
         perror("Memory allocation error");
         fclose(fp);
@@ -366,27 +1466,124 @@ int main(void) {
     size_t bytesRead = fread(input, 1, filesize, fp);
     input[bytesRead] = '\0'; 
     fclose(fp);
+    PERF_UNITS(PERF_LOAD, (long)bytesRead);
+    PERF_END();
+    TRACE_END();
 
     printf("Input file content from '%s':\n%s\n\n", filePath, input);
 
-    parser_init(input);
-    ASTNode* ast = parse();
+    if (perfReport)
+        profile_lexer(input);
 
-    printf("AST created. Performing semantic analysis...\n\n");
-    int result = analyze_semantics(ast);
+    ASTNode* ast = NULL;
+    int result;
+    if (!pipelined)
+        parser_init(input);
+    else if (!parser_init_pipelined(input))
+        fprintf(stderr, "Could not start the lexer thread; lexing inline\n");
+    if (fused) {
+        // Validation only: check while parsing and never build the tree
+        printf("Performing single-pass parse and semantic analysis...\n\n");
+        mem_phase_begin("check");
+        PERF_BEGIN(PERF_CHECK);
+        result = analyze_fused(NULL);
+    } else if (stream) {
+        // Same banner as the batch path, which prints it once parsing is done
+        printf("AST created. Performing semantic analysis...\n\n");
+        mem_phase_begin("check");
+        PERF_BEGIN(PERF_CHECK);
+        result = analyze_streaming();
+    } else {
+        mem_phase_begin("parse");
+        dag_enable(shareExpressions);
+        PERF_BEGIN(PERF_PARSE);
+        ast = parse();
+        PERF_END();
+        PERF_UNITS(PERF_PARSE, count_nodes(ast));
+        PERF_BEGIN(PERF_CHECK);
+        if (queryLine) {
+            printf("AST created. Answering a query...\n\n");
+            mem_phase_begin("check");
+            result = run_query(ast, queryLine);
+        } else {
+            printf("AST created. Performing semantic analysis...\n\n");
+            mem_phase_begin("check");
+            // The check cache is not thread-safe, so a shared tree is checked sequentially
+            if (threads && shareExpressions)
+                fprintf(stderr, "--dag checks sequentially; ignoring --parallel\n");
+            if (threads && !shareExpressions && mapReduce)
+                result = analyze_semantics_map_reduce(ast, threads);
+            else if (threads && !shareExpressions)
+                result = analyze_semantics_parallel(ast, threads);
+            else
+                result = analyze_semantics(ast);
+        }
+    }
+    PERF_END();
+    PERF_UNITS(PERF_CHECK, semantic_lookups);
+    parser_close();
+    if (shareExpressions && !fused) {
+        DagStats dag;
+        dag_get_stats(&dag);
+        fprintf(stderr, "Expression DAG: %ld nodes parsed, %d unique (%.1f%% shared); "
+                "check cache %ld hits, %ld misses, %ld invalidated\n",
+                dag.requested, dag.unique,
+                dag.requested ? 100.0 * (dag.requested - dag.unique) / dag.requested : 0.0,
+                dag.check_hits, dag.check_misses, dag.invalidated);
+    }
 
-    if (result) {
+    // A query printed its own verdict for the line
+    if (queryLine) {
+    } else if (result) {
         printf("Semantic analysis successful. No errors found.\n");
     } else {
         printf("Semantic analysis failed. Errors detected.\n");
     }
+    if (xrefReport)
+        report_unused_variables(stdout, get_cross_reference(), get_program_symbols());
+    if (lowerToIr && result) {
+        mem_phase_begin("ir");
+        TRACE_BEGIN("ir");
+        run_ir(ast, lowerToIr == 2);
+        TRACE_END();
+    }
+    if (runPath && result) {
+        mem_phase_begin("run");
+        TRACE_BEGIN("run");
+        run_inputs(ast, runPath, runOutputPath, runScalar);
+        TRACE_END();
+    }
+
+    mem_phase_begin("export");
+    TRACE_BEGIN("export");
+    if (exportPath && !export_program(exportPath, exportBinary, ast))
+        fprintf(stderr, "Export to '%s' failed\n", exportPath);
+    TRACE_END();
+
+    TRACE_BEGIN("flush_output");
+    fflush(stdout);
+    TRACE_END();
+    // Written before cleanup: event lines come from the input's line index
+    if (tracePath && !trace_write(tracePath))
+        fprintf(stderr, "Trace to '%s' failed\n", tracePath);
+    if (perfReport)
+        perf_report(stderr);
 
     // printf("\nAbstract Syntax Tree:\n");
     // print_ast(ast, 0);
 
+    mem_phase_begin("cleanup");
     free_ast(ast);
-    free(input);
+    dag_free();
+    free_program_symbols();
+    free_line_index();
+    mem_free(input);
+    trace_free();
+    intern_free();
 
+    if (memReport)
+        mem_report(stderr);
     return 0;
 }
 
+#endif /* SEMANTIC_NO_MAIN */
@@ -0,0 +1,115 @@
+/* xref.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../include/xref.h"
+#include "../../include/alloc.h"
+
+#define XREF_KINDS 3
+
+static int enabled = 1;
+static CrossReference published = {0};
+
+void xref_enable(int on) {
+    enabled = on;
+}
+
+int xref_enabled(void) {
+    return enabled;
+}
+
+const CrossReference* get_cross_reference(void) {
+    return &published;
+}
+
+void free_cross_reference(void) {
+    mem_free(published.sites);
+    mem_free(published.start);
+    memset(&published, 0, sizeof(published));
+}
+
+static int compare_sites(const void* a, const void* b) {
+    const XrefSite* x = a;
+    const XrefSite* y = b;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+// Counting sort on (symbol, kind). The checkers record in source order, so
+// a group only needs sorting when that order was not kept.
+void publish_cross_reference(const XrefRecord* records, int count, int symbol_count, int keep_nodes) {
+    free_cross_reference();
+    if (!enabled)
+        return;
+    int groups = symbol_count * XREF_KINDS;
+    int* start = mem_calloc(MEM_SYMBOLS, groups + 1, sizeof(int));
+    XrefSite* sites = mem_alloc(MEM_SYMBOLS, (count ? count : 1) * sizeof(XrefSite));
+    if (!start || !sites) {
+        mem_free(start);
+        mem_free(sites);
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        start[records[i].symbol * XREF_KINDS + records[i].kind + 1]++;
+    for (int g = 0; g < groups; g++)
+        start[g + 1] += start[g];
+    for (int i = 0; i < count; i++) {
+        // start[g] advances to the group's end and is shifted back below
+        XrefSite* site = &sites[start[records[i].symbol * XREF_KINDS + records[i].kind]++];
+        site->offset = records[i].offset;
+        site->node = keep_nodes ? records[i].node : NULL;
+    }
+    for (int g = groups; g > 0; g--)
+        start[g] = start[g - 1];
+    start[0] = 0;
+
+    for (int g = 0; g < groups; g++) {
+        for (int i = start[g] + 1; i < start[g + 1]; i++) {
+            if (sites[i].offset < sites[i - 1].offset) {
+                qsort(&sites[start[g]], start[g + 1] - start[g], sizeof(XrefSite), compare_sites);
+                break;
+            }
+        }
+    }
+
+    published.sites = sites;
+    published.start = start;
+    published.symbol_count = symbol_count;
+    published.site_count = count;
+}
+
+// --------------------------------------------------------------------------
+// Queries
+// --------------------------------------------------------------------------
+
+const XrefSite* xref_sites(const CrossReference* xref, int symbol, XrefKind kind, int* count) {
+    if (!xref->start || symbol < 0 || symbol >= xref->symbol_count) {
+        *count = 0;
+        return NULL;
+    }
+    int group = symbol * XREF_KINDS + kind;
+    *count = xref->start[group + 1] - xref->start[group];
+    return &xref->sites[xref->start[group]];
+}
+
+int xref_count(const CrossReference* xref, int symbol, XrefKind kind) {
+    int count;
+    xref_sites(xref, symbol, kind, &count);
+    return count;
+}
+
+int report_unused_variables(FILE* out, const CrossReference* xref, const ProgramSymbols* program) {
+    int warnings = 0;
+    for (int i = 0; i < program->symbol_count && i < xref->symbol_count; i++) {
+        if (xref_count(xref, i, XREF_USE))
+            continue;
+        const ResolvedSymbol* symbol = &program->symbols[i];
+        if (xref_count(xref, i, XREF_DEF))
+            fprintf(out, "Warning at line %d: Variable '%s' is assigned but never read\n",
+                    symbol->line_declared, symbol->name);
+        else
+            fprintf(out, "Warning at line %d: Variable '%s' is declared but never used\n",
+                    symbol->line_declared, symbol->name);
+        warnings++;
+    }
+    return warnings;
+}
@@ -0,0 +1,220 @@
+/* perfcount.c */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "../../include/perfcount.h"
+
+#define PERF_COUNTERS 5
+#define PERF_MAX_DEPTH 8
+
+typedef struct {
+    const char* name;
+    unsigned type;
+    unsigned long long config;
+    int fd;                  // -1 if unavailable
+    int error;               // errno from perf_event_open
+} Counter;
+
+typedef struct {
+    double counts[PERF_COUNTERS];
+    double seconds;
+    long units;
+    int runs;
+} PhaseTotals;
+
+#ifdef __linux__
+#define CACHE_READ_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static Counter counters[PERF_COUNTERS] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, 0},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0},
+    {"L1D read misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), -1, 0},
+    {"LLC misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, -1, 0},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, 0},
+};
+#else
+static Counter counters[PERF_COUNTERS] = {
+    {"cycles", 0, 0, -1, 0},
+    {"instructions", 0, 0, -1, 0},
+    {"L1D read misses", 0, 0, -1, 0},
+    {"LLC misses", 0, 0, -1, 0},
+    {"branch misses", 0, 0, -1, 0},
+};
+#endif
+
+enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES };
+
+static const char* phase_names[PERF_PHASE_COUNT] = {"load", "lex", "parse", "check", "dump"};
+static const char* unit_names[PERF_PHASE_COUNT] = {"byte", "token", "node", "lookup", "symbol"};
+
+int perf_active = 0;
+
+static PhaseTotals totals[PERF_PHASE_COUNT];
+static PerfPhase stack[PERF_MAX_DEPTH];
+static int depth = 0;
+static double last_counts[PERF_COUNTERS];
+static double last_seconds;
+
+static double seconds_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef __linux__
+static int open_counter(Counter* counter) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter->type;
+    attr.config = counter->config;
+    attr.exclude_kernel = 1;     // Allowed at perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    attr.inherit = 1;            // Threads started later count too
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+        counter->error = errno;
+        return -1;
+    }
+    return (int)fd;
+}
+
+// Scaled up when the kernel had to multiplex counters.
+static double read_counter(const Counter* counter) {
+    uint64_t values[3];
+    if (read(counter->fd, values, sizeof(values)) != (ssize_t)sizeof(values))
+        return 0;
+    if (values[2] == 0)
+        return 0;
+    return (double)values[0] * ((double)values[1] / (double)values[2]);
+}
+#endif
+
+static void sample(double counts[PERF_COUNTERS]) {
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+#ifdef __linux__
+        counts[i] = counters[i].fd >= 0 ? read_counter(&counters[i]) : 0;
+#else
+        counts[i] = 0;
+#endif
+    }
+}
+
+int perf_start(void) {
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+#ifdef __linux__
+        counters[i].fd = open_counter(&counters[i]);
+#else
+        counters[i].error = ENOSYS;
+#endif
+        if (counters[i].fd >= 0)
+            opened++;
+    }
+    memset(totals, 0, sizeof(totals));
+    depth = 0;
+    perf_active = 1;
+    return opened;
+}
+
+// Charges everything since the last sample to the innermost open phase.
+static void charge(void) {
+    double counts[PERF_COUNTERS];
+    sample(counts);
+    double seconds = seconds_now();
+    if (depth > 0) {
+        PhaseTotals* phase = &totals[stack[depth - 1]];
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            phase->counts[i] += counts[i] - last_counts[i];
+        phase->seconds += seconds - last_seconds;
+    }
+    memcpy(last_counts, counts, sizeof(last_counts));
+    last_seconds = seconds;
+}
+
+void perf_begin(PerfPhase phase) {
+    charge();
+    if (depth < PERF_MAX_DEPTH) {
+        stack[depth++] = phase;
+        totals[phase].runs++;
+    }
+}
+
+void perf_end(void) {
+    if (depth == 0)
+        return;
+    charge();
+    depth--;
+}
+
+void perf_add_units(PerfPhase phase, long units) {
+    totals[phase].units += units;
+}
+
+static void print_rate(FILE* out, int counter, double count, long units) {
+    if (counters[counter].fd < 0 || units <= 0)
+        fprintf(out, " %9s", "-");
+    else
+        fprintf(out, " %9.2f", count / units);
+}
+
+void perf_report(FILE* out) {
+    while (depth > 0)
+        perf_end();
+    perf_active = 0;
+
+    fprintf(out, "\n== HARDWARE COUNTERS ==\n");
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        if (counters[i].fd >= 0)
+            opened++;
+    if (opened == 0)
+        fprintf(out, "No hardware counters available; showing wall time and units only\n");
+    else
+        fprintf(out, "User-space counts over all threads, per unit of work\n");
+    for (int i = 0; i < PERF_COUNTERS; i++)
+        if (counters[i].fd < 0)
+            fprintf(out, "  %s unavailable: %s\n", counters[i].name, strerror(counters[i].error));
+
+    fprintf(out, "%-6s %10s %11s %-7s %8s %6s %9s %9s %9s %9s %9s\n", "Phase", "ms", "Units", "",
+            "ns/unit", "IPC", "cycles", "instrs", "L1D miss", "LLC miss", "br miss");
+    for (int p = 0; p < PERF_PHASE_COUNT; p++) {
+        const PhaseTotals* phase = &totals[p];
+        if (!phase->runs)
+            continue;
+        fprintf(out, "%-6s %10.3f %11ld %-7s", phase_names[p], phase->seconds * 1000,
+                phase->units, unit_names[p]);
+        if (phase->units > 0)
+            fprintf(out, " %8.1f", phase->seconds * 1e9 / phase->units);
+        else
+            fprintf(out, " %8s", "-");
+        if (counters[CYCLES].fd >= 0 && counters[INSTRUCTIONS].fd >= 0 && phase->counts[CYCLES] > 0)
+            fprintf(out, " %6.2f", phase->counts[INSTRUCTIONS] / phase->counts[CYCLES]);
+        else
+            fprintf(out, " %6s", "-");
+        print_rate(out, CYCLES, phase->counts[CYCLES], phase->units);
+        print_rate(out, INSTRUCTIONS, phase->counts[INSTRUCTIONS], phase->units);
+        print_rate(out, L1D_MISSES, phase->counts[L1D_MISSES], phase->units);
+        print_rate(out, LLC_MISSES, phase->counts[LLC_MISSES], phase->units);
+        print_rate(out, BRANCH_MISSES, phase->counts[BRANCH_MISSES], phase->units);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "=======================\n");
+
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTERS; i++) {
+        if (counters[i].fd >= 0)
+            close(counters[i].fd);
+        counters[i].fd = -1;
+    }
+#endif
+}
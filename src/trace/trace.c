@@ -0,0 +1,143 @@
+/* trace.c */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "../../include/trace.h"
+#include "../../include/lexer.h"
+#include "../../include/alloc.h"
+
+typedef struct {
+    uint64_t start;          // Nanoseconds since trace_start
+    uint64_t duration;
+    const char* name;
+    int offset;              // Source offset, -1 for none
+} TraceSpan;
+
+typedef struct TraceRing {
+    TraceSpan spans[TRACE_RING_EVENTS];
+    unsigned long written;   // Spans ever finished; the last TRACE_RING_EVENTS are kept
+    TraceSpan open[TRACE_MAX_DEPTH];
+    int depth;               // Open spans, including ones too deep to keep
+    int tid;
+    struct TraceRing* next;
+} TraceRing;
+
+int trace_active = 0;
+
+static uint64_t start_time = 0;
+static _Atomic(TraceRing*) rings = NULL;
+static atomic_int next_tid = 0;
+static _Thread_local TraceRing* local_ring = NULL;
+
+static uint64_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void trace_start(void) {
+    start_time = now();
+    trace_active = 1;
+}
+
+// First event on a thread: allocate its ring and push it on the global list.
+static TraceRing* register_ring(void) {
+    TraceRing* ring = mem_alloc(MEM_TRACE, sizeof(TraceRing));
+    if (!ring)
+        return NULL;
+    ring->written = 0;
+    ring->depth = 0;
+    ring->tid = atomic_fetch_add(&next_tid, 1) + 1;
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {
+    }
+    local_ring = ring;
+    return ring;
+}
+
+void trace_begin(const char* name, int offset) {
+    TraceRing* ring = local_ring ? local_ring : register_ring();
+    if (!ring)
+        return;
+    if (ring->depth < TRACE_MAX_DEPTH) {
+        TraceSpan* span = &ring->open[ring->depth];
+        span->name = name;
+        span->offset = offset;
+        span->start = now() - start_time;
+    }
+    ring->depth++;
+}
+
+void trace_end(void) {
+    TraceRing* ring = local_ring;
+    if (!ring || ring->depth == 0)
+        return;   // Begun before trace_start
+    if (--ring->depth >= TRACE_MAX_DEPTH)
+        return;
+    const TraceSpan* open = &ring->open[ring->depth];
+    TraceSpan* span = &ring->spans[ring->written++ & (TRACE_RING_EVENTS - 1)];
+    *span = *open;
+    span->duration = now() - start_time - open->start;
+}
+
+// --------------------------------------------------------------------------
+// Chrome trace-event JSON
+// --------------------------------------------------------------------------
+
+static void write_time(FILE* out, const char* key, uint64_t nanoseconds) {
+    fprintf(out, ",\"%s\":%llu.%03u", key, (unsigned long long)(nanoseconds / 1000),
+            (unsigned)(nanoseconds % 1000));
+}
+
+// Each span becomes one complete ("X") event; timestamps are microseconds.
+static void write_ring(FILE* out, const TraceRing* ring, int* first) {
+    fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}", *first ? "" : ",\n", ring->tid,
+            ring->tid == 1 ? "main" : "checker");
+    *first = 0;
+    unsigned long begin = ring->written > TRACE_RING_EVENTS ? ring->written - TRACE_RING_EVENTS : 0;
+    for (unsigned long i = begin; i < ring->written; i++) {
+        const TraceSpan* span = &ring->spans[i & (TRACE_RING_EVENTS - 1)];
+        fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d", span->name, ring->tid);
+        write_time(out, "ts", span->start);
+        write_time(out, "dur", span->duration);
+        if (span->offset >= 0)
+            fprintf(out, ",\"args\":{\"line\":%d}", offset_to_line(span->offset));
+        fputc('}', out);
+    }
+}
+
+int trace_write(const char* path) {
+    trace_active = 0;
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror("Error opening trace file");
+        return 0;
+    }
+    unsigned long dropped = 0;
+    int first = 1;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (TraceRing* ring = atomic_load(&rings); ring; ring = ring->next) {
+        write_ring(out, ring, &first);
+        if (ring->written > TRACE_RING_EVENTS)
+            dropped += ring->written - TRACE_RING_EVENTS;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_spans\":\"%lu\"}}\n", dropped);
+    int ok = !ferror(out);
+    if (fclose(out) != 0)
+        ok = 0;
+    return ok;
+}
+
+void trace_free(void) {
+    trace_active = 0;
+    TraceRing* ring = atomic_exchange(&rings, NULL);
+    while (ring) {
+        TraceRing* next = ring->next;
+        mem_free(ring);
+        ring = next;
+    }
+    local_ring = NULL;
+}
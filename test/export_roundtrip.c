@@ -0,0 +1,172 @@
+/* export_roundtrip.c - reads back what --export-bin writes
+ *
+ * Build and run (test/run_tests.sh does both):
+ *   gcc -O2 -Iinclude -DSEMANTIC_NO_MAIN test/export_roundtrip.c $(find src -name '*.c') \
+ *       -lpthread -o export_roundtrip
+ *   ./export_roundtrip program.txt...
+ *
+ * Each program is analyzed through the library API, its tree and symbols are
+ * exported in the binary format and read back, and the result must match
+ * field for field. A copy with the first node's token type byte corrupted
+ * must then be rejected. Prints one line per failure; exits 1 if any.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "analyzer.h"
+#include "export.h"
+
+// Offset of the first node's token type byte: "SAST", version, node type, flags
+#define FIRST_TOKEN_TYPE 7
+
+static int same_tree(const ASTNode* a, const ASTNode* b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->type != b->type || a->token.type != b->token.type || a->token.op != b->token.op ||
+            a->token.offset != b->token.offset || a->token.value != b->token.value ||
+            a->symbol_id != b->symbol_id || a->slot != b->slot ||
+            !same_tree(a->left, b->left) || !same_tree(a->right, b->right))
+            return 0;
+    }
+    return a == b;
+}
+
+static int same_symbols(const ProgramSymbols* a, const ProgramSymbols* b) {
+    if (a->symbol_count != b->symbol_count || a->scope_count != b->scope_count)
+        return 0;
+    for (int i = 0; i < a->symbol_count; i++) {
+        const ResolvedSymbol* x = &a->symbols[i];
+        const ResolvedSymbol* y = &b->symbols[i];
+        if (x->name_id != y->name_id || x->type != y->type || x->scope != y->scope ||
+            x->scope_level != y->scope_level || x->slot != y->slot ||
+            x->line_declared != y->line_declared || x->is_initialized != y->is_initialized)
+            return 0;
+    }
+    for (int i = 0; i < a->scope_count; i++) {
+        const ScopeRange* x = &a->scopes[i];
+        const ScopeRange* y = &b->scopes[i];
+        if (x->parent != y->parent || x->level != y->level || x->first_symbol != y->first_symbol ||
+            x->end_symbol != y->end_symbol || x->frame_size != y->frame_size)
+            return 0;
+    }
+    return 1;
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* in = fopen(path, "rb");
+    if (!in)
+        return NULL;
+    char* text = NULL;
+    size_t size = 0;
+    char chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+        char* grown = realloc(text, size + got);
+        if (!grown) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        text = grown;
+        memcpy(text + size, chunk, got);
+        size += got;
+    }
+    fclose(in);
+    *length = size;
+    return text;
+}
+
+// The exported sections, in memory.
+static unsigned char* export_result(const AnalyzerResult* result, size_t* size) {
+    FILE* out = tmpfile();
+    ExportWriter writer;
+    if (!out || !export_writer_open(&writer, out, 256)) {
+        perror("Error opening export file");
+        exit(1);
+    }
+    export_ast_binary(&writer, result->ast);
+    export_symbols_binary(&writer, result->symbols);
+    if (export_writer_close(&writer) != 0) {
+        fprintf(stderr, "Export failed\n");
+        exit(1);
+    }
+    *size = (size_t)ftell(out);
+    unsigned char* data = malloc(*size ? *size : 1);
+    if (!data) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    rewind(out);
+    if (fread(data, 1, *size, out) != *size) {
+        fprintf(stderr, "Export failed\n");
+        exit(1);
+    }
+    fclose(out);
+    return data;
+}
+
+static int check_program(AnalyzerContext* context, const char* path) {
+    size_t length;
+    char* text = read_file(path, &length);
+    if (!text) {
+        printf("FAIL %s: cannot read\n", path);
+        return 0;
+    }
+    AnalyzerOptions options = {1, 0, 0};
+    const AnalyzerResult* result = analyzer_run(context, text, length, &options);
+    free(text);
+    if (!result || result->aborted)
+        return 1;     // Nothing is exported without a tree
+
+    size_t size;
+    unsigned char* data = export_result(result, &size);
+    int ok = 1;
+    size_t used = 0;
+    ASTNode* ast = read_ast_binary(data, size, &used);
+    ProgramSymbols symbols;
+    size_t symbol_bytes = 0;
+    if (!ast && result->ast) {
+        printf("FAIL %s: exported tree not read back\n", path);
+        ok = 0;
+    } else if (!same_tree(result->ast, ast)) {
+        printf("FAIL %s: tree differs after the round trip\n", path);
+        ok = 0;
+    } else if (!read_symbols_binary(data + used, size - used, &symbol_bytes, &symbols)) {
+        printf("FAIL %s: exported symbols not read back\n", path);
+        ok = 0;
+    } else {
+        if (!same_symbols(result->symbols, &symbols) || used + symbol_bytes != size) {
+            printf("FAIL %s: symbols differ after the round trip\n", path);
+            ok = 0;
+        }
+        free_read_symbols(&symbols);
+    }
+    free_ast(ast);
+
+    // Out of range token types must be rejected, not cast into the tree
+    static const unsigned char bad_types[] = {TOKEN_ERROR, TOKEN_ERROR + 1, 0xff};
+    for (size_t i = 0; ok && result->ast && i < sizeof(bad_types); i++) {
+        unsigned char saved = data[FIRST_TOKEN_TYPE];
+        data[FIRST_TOKEN_TYPE] = bad_types[i];
+        ast = read_ast_binary(data, size, NULL);
+        if (ast) {
+            printf("FAIL %s: token type %u accepted\n", path, bad_types[i]);
+            free_ast(ast);
+            ok = 0;
+        }
+        data[FIRST_TOKEN_TYPE] = saved;
+    }
+    free(data);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    AnalyzerContext* context = analyzer_create(NULL);
+    if (!context) {
+        fprintf(stderr, "Cannot create an analyzer context\n");
+        return 1;
+    }
+    int failed = 0;
+    for (int i = 1; i < argc; i++)
+        failed += !check_program(context, argv[i]);
+    analyzer_destroy(context);
+    return failed ? 1 : 0;
+}
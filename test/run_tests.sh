@@ -0,0 +1,180 @@
+#!/bin/bash
+# run_tests.sh - regression checks against the outputs in test/expected
+#
+#   test/run_tests.sh [binary]             # builds one from src/ if not given
+#   test/run_tests.sh --update [binary]    # rewrites the expected outputs
+#
+# Every program in test/ and test/cases/ is checked in each checker mode.
+# All modes must print what the plain two-pass run prints (banner lines
+# aside), unless test/expected/cases/<name>.<mode>.out records where that
+# mode legitimately differs. The parallel modes run once more from a build
+# whose grain is small enough to split these programs. Programs in test/ir/ are lowered with --ir,
+# whose pass table checks every stage against the AST interpreter, and run
+# over test/ir/<name>.in both vectorized and one row at a time; the two
+# must agree with each other and with the expected rows. Every program's
+# tree and symbols must also export the same in every mode and survive a
+# binary export and read back intact.
+
+cd "$(dirname "$0")/.." || exit 1
+
+update=0
+if [ "$1" = "--update" ]; then
+    update=1
+    shift
+fi
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+bin=$1
+if [ -z "$bin" ]; then
+    bin=$work/semantic
+    gcc -O2 -Iinclude $(find src -name '*.c') -o "$bin" -lpthread || exit 1
+fi
+case $bin in /*) ;; *) bin=$PWD/$bin ;; esac
+
+modes="--fused --stream --parallel=3 --map-reduce=2 --dag --pipeline"
+export_modes="--fused --stream --parallel=3 --map-reduce=2"
+grain_modes="--parallel=3 --map-reduce=2"
+failed=0
+passed=0
+
+# check <expected file> <actual file> <label>
+check() {
+    if [ $update = 1 ]; then
+        cp "$2" "$1"
+    elif cmp -s "$1" "$2"; then
+        passed=$((passed + 1))
+    else
+        echo "FAIL $3"
+        diff "$1" "$2" | head -20
+        failed=$((failed + 1))
+    fi
+}
+
+# analyze <program> <output> [flags...]: stdout and exit status
+analyze() {
+    local program=$1 out=$2
+    shift 2
+    timeout 60 "${analyzer:-$bin}" "$@" "$program" 2>"$work/stderr" |
+        grep -v "^AST created\|^Performing single-pass" > "$out"
+    echo "exit ${PIPESTATUS[0]}" >> "$out"
+}
+
+# expected_for <name> <mode>: what that mode must print
+expected_for() {
+    local tag=${2#--}
+    tag=${tag%%=*}
+    if [ -f "test/expected/cases/$1.$tag.out" ]; then
+        echo "test/expected/cases/$1.$tag.out"
+    else
+        echo "test/expected/cases/$1.out"
+    fi
+}
+
+for program in test/*.txt test/cases/*.txt; do
+    name=$(basename "$program" .txt)
+    expected=test/expected/cases/$name.out
+    analyze "$program" "$work/plain.out"
+    check "$expected" "$work/plain.out" "$name"
+    for mode in $modes; do
+        tag=${mode#--}
+        tag=${tag%%=*}
+        analyze "$program" "$work/$tag.out" $mode
+        if [ -f "test/expected/cases/$name.$tag.out" ]; then
+            check "test/expected/cases/$name.$tag.out" "$work/$tag.out" "$name $mode"
+        elif [ $update = 1 ] && ! cmp -s "$work/plain.out" "$work/$tag.out"; then
+            cp "$work/$tag.out" "test/expected/cases/$name.$tag.out"
+        else
+            check "$expected" "$work/$tag.out" "$name $mode"
+        fi
+    done
+done
+
+for program in test/ir/*.txt; do
+    name=$(basename "$program" .txt)
+    timeout 60 "$bin" --ir "$program" 2>/dev/null | sed -n '/^== IR PASSES ==/,$p' > "$work/ir.out"
+    check "test/expected/ir/$name.ir.out" "$work/ir.out" "$name --ir"
+
+    inputs=test/ir/$name.in
+    [ -f "$inputs" ] || continue
+    timeout 60 "$bin" "$program" --run="$inputs" --run-output="$work/vector.out" >/dev/null 2>&1
+    timeout 60 "$bin" "$program" --run="$inputs" --run-scalar --run-output="$work/scalar.out" >/dev/null 2>&1
+    check "test/expected/ir/$name.run.out" "$work/vector.out" "$name --run"
+    check "test/expected/ir/$name.run.out" "$work/scalar.out" "$name --run --run-scalar"
+done
+
+# The test programs are far below PARALLEL_GRAIN nodes, so the parallel
+# checkers would check them in one piece. A build with a grain of two nodes
+# forks, joins and checks again on them, and must still print what the
+# plain run prints.
+if [ $update = 0 ]; then
+    gcc -O2 -Iinclude -DPARALLEL_GRAIN=2 $(find src -name '*.c') -o "$work/grain2" -lpthread || exit 1
+    forked=0
+    split=0
+    rechecked=0
+    for program in test/*.txt test/cases/*.txt; do
+        name=$(basename "$program" .txt)
+        for mode in $grain_modes; do
+            rm -f "$work/trace.json"
+            analyzer=$work/grain2 analyze "$program" "$work/grain.out" $mode --trace="$work/trace.json"
+            check "$(expected_for "$name" $mode)" "$work/grain.out" "$name $mode, grain 2"
+            grep -q '"check_range"' "$work/trace.json" 2>/dev/null && forked=$((forked + 1))
+            # Map-reduce: N chunks on T threads, R checked again in order
+            summary=($(sed -n 's/^Map-reduce: \([0-9]*\) chunks.* \([0-9]*\) checked again.*/\1 \2/p' "$work/stderr"))
+            [ "${summary[0]:-0}" -gt 1 ] && split=$((split + 1))
+            [ "${summary[1]:-0}" -gt 0 ] && rechecked=$((rechecked + 1))
+        done
+    done
+    for count in "$forked:--parallel never forked" "$split:--map-reduce never made two chunks" \
+                 "$rechecked:--map-reduce never checked a chunk again"; do
+        if [ "${count%%:*}" -gt 0 ]; then
+            passed=$((passed + 1))
+        else
+            echo "FAIL ${count#*:} with a grain of 2"
+            failed=$((failed + 1))
+        fi
+    done
+fi
+
+# export <program> <output> [flags...]: the JSON lines export, then the binary one
+export_program() {
+    local program=$1 out=$2
+    shift 2
+    rm -f "$work/export.jsonl" "$work/export.bin"
+    timeout 60 "$bin" "$@" --export-jsonl="$work/export.jsonl" "$program" > /dev/null 2>&1
+    timeout 60 "$bin" "$@" --export-bin="$work/export.bin" "$program" > /dev/null 2>&1
+    cat "$work/export.jsonl" "$work/export.bin" > "$out" 2> /dev/null
+}
+
+# Every mode must export the tree and symbols the plain run exports
+if [ $update = 0 ]; then
+    for program in test/*.txt test/cases/*.txt; do
+        name=$(basename "$program" .txt)
+        export_program "$program" "$work/plain.export"
+        for mode in $export_modes; do
+            export_program "$program" "$work/mode.export" $mode
+            check "$work/plain.export" "$work/mode.export" "$name $mode export"
+        done
+    done
+fi
+
+if [ $update = 0 ]; then
+    gcc -O2 -Iinclude -DSEMANTIC_NO_MAIN test/export_roundtrip.c $(find src -name '*.c') \
+        -o "$work/export_roundtrip" -lpthread || exit 1
+    for program in test/*.txt test/cases/*.txt test/ir/*.txt; do
+        if timeout 60 "$work/export_roundtrip" "$program"; then
+            passed=$((passed + 1))
+        else
+            echo "FAIL $(basename "$program" .txt) export round trip"
+            failed=$((failed + 1))
+        fi
+    done
+fi
+
+if [ $update = 1 ]; then
+    echo "Expected outputs updated"
+    exit 0
+fi
+echo "$passed passed, $failed failed"
+[ $failed = 0 ]
@@ -0,0 +1,86 @@
+/* analyzer_bench.c - per-call cost of the in-process library API
+ *
+ * Build and run:
+ *   gcc -O2 -Iinclude -DSEMANTIC_NO_MAIN tools/analyzer_bench.c $(find src -name '*.c') \
+ *       -lpthread -o analyzer_bench
+ *   ./analyzer_bench [file] [iterations]
+ *
+ * Analyzes the same buffer over and over with one reused context, once as a
+ * plain parse and check and once fused without a tree, and prints the mean
+ * time per call. Without a file a small program with one semantic error is
+ * used.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "analyzer.h"
+
+static const char* sample =
+    "int a = 1;\n"
+    "int b;\n"
+    "while (a < 10) {\n"
+    "    b = a + b;\n"
+    "    a = a + 1;\n"
+    "}\n"
+    "print(c);\n";
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char* text = malloc(size > 0 ? size : 1);
+    if (text)
+        *length = fread(text, 1, size, fp);
+    fclose(fp);
+    return text;
+}
+
+static void run(AnalyzerContext* context, const char* text, size_t length, int fused, long iterations) {
+    AnalyzerOptions options = {0};
+    options.fused = fused;
+    const AnalyzerResult* result = analyzer_run(context, text, length, &options);
+    if (!result) {
+        printf("analysis failed\n");
+        return;
+    }
+    double start = now();
+    for (long i = 0; i < iterations; i++)
+        result = analyzer_run(context, text, length, &options);
+    double seconds = now() - start;
+    printf("%-6s %10.2f us/call  ok=%d  %d diagnostics, %d symbols\n", fused ? "fused" : "batch",
+           seconds / iterations * 1e6, result->ok, result->diagnostic_count,
+           result->symbols->symbol_count);
+}
+
+int main(int argc, char** argv) {
+    size_t length = strlen(sample);
+    char* text = (char*)sample;
+    if (argc > 1 && !(text = read_file(argv[1], &length))) {
+        perror("Error opening file");
+        return 1;
+    }
+    long iterations = argc > 2 ? atol(argv[2]) : 100000;
+    if (iterations < 1)
+        iterations = 1;
+
+    AnalyzerContext* context = analyzer_create(NULL);
+    if (!context)
+        return 1;
+    printf("%zu bytes, %ld calls\n", length, iterations);
+    run(context, text, length, 0, iterations);
+    run(context, text, length, 1, iterations);
+    analyzer_destroy(context);
+    if (text != sample)
+        free(text);
+    return 0;
+}
@@ -0,0 +1,714 @@
+/* complexity_fuzz.c - searches for inputs on which the analyzer scales badly
+ *
+ * Build and run:
+ *   gcc -O2 -Iinclude -DSEMANTIC_NO_MAIN -fsanitize-coverage=trace-pc tools/complexity_fuzz.c \
+ *       $(find src -name '*.c') -lpthread -lm -o complexity_fuzz
+ *   ./complexity_fuzz [--runs=N] [--seconds=N] [--max-len=N] [--objective=blocks|time|allocs|peak]
+ *                     [--out=dir] [--seed=N] [seed files...]
+ *   ./complexity_fuzz --replay=dir [--max-exponent=X] [--tile-bytes=N]
+ *
+ * Mutates a corpus of programs and runs each through the library API (a
+ * plain parse and analyze_semantics, with a fresh context so nothing carries
+ * over). The objective is cost per input byte, not crashes: basic blocks
+ * executed (needs the coverage build above; without it wall time is used),
+ * allocator calls, or peak live bytes. An input is kept when it reaches
+ * edges no earlier input did, or when it ranks among the most expensive
+ * per byte; those are written to the output directory (default
+ * fuzz-worst/) as worst-NN.txt.
+ *
+ * Each saved input is then tiled to about 8, 16, 32 and 64 KB (--tile-bytes
+ * sets the first), giving every copy's names a suffix of their own so the
+ * copies do not just redeclare each other, and the growth exponent of its
+ * cost is printed; 1.0 is linear.
+ * --replay measures the inputs of a directory the same way and exits with
+ * status 1 if any grows faster than --max-exponent (default 1.5), so the
+ * saved inputs double as scaling regression benchmarks.
+ *
+ * An input that ends the process (exit on a failed allocation, a stack
+ * overflow in one of the recursive walks) is written to the output
+ * directory as exit.txt or crash.txt before the process goes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "analyzer.h"
+#include "intern.h"
+
+#define MAP_SIZE 65536
+#define MAX_CORPUS 4096
+#define MAX_KEEP 64
+#define TILE_STEPS 4
+
+#if defined(__clang__)
+#define NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+#define NO_COVERAGE
+#endif
+
+typedef enum { OBJECTIVE_BLOCKS, OBJECTIVE_TIME, OBJECTIVE_ALLOCS, OBJECTIVE_PEAK } Objective;
+
+static const char* objective_units[] = {"blocks", "ns", "allocs", "bytes"};
+
+typedef struct {
+    double blocks;           // Basic blocks executed (coverage build only)
+    double seconds;
+    double allocs;           // Allocator calls, reallocations included
+    double peak;             // Peak live bytes
+} Cost;
+
+typedef struct {
+    char* data;
+    size_t length;
+    double score;            // Objective per byte
+} Entry;
+
+static const char* sample =
+    "int a = 1;\n"
+    "int b;\n"
+    "while (a < 10) {\n"
+    "    b = a + b;\n"
+    "    a = a + 1;\n"
+    "}\n"
+    "print(c);\n";
+
+static const char* dictionary[] = {
+    "int ", "if (", "else ", "while (", "repeat ", "until ", "print ", "read ", "factorial(",
+    " = ", ";\n", "{\n", "}\n", "(", ")", " + ", " - ", " * ", " / ", " < ", " > ", " == ",
+    " != ", "0", "1", "42", "x", "y", "a1",
+};
+
+static const char* keywords[] = {
+    "if", "else", "int", "print", "while", "repeat", "until", "read", "factorial",
+};
+
+// --------------------------------------------------------------------------
+// Coverage and cost
+// --------------------------------------------------------------------------
+
+static unsigned char edges[MAP_SIZE];   // Hit counts of the current run
+static unsigned char seen[MAP_SIZE];    // Hit-count buckets seen so far
+static unsigned previous_location;
+static int recording = 0;
+static unsigned long blocks = 0;
+
+// Called by -fsanitize-coverage=trace-pc at every basic block.
+NO_COVERAGE void __sanitizer_cov_trace_pc(void) {
+    if (!recording)
+        return;
+    uint64_t pc = (uint64_t)(uintptr_t)__builtin_return_address(0);
+    unsigned location = (unsigned)((pc * 0x9E3779B97F4A7C15ull) >> 48);
+    unsigned char* count = &edges[(location ^ previous_location) & (MAP_SIZE - 1)];
+    if (*count != 255)
+        (*count)++;
+    previous_location = location >> 1;
+    blocks++;
+}
+
+static unsigned char bucket(unsigned char count) {
+    if (count <= 2) return count;
+    if (count == 3) return 4;
+    if (count < 8) return 8;
+    if (count < 16) return 16;
+    if (count < 32) return 32;
+    if (count < 128) return 64;
+    return 128;
+}
+
+// Whether the run reached an edge, or an edge as often, as none before it.
+static int new_coverage(void) {
+    int fresh = 0;
+    for (int i = 0; i < MAP_SIZE; i++) {
+        if (!edges[i])
+            continue;
+        unsigned char bits = bucket(edges[i]);
+        if (bits & ~seen[i]) {
+            seen[i] |= bits;
+            fresh = 1;
+        }
+    }
+    return fresh;
+}
+
+static int covered_edges(void) {
+    int count = 0;
+    for (int i = 0; i < MAP_SIZE; i++)
+        count += seen[i] != 0;
+    return count;
+}
+
+static double allocs = 0;
+static double live = 0;
+static double peak = 0;
+
+static void* counting_alloc(void* context, size_t size) {
+    (void)context;
+    allocs++;
+    live += size;
+    if (live > peak)
+        peak = live;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* context, void* block, size_t old_size, size_t new_size) {
+    (void)context;
+    allocs++;
+    live += (double)new_size - (double)old_size;
+    if (live > peak)
+        peak = live;
+    return realloc(block, new_size);
+}
+
+static void counting_free(void* context, void* block, size_t size) {
+    (void)context;
+    live -= size;
+    free(block);
+}
+
+static const Allocator counting_allocator = {counting_alloc, counting_realloc, counting_free, NULL};
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// The input being analyzed, for the exit and crash handlers.
+static const char* in_flight = NULL;
+static size_t in_flight_length = 0;
+static char exit_path[4096];
+static char crash_path[4096];
+
+static void execute(const char* data, size_t length, Cost* cost) {
+    AnalyzerContext* context = analyzer_create(&counting_allocator);
+    if (!context) {
+        fprintf(stderr, "Could not create an analyzer context\n");
+        exit(1);
+    }
+    memset(edges, 0, sizeof(edges));
+    previous_location = 0;
+    blocks = 0;
+    allocs = 0;
+    peak = live;
+    double base = live;
+    in_flight = data;
+    in_flight_length = length;
+
+    double start = now();
+    recording = 1;
+    analyzer_run(context, data, length, NULL);
+    recording = 0;
+    cost->seconds = now() - start;
+
+    in_flight = NULL;
+    cost->blocks = (double)blocks;
+    cost->allocs = allocs;
+    cost->peak = peak - base;
+    analyzer_destroy(context);
+    // Each input starts from an empty interner, so its cost does not depend
+    // on the names earlier inputs left behind
+    intern_free();
+}
+
+static double cost_value(const Cost* cost, Objective objective) {
+    switch (objective) {
+        case OBJECTIVE_BLOCKS: return cost->blocks;
+        case OBJECTIVE_TIME:   return cost->seconds * 1e9;
+        case OBJECTIVE_ALLOCS: return cost->allocs;
+        default:               return cost->peak;
+    }
+}
+
+// Wall time is noisy, so a timed input is measured three times and the
+// fastest run counts; the other objectives are deterministic.
+static double measure(const char* data, size_t length, Objective objective) {
+    Cost cost;
+    execute(data, length, &cost);
+    double value = cost_value(&cost, objective);
+    for (int i = 1; objective == OBJECTIVE_TIME && i < 3; i++) {
+        execute(data, length, &cost);
+        if (cost_value(&cost, objective) < value)
+            value = cost_value(&cost, objective);
+    }
+    return value;
+}
+
+// --------------------------------------------------------------------------
+// Inputs that end the process
+// --------------------------------------------------------------------------
+
+static void save_in_flight(const char* path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return;
+    size_t written = 0;
+    while (written < in_flight_length) {
+        ssize_t n = write(fd, in_flight + written, in_flight_length - written);
+        if (n <= 0)
+            break;
+        written += (size_t)n;
+    }
+    close(fd);
+}
+
+static void save_on_exit(void) {
+    if (in_flight) {
+        save_in_flight(exit_path);
+        fprintf(stderr, "The analyzer exited; input saved to %s\n", exit_path);
+    }
+}
+
+static void save_on_crash(int signal_number) {
+    if (in_flight) {
+        save_in_flight(crash_path);
+        static const char message[] = "The analyzer crashed; input saved\n";
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+        }
+    }
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+static void install_handlers(const char* out_dir) {
+    snprintf(exit_path, sizeof(exit_path), "%s/exit.txt", out_dir);
+    snprintf(crash_path, sizeof(crash_path), "%s/crash.txt", out_dir);
+    atexit(save_on_exit);
+
+    // A stack overflow needs a stack of its own to be handled on
+    static char handler_stack[1 << 16];
+    stack_t alternate = {0};
+    alternate.ss_sp = handler_stack;
+    alternate.ss_size = sizeof(handler_stack);
+    sigaltstack(&alternate, NULL);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = save_on_crash;
+    action.sa_flags = SA_ONSTACK;
+    sigaction(SIGSEGV, &action, NULL);
+    sigaction(SIGBUS, &action, NULL);
+    sigaction(SIGFPE, &action, NULL);
+}
+
+// --------------------------------------------------------------------------
+// Mutation
+// --------------------------------------------------------------------------
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static unsigned rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned)(rng_state >> 32);
+}
+
+static size_t insert_text(char* buffer, size_t length, size_t max_length, size_t at,
+                          const char* text, size_t text_length) {
+    if (length + text_length > max_length)
+        return length;
+    memmove(buffer + at + text_length, buffer + at, length - at);
+    memcpy(buffer + at, text, text_length);
+    return length + text_length;
+}
+
+static Entry corpus[MAX_CORPUS];
+static int corpus_count = 0;
+static Entry worst[MAX_KEEP];
+static int worst_count = 0;
+
+// One edit of buffer in place; returns the new length.
+static size_t mutate_once(char* buffer, size_t length, size_t max_length) {
+    static const char alphabet[] = "abxyz_019 +-*/=<>!(){};\n";
+    size_t at = length ? rng() % (length + 1) : 0;
+    switch (rng() % 7) {
+        case 0:
+            if (length)
+                buffer[rng() % length] = alphabet[rng() % (sizeof(alphabet) - 1)];
+            return length;
+        case 1: {
+            const char* word = dictionary[rng() % (sizeof(dictionary) / sizeof(dictionary[0]))];
+            return insert_text(buffer, length, max_length, at, word, strlen(word));
+        }
+        case 2: {
+            if (!length)
+                return length;
+            size_t start = rng() % length;
+            size_t count = 1 + rng() % (length - start < 16 ? length - start : 16);
+            memmove(buffer + start, buffer + start + count, length - start - count);
+            return length - count;
+        }
+        case 3: {
+            // Repeating a piece is what makes an input grow into a pathology
+            if (!length)
+                return length;
+            size_t start = rng() % length;
+            size_t count = 1 + rng() % (length - start);
+            char piece[4096];
+            if (count > sizeof(piece))
+                count = sizeof(piece);
+            memcpy(piece, buffer + start, count);
+            return insert_text(buffer, length, max_length, at, piece, count);
+        }
+        case 4: {
+            const Entry* other = &corpus[rng() % corpus_count];
+            if (!other->length)
+                return length;
+            size_t start = rng() % other->length;
+            size_t count = 1 + rng() % (other->length - start);
+            return insert_text(buffer, length, max_length, at, other->data + start, count);
+        }
+        case 5: {
+            // Statements over many distinct names
+            char statement[64];
+            unsigned a = rng() % 1000, b = rng() % 1000;
+            int n;
+            switch (rng() % 4) {
+                case 0:  n = snprintf(statement, sizeof(statement), "int v%u = %u;\n", a, b); break;
+                case 1:  n = snprintf(statement, sizeof(statement), "int v%u;\n", a); break;
+                case 2:  n = snprintf(statement, sizeof(statement), "v%u = v%u + 1;\n", a, b); break;
+                default: n = snprintf(statement, sizeof(statement), "print v%u;\n", a); break;
+            }
+            return insert_text(buffer, length, max_length, at, statement, (size_t)n);
+        }
+        default: {
+            // Nesting, for the recursive walks
+            static const char* opener[] = {"{\n", "if (x) {\n", "while (x) {\n", "("};
+            static const char* closer[] = {"}\n", "}\n", "}\n", ")"};
+            int kind = rng() % 4;
+            size_t end = at + rng() % (length - at + 1);
+            length = insert_text(buffer, length, max_length, end, closer[kind], strlen(closer[kind]));
+            return insert_text(buffer, length, max_length, at, opener[kind], strlen(opener[kind]));
+        }
+    }
+}
+
+static size_t mutate(char* buffer, const Entry* parent, size_t max_length) {
+    size_t length = parent->length < max_length ? parent->length : max_length;
+    memcpy(buffer, parent->data, length);
+    for (int edits = 1 + rng() % 4; edits > 0; edits--)
+        length = mutate_once(buffer, length, max_length);
+    return length;
+}
+
+static Entry make_entry(const char* data, size_t length, double score) {
+    Entry entry;
+    entry.data = malloc(length ? length : 1);
+    if (!entry.data) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    memcpy(entry.data, data, length);
+    entry.length = length;
+    entry.score = score;
+    return entry;
+}
+
+static void corpus_add(const char* data, size_t length, double score) {
+    if (corpus_count < MAX_CORPUS) {
+        corpus[corpus_count++] = make_entry(data, length, score);
+        return;
+    }
+    // Full: replace a random entry other than the seeds' first
+    Entry* victim = &corpus[1 + rng() % (MAX_CORPUS - 1)];
+    free(victim->data);
+    *victim = make_entry(data, length, score);
+}
+
+// Keeps the `keep` most expensive distinct inputs, most expensive first.
+// Returns the rank it took, or -1.
+static int consider_worst(const char* data, size_t length, double score, int keep) {
+    if (worst_count == keep && score <= worst[keep - 1].score)
+        return -1;
+    for (int i = 0; i < worst_count; i++)
+        if (worst[i].length == length && memcmp(worst[i].data, data, length) == 0)
+            return -1;
+    if (worst_count == keep)
+        free(worst[--worst_count].data);
+    int rank = worst_count;
+    while (rank > 0 && worst[rank - 1].score < score) {
+        worst[rank] = worst[rank - 1];
+        rank--;
+    }
+    worst[rank] = make_entry(data, length, score);
+    worst_count++;
+    return rank;
+}
+
+// --------------------------------------------------------------------------
+// Scaling
+// --------------------------------------------------------------------------
+
+static int is_keyword(const char* name, size_t length) {
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+        if (strlen(keywords[i]) == length && memcmp(keywords[i], name, length) == 0)
+            return 1;
+    return 0;
+}
+
+static int identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static int identifier_char(char c) {
+    return identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+// copies concatenated copies of data, every name in copy k > 0 suffixed
+// with _k. Returns a malloc'd buffer.
+static char* tile(const char* data, size_t length, int copies, size_t* out_length) {
+    // A suffix is at most 12 bytes and each needs a name of at least one
+    size_t capacity = (length * 13 + 1) * copies;
+    char* out = malloc(capacity ? capacity : 1);
+    if (!out) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    size_t at = 0;
+    for (int copy = 0; copy < copies; copy++) {
+        for (size_t i = 0; i < length;) {
+            if (!identifier_start(data[i]) || (i > 0 && identifier_char(data[i - 1]))) {
+                out[at++] = data[i++];
+                continue;
+            }
+            size_t end = i;
+            while (end < length && identifier_char(data[end]))
+                end++;
+            memcpy(out + at, data + i, end - i);
+            at += end - i;
+            if (copy > 0 && !is_keyword(data + i, end - i))
+                at += sprintf(out + at, "_%d", copy);
+            i = end;
+        }
+        out[at++] = '\n';
+    }
+    *out_length = at;
+    return out;
+}
+
+static size_t tile_bytes = 8192;
+
+// Growth exponent of the cost between the two largest tilings. The smallest
+// has at least tile_bytes bytes, so constant costs no longer dominate.
+static double scaling_exponent(const char* data, size_t length, Objective objective,
+                               double costs[TILE_STEPS], size_t lengths[TILE_STEPS]) {
+    int copies = length ? (int)((tile_bytes + length - 1) / length) : 1;
+    for (int step = 0; step < TILE_STEPS; step++) {
+        char* tiled = tile(data, length, copies << step, &lengths[step]);
+        costs[step] = measure(tiled, lengths[step], objective);
+        free(tiled);
+    }
+    if (costs[TILE_STEPS - 2] <= 0 || costs[TILE_STEPS - 1] <= 0)
+        return 0;
+    return log2(costs[TILE_STEPS - 1] / costs[TILE_STEPS - 2]);
+}
+
+static double report_scaling(const char* name, const char* data, size_t length, Objective objective) {
+    double costs[TILE_STEPS];
+    size_t lengths[TILE_STEPS];
+    double exponent = scaling_exponent(data, length, objective, costs, lengths);
+    printf("%-14s %6zu bytes, %s/byte tiled to", name, length, objective_units[objective]);
+    for (int step = 0; step < TILE_STEPS; step++)
+        printf(" %zuK: %.1f", lengths[step] / 1024, costs[step] / lengths[step]);
+    printf("  exponent %.2f\n", exponent);
+    return exponent;
+}
+
+// --------------------------------------------------------------------------
+// Driver
+// --------------------------------------------------------------------------
+
+static char* read_file(const char* path, size_t* length) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    char* text = malloc(size > 0 ? size : 1);
+    if (text)
+        *length = fread(text, 1, size, fp);
+    fclose(fp);
+    return text;
+}
+
+static int replay(const char* dir, Objective objective, double max_exponent) {
+    DIR* listing = opendir(dir);
+    if (!listing) {
+        perror("Error opening replay directory");
+        return 1;
+    }
+    int failed = 0, count = 0;
+    struct dirent* item;
+    while ((item = readdir(listing)) != NULL) {
+        size_t name_length = strlen(item->d_name);
+        if (name_length < 5 || strcmp(item->d_name + name_length - 4, ".txt") != 0)
+            continue;
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, item->d_name);
+        size_t length = 0;
+        char* data = read_file(path, &length);
+        if (!data)
+            continue;
+        double exponent = report_scaling(item->d_name, data, length, objective);
+        if (exponent > max_exponent) {
+            printf("  grows faster than exponent %.2f\n", max_exponent);
+            failed++;
+        }
+        count++;
+        free(data);
+    }
+    closedir(listing);
+    printf("%d of %d inputs scale worse than exponent %.2f\n", failed, count, max_exponent);
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    long runs = 100000;
+    double seconds = 0;
+    size_t max_length = 16384;
+    size_t min_length = 64;
+    int keep = 8;
+    int objective = -1;
+    const char* out_dir = "fuzz-worst";
+    const char* replay_dir = NULL;
+    double max_exponent = 1.5;
+    const char* seeds[argc > 0 ? argc : 1];
+    int seed_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0)
+            runs = atol(argv[i] + 7);
+        else if (strncmp(argv[i], "--seconds=", 10) == 0)
+            seconds = atof(argv[i] + 10);
+        else if (strncmp(argv[i], "--max-len=", 10) == 0)
+            max_length = (size_t)atol(argv[i] + 10);
+        else if (strncmp(argv[i], "--min-len=", 10) == 0)
+            min_length = (size_t)atol(argv[i] + 10);
+        else if (strncmp(argv[i], "--keep=", 7) == 0)
+            keep = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--out=", 6) == 0)
+            out_dir = argv[i] + 6;
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+            rng_state ^= (uint64_t)atoll(argv[i] + 7) * 0x9E3779B97F4A7C15ull;
+        else if (strncmp(argv[i], "--replay=", 9) == 0)
+            replay_dir = argv[i] + 9;
+        else if (strncmp(argv[i], "--tile-bytes=", 13) == 0)
+            tile_bytes = (size_t)atol(argv[i] + 13);
+        else if (strncmp(argv[i], "--max-exponent=", 15) == 0)
+            max_exponent = atof(argv[i] + 15);
+        else if (strcmp(argv[i], "--objective=blocks") == 0)
+            objective = OBJECTIVE_BLOCKS;
+        else if (strcmp(argv[i], "--objective=time") == 0)
+            objective = OBJECTIVE_TIME;
+        else if (strcmp(argv[i], "--objective=allocs") == 0)
+            objective = OBJECTIVE_ALLOCS;
+        else if (strcmp(argv[i], "--objective=peak") == 0)
+            objective = OBJECTIVE_PEAK;
+        else
+            seeds[seed_count++] = argv[i];
+    }
+    if (keep < 1)
+        keep = 1;
+    if (keep > MAX_KEEP)
+        keep = MAX_KEEP;
+    if (max_length < 16)
+        max_length = 16;
+
+    // Find out whether the library was built with coverage
+    Cost probe;
+    execute(sample, strlen(sample), &probe);
+    int coverage = probe.blocks > 0;
+    if (objective == OBJECTIVE_BLOCKS && !coverage) {
+        fprintf(stderr, "Not built with -fsanitize-coverage=trace-pc; using wall time instead of blocks\n");
+        objective = OBJECTIVE_TIME;
+    }
+    if (objective < 0)
+        objective = coverage ? OBJECTIVE_BLOCKS : OBJECTIVE_TIME;
+    if (!coverage)
+        fprintf(stderr, "No coverage: inputs are kept for their cost alone\n");
+
+    if (replay_dir)
+        return replay(replay_dir, (Objective)objective, max_exponent);
+
+    mkdir(out_dir, 0755);
+    install_handlers(out_dir);
+
+    for (int i = 0; i < seed_count; i++) {
+        size_t length = 0;
+        char* data = read_file(seeds[i], &length);
+        if (!data) {
+            fprintf(stderr, "Error opening seed '%s'\n", seeds[i]);
+            continue;
+        }
+        corpus_add(data, length < max_length ? length : max_length, 0);
+        free(data);
+    }
+    if (corpus_count == 0)
+        corpus_add(sample, strlen(sample), 0);
+
+    char* buffer = malloc(max_length);
+    if (!buffer) {
+        perror("Memory allocation error");
+        return 1;
+    }
+    const char* unit = objective_units[objective];
+    double start = now();
+    long run;
+    for (run = 1; run <= runs; run++) {
+        if (seconds > 0 && now() - start > seconds)
+            break;
+        // Mostly explore; a quarter of the time build on the worst so far
+        const Entry* parent = (worst_count && rng() % 4 == 0) ? &worst[rng() % worst_count]
+                                                               : &corpus[rng() % corpus_count];
+        size_t length = mutate(buffer, parent, max_length);
+
+        Cost cost;
+        execute(buffer, length, &cost);
+        int fresh = coverage && new_coverage();
+        double score = length ? cost_value(&cost, (Objective)objective) / length : 0;
+        int rank = -1;
+        if (length >= min_length) {
+            if (objective == OBJECTIVE_TIME && worst_count == keep && score > worst[keep - 1].score)
+                score = measure(buffer, length, OBJECTIVE_TIME) / length;
+            rank = consider_worst(buffer, length, score, keep);
+        }
+        if (fresh || rank >= 0)
+            corpus_add(buffer, length, score);
+        if (rank == 0)
+            printf("#%ld\tworst %.1f %s/byte at %zu bytes\n", run, score, unit, length);
+        if ((run & (run - 1)) == 0)
+            printf("#%ld\tcorpus %d, edges %d, %.0f runs/s\n", run, corpus_count, covered_edges(),
+                   run / (now() - start + 1e-9));
+    }
+    printf("Done: %ld runs in %.1f s, corpus %d, edges %d\n\n", run - 1, now() - start, corpus_count,
+           covered_edges());
+
+    for (int i = 0; i < worst_count; i++) {
+        char name[32], path[4096];
+        snprintf(name, sizeof(name), "worst-%02d.txt", i);
+        snprintf(path, sizeof(path), "%s/%s", out_dir, name);
+        FILE* out = fopen(path, "wb");
+        if (!out || fwrite(worst[i].data, 1, worst[i].length, out) != worst[i].length)
+            fprintf(stderr, "Could not write '%s'\n", path);
+        if (out)
+            fclose(out);
+        report_scaling(name, worst[i].data, worst[i].length, (Objective)objective);
+    }
+    printf("Saved %d inputs to %s/; check them later with --replay=%s\n", worst_count, out_dir, out_dir);
+
+    for (int i = 0; i < corpus_count; i++)
+        free(corpus[i].data);
+    for (int i = 0; i < worst_count; i++)
+        free(worst[i].data);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/* intern_bench.c - throughput of the shared identifier interner
+ *
+ * Build and run:
+ *   gcc -O2 -Iinclude tools/intern_bench.c src/intern/intern.c src/alloc/alloc.c -lpthread -o intern_bench
+ *   ./intern_bench [max_threads] [operations_per_thread]
+ *
+ * Every thread interns names drawn from one shared vocabulary, the way
+ * threads analyzing different files keep meeting the same identifiers:
+ * 90% of draws come from a small hot set, the rest from a long tail that is
+ * first inserted by whichever thread meets it first. Each thread count is run
+ * against the sharded interner and against the same interner behind one
+ * global mutex, which is what a plain locked table would cost.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "intern.h"
+
+#define VOCABULARY 200000
+#define HOT_NAMES 2000
+
+static char (*names)[32];
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static long operations = 2000000;
+static int use_global_lock = 0;
+
+typedef struct {
+    unsigned seed;
+    long checksum;
+} Worker;
+
+static unsigned next_random(unsigned* state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void* run_worker(void* arg) {
+    Worker* worker = arg;
+    long checksum = 0;
+    for (long i = 0; i < operations; i++) {
+        unsigned r = next_random(&worker->seed);
+        int index = (r % 10) ? (int)(r >> 8) % HOT_NAMES : (int)(r >> 8) % VOCABULARY;
+        int id;
+        if (use_global_lock) {
+            pthread_mutex_lock(&global_lock);
+            id = intern_name(names[index]);
+            pthread_mutex_unlock(&global_lock);
+        } else {
+            id = intern_name(names[index]);
+        }
+        checksum += id;
+    }
+    worker->checksum = checksum;
+    return NULL;
+}
+
+static double run(int threads) {
+    pthread_t ids[threads];
+    Worker workers[threads];
+    struct timespec start, end;
+    intern_free();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; t < threads; t++) {
+        workers[t].seed = 2463534242u + 977u * (unsigned)t;
+        pthread_create(&ids[t], NULL, run_worker, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++)
+        pthread_join(ids[t], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return threads * operations / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)(cpus > 0 ? cpus : 4);
+    if (argc > 2)
+        operations = atol(argv[2]);
+    names = malloc(sizeof(*names) * VOCABULARY);
+    if (!names)
+        return 1;
+    for (int i = 0; i < VOCABULARY; i++)
+        snprintf(names[i], sizeof(names[i]), "%s_%d", (i & 1) ? "counter" : "value", i);
+
+    printf("%d online CPUs, %ld interns per thread\n", (int)cpus, operations);
+    printf("%8s %16s %16s %10s\n", "threads", "sharded Mops/s", "global Mops/s", "speedup");
+    double base = 0;
+    // Powers of two, always ending on max_threads
+    for (int threads = 1; threads <= max_threads;
+         threads = (threads < max_threads && threads * 2 > max_threads) ? max_threads : threads * 2) {
+        use_global_lock = 0;
+        double sharded = run(threads);
+        use_global_lock = 1;
+        double global = run(threads);
+        if (threads == 1)
+            base = sharded;
+        printf("%8d %16.2f %16.2f %9.2fx\n", threads, sharded, global, sharded / base);
+    }
+    // Every name that went in must come back out under its own id
+    int found = 0;
+    for (int i = 0; i < VOCABULARY; i++) {
+        int id = intern_lookup(names[i]);
+        if (id < 0)
+            continue;
+        found++;
+        if (strcmp(intern_string(id), names[i]) != 0) {
+            printf("id %d resolves to '%s', expected '%s'\n", id, intern_string(id), names[i]);
+            return 1;
+        }
+    }
+    printf("%d distinct names, %d found again\n", intern_count(), found);
+    intern_free();
+    free(names);
+    return 0;
+}
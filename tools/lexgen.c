@@ -0,0 +1,486 @@
+/* lexgen.c - generates the lexer's DFA tables from src/lexer/lexer.rules
+ *
+ *   gcc -O2 tools/lexgen.c -o lexgen
+ *   ./lexgen src/lexer/lexer.rules include/lexer_dfa.h src/lexer/lexer_dfa.c
+ *
+ * Each rule's pattern becomes a Thompson NFA; subset construction turns the
+ * union into a DFA, Moore partition refinement minimizes it, and bytes whose
+ * columns are identical are folded into one character class. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MAX_RULES 64
+#define MAX_NFA 1024
+#define MAX_DFA 256
+#define NAME_SIZE 64
+
+typedef struct {
+    char pattern[256];
+    char token[NAME_SIZE];
+    int flags;
+    int line;
+} Rule;
+
+// An NFA state either consumes one byte from `set` and moves to `out`, or
+// has up to two epsilon edges.
+typedef struct {
+    unsigned char set[32];
+    int has_set;
+    int out;
+    int eps[2];
+    int accept;              // Rule index, or -1
+} NState;
+
+typedef struct {
+    int start;
+    int end;
+} Fragment;
+
+#define FLAG_IDENT 1
+#define FLAG_ARITH 2
+
+static Rule rules[MAX_RULES];
+static int rule_count = 0;
+static NState nfa[MAX_NFA];
+static int nfa_count = 0;
+
+// Subset construction output; state 0 is the dead state.
+typedef unsigned long long Bits[MAX_NFA / 64];
+static Bits dfa_sets[MAX_DFA];
+static int dfa_next[MAX_DFA][256];
+static int dfa_accept[MAX_DFA];
+static int dfa_count = 0;
+
+static void die(int line, const char* message) {
+    if (line)
+        fprintf(stderr, "lexgen: line %d: %s\n", line, message);
+    else
+        fprintf(stderr, "lexgen: %s\n", message);
+    exit(1);
+}
+
+// --------------------------------------------------------------------------
+// Rules file
+// --------------------------------------------------------------------------
+
+static void read_rules(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        exit(1);
+    }
+    char line[512];
+    int number = 0;
+    while (fgets(line, sizeof(line), in)) {
+        number++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\0')
+            continue;
+        if (rule_count == MAX_RULES)
+            die(number, "too many rules");
+        Rule* rule = &rules[rule_count++];
+        rule->line = number;
+        // The pattern runs to the first unescaped blank outside a class.
+        int n = 0, in_class = 0;
+        while (*p && *p != '\n' && (in_class || (*p != ' ' && *p != '\t'))) {
+            if (*p == '\\' && p[1]) {
+                rule->pattern[n++] = *p++;
+            } else if (*p == '[') {
+                in_class = 1;
+            } else if (*p == ']') {
+                in_class = 0;
+            }
+            if (n >= (int)sizeof(rule->pattern) - 1)
+                die(number, "pattern too long");
+            rule->pattern[n++] = *p++;
+        }
+        rule->pattern[n] = '\0';
+        char flags[2][NAME_SIZE] = {"", ""};
+        int fields = sscanf(p, "%63s %63s %63s", rule->token, flags[0], flags[1]);
+        if (fields < 1)
+            die(number, "missing token name");
+        for (int i = 0; i < fields - 1; i++) {
+            if (strcmp(flags[i], "ident") == 0)
+                rule->flags |= FLAG_IDENT;
+            else if (strcmp(flags[i], "arith") == 0)
+                rule->flags |= FLAG_ARITH;
+            else
+                die(number, "unknown flag");
+        }
+    }
+    fclose(in);
+    if (!rule_count)
+        die(0, "no rules");
+}
+
+// --------------------------------------------------------------------------
+// Thompson construction
+// --------------------------------------------------------------------------
+
+static int new_state(void) {
+    if (nfa_count == MAX_NFA)
+        die(0, "NFA too large");
+    NState* s = &nfa[nfa_count];
+    memset(s, 0, sizeof(*s));
+    s->out = s->eps[0] = s->eps[1] = -1;
+    s->accept = -1;
+    return nfa_count++;
+}
+
+static void add_eps(int from, int to) {
+    if (nfa[from].eps[0] < 0)
+        nfa[from].eps[0] = to;
+    else if (nfa[from].eps[1] < 0)
+        nfa[from].eps[1] = to;
+    else
+        die(0, "internal: epsilon overflow");
+}
+
+static void set_byte(unsigned char* set, int c) {
+    set[c >> 3] |= (unsigned char)(1 << (c & 7));
+}
+
+static int unescape(const char** p) {
+    int c = (unsigned char)*(*p)++;
+    if (c != '\\')
+        return c;
+    c = (unsigned char)*(*p)++;
+    if (c == 't')
+        return '\t';
+    if (c == 'n')
+        return '\n';
+    return c;
+}
+
+// Parses one atom (a byte or a [class]) into a fresh byte-consuming state.
+static int parse_atom(const char** p, int line) {
+    int state = new_state();
+    NState* s = &nfa[state];
+    s->has_set = 1;
+    if (**p != '[') {
+        set_byte(s->set, unescape(p));
+        return state;
+    }
+    (*p)++;
+    while (**p && **p != ']') {
+        int lo = unescape(p);
+        int hi = lo;
+        if (**p == '-' && (*p)[1] && (*p)[1] != ']') {
+            (*p)++;
+            hi = unescape(p);
+        }
+        if (hi < lo)
+            die(line, "bad class range");
+        for (int c = lo; c <= hi; c++)
+            set_byte(s->set, c);
+    }
+    if (**p != ']')
+        die(line, "unterminated class");
+    (*p)++;
+    return state;
+}
+
+static Fragment build_pattern(const char* pattern, int line) {
+    Fragment whole = {new_state(), -1};
+    whole.end = whole.start;
+    const char* p = pattern;
+    while (*p) {
+        int atom = parse_atom(&p, line);
+        int after = new_state();
+        nfa[atom].out = after;
+        int entry = atom;
+        if (*p == '*' || *p == '+' || *p == '?') {
+            char op = *p++;
+            // Wrap the atom: entry -> atom -> after, with a loop and/or bypass.
+            entry = new_state();
+            add_eps(entry, atom);
+            int exit_state = new_state();
+            add_eps(after, exit_state);
+            if (op != '+')
+                add_eps(entry, exit_state);
+            if (op != '?')
+                add_eps(after, atom);
+            after = exit_state;
+        }
+        add_eps(whole.end, entry);
+        whole.end = after;
+    }
+    if (whole.start == whole.end)
+        die(line, "empty pattern");
+    return whole;
+}
+
+static int build_nfa(void) {
+    int start = new_state();
+    int split = start;
+    for (int i = 0; i < rule_count; i++) {
+        Fragment f = build_pattern(rules[i].pattern, rules[i].line);
+        nfa[f.end].accept = i;
+        if (i + 1 < rule_count) {
+            int next_split = new_state();
+            add_eps(split, f.start);
+            add_eps(split, next_split);
+            split = next_split;
+        } else {
+            add_eps(split, f.start);
+        }
+    }
+    return start;
+}
+
+// --------------------------------------------------------------------------
+// Subset construction
+// --------------------------------------------------------------------------
+
+static void closure(Bits set) {
+    int stack[MAX_NFA];
+    int top = 0;
+    for (int i = 0; i < nfa_count; i++)
+        if (set[i / 64] >> (i % 64) & 1)
+            stack[top++] = i;
+    while (top) {
+        int s = stack[--top];
+        for (int e = 0; e < 2; e++) {
+            int t = nfa[s].eps[e];
+            if (t >= 0 && !(set[t / 64] >> (t % 64) & 1)) {
+                set[t / 64] |= 1ULL << (t % 64);
+                stack[top++] = t;
+            }
+        }
+    }
+}
+
+static int find_or_add(const Bits set) {
+    for (int i = 0; i < dfa_count; i++)
+        if (memcmp(dfa_sets[i], set, sizeof(Bits)) == 0)
+            return i;
+    if (dfa_count == MAX_DFA)
+        die(0, "DFA too large");
+    memcpy(dfa_sets[dfa_count], set, sizeof(Bits));
+    int accept = -1;
+    for (int i = 0; i < nfa_count; i++)
+        if ((set[i / 64] >> (i % 64) & 1) && nfa[i].accept >= 0 &&
+            (accept < 0 || nfa[i].accept < accept))
+            accept = nfa[i].accept;
+    dfa_accept[dfa_count] = accept;
+    return dfa_count++;
+}
+
+static void build_dfa(int nfa_start) {
+    Bits set;
+    memset(set, 0, sizeof(set));
+    find_or_add(set);                              // 0: dead
+    set[nfa_start / 64] |= 1ULL << (nfa_start % 64);
+    closure(set);
+    find_or_add(set);                              // 1: start
+    for (int d = 0; d < dfa_count; d++) {
+        for (int c = 0; c < 256; c++) {
+            Bits moved;
+            memset(moved, 0, sizeof(moved));
+            for (int i = 0; i < nfa_count; i++) {
+                if ((dfa_sets[d][i / 64] >> (i % 64) & 1) && nfa[i].has_set &&
+                    (nfa[i].set[c >> 3] >> (c & 7) & 1))
+                    moved[nfa[i].out / 64] |= 1ULL << (nfa[i].out % 64);
+            }
+            closure(moved);
+            dfa_next[d][c] = find_or_add(moved);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------
+// Minimization (Moore) and character classes
+// --------------------------------------------------------------------------
+
+static int group[MAX_DFA];
+static int group_count = 0;
+
+// Accepting states are told apart by what they produce, not by rule index,
+// so rules with the same token and flags can share states.
+static int same_action(int a, int b) {
+    if (a < 0 || b < 0)
+        return a == b;
+    return strcmp(rules[a].token, rules[b].token) == 0 && rules[a].flags == rules[b].flags;
+}
+
+static void minimize(void) {
+    // Initial partition: dead state alone, then one group per action.
+    int representative[MAX_DFA];
+    group_count = 0;
+    for (int d = 0; d < dfa_count; d++) {
+        int g = 0;
+        if (d == 0) {
+            g = group_count++;
+            representative[g] = d;
+        } else {
+            for (g = 1; g < group_count; g++)
+                if (same_action(dfa_accept[representative[g]], dfa_accept[d]))
+                    break;
+            if (g == group_count) {
+                representative[g] = d;
+                group_count++;
+            }
+        }
+        group[d] = g;
+    }
+    for (;;) {
+        int next_group[MAX_DFA];
+        int count = 0;
+        for (int d = 0; d < dfa_count; d++) {
+            int g;
+            for (g = 0; g < count; g++) {
+                int r = representative[g];
+                if (group[r] != group[d])
+                    continue;
+                int c;
+                for (c = 0; c < 256; c++)
+                    if (group[dfa_next[r][c]] != group[dfa_next[d][c]])
+                        break;
+                if (c == 256)
+                    break;
+            }
+            if (g == count)
+                representative[count++] = d;
+            next_group[d] = g;
+        }
+        int changed = count != group_count;
+        memcpy(group, next_group, sizeof(int) * dfa_count);
+        group_count = count;
+        if (!changed)
+            break;
+    }
+}
+
+static int min_next[MAX_DFA][256];
+static int min_accept[MAX_DFA];
+static int byte_class[256];
+static int class_count = 0;
+static int class_byte[256];          // A representative byte per class
+
+static void fold_classes(void) {
+    for (int d = 0; d < dfa_count; d++) {
+        min_accept[group[d]] = dfa_accept[d];
+        for (int c = 0; c < 256; c++)
+            min_next[group[d]][c] = group[dfa_next[d][c]];
+    }
+    for (int c = 0; c < 256; c++) {
+        int k;
+        for (k = 0; k < class_count; k++) {
+            int r = class_byte[k];
+            int s;
+            for (s = 0; s < group_count; s++)
+                if (min_next[s][r] != min_next[s][c])
+                    break;
+            if (s == group_count)
+                break;
+        }
+        if (k == class_count)
+            class_byte[class_count++] = c;
+        byte_class[c] = k;
+    }
+}
+
+// --------------------------------------------------------------------------
+// Output
+// --------------------------------------------------------------------------
+
+// Row index is state << shift, keeping a multiply off the per-byte chain.
+static int row_shift(void) {
+    int shift = 0;
+    while ((1 << shift) < class_count)
+        shift++;
+    return shift;
+}
+
+static void write_header(const char* path, const char* rules_path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(out, "/* lexer_dfa.h - generated by tools/lexgen.c from %s; do not edit */\n", rules_path);
+    fprintf(out, "#ifndef LEXER_DFA_H\n#define LEXER_DFA_H\n\n");
+    fprintf(out, "#define DFA_STATE_COUNT %d\n", group_count);
+    fprintf(out, "#define DFA_CLASS_COUNT %d\n", class_count);
+    fprintf(out, "#define DFA_ROW_SHIFT %d   // Rows are padded to a power of two\n", row_shift());
+    fprintf(out, "#define DFA_DEAD 0\n");
+    fprintf(out, "#define DFA_START %d\n\n", group[1]);
+    fprintf(out, "// dfa_token values besides TokenType\n");
+    fprintf(out, "#define DFA_REJECT (-1)\n#define DFA_SKIP (-2)\n\n");
+    fprintf(out, "// dfa_flags bits\n");
+    fprintf(out, "#define DFA_IDENT %d\n#define DFA_ARITH %d\n\n", FLAG_IDENT, FLAG_ARITH);
+    fprintf(out, "extern const unsigned char dfa_class[256];\n");
+    fprintf(out, "extern const unsigned char dfa_next[DFA_STATE_COUNT << DFA_ROW_SHIFT];\n");
+    fprintf(out, "extern const signed char dfa_token[DFA_STATE_COUNT];\n");
+    fprintf(out, "extern const unsigned char dfa_flags[DFA_STATE_COUNT];\n\n");
+    fprintf(out, "#endif /* LEXER_DFA_H */\n");
+    fclose(out);
+}
+
+static void write_tables(const char* path, const char* rules_path) {
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(out, "/* lexer_dfa.c - generated by tools/lexgen.c from %s; do not edit */\n", rules_path);
+    fprintf(out, "#include \"../../include/tokens.h\"\n");
+    fprintf(out, "#include \"../../include/lexer_dfa.h\"\n\n");
+
+    fprintf(out, "const unsigned char dfa_class[256] = {");
+    for (int c = 0; c < 256; c++)
+        fprintf(out, "%s%d,", c % 16 ? " " : "\n    ", byte_class[c]);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "const unsigned char dfa_next[DFA_STATE_COUNT << DFA_ROW_SHIFT] = {\n");
+    int row = 1 << row_shift();
+    for (int s = 0; s < group_count; s++) {
+        fprintf(out, "    ");
+        for (int k = 0; k < row; k++)
+            fprintf(out, "%d,%s", k < class_count ? min_next[s][class_byte[k]] : 0, k + 1 < row ? " " : "");
+        fprintf(out, "\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const signed char dfa_token[DFA_STATE_COUNT] = {\n");
+    for (int s = 0; s < group_count; s++) {
+        int rule = min_accept[s];
+        if (rule < 0)
+            fprintf(out, "    DFA_REJECT,\n");
+        else if (strcmp(rules[rule].token, "SKIP") == 0)
+            fprintf(out, "    DFA_SKIP,\n");
+        else
+            fprintf(out, "    %s,\n", rules[rule].token);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const unsigned char dfa_flags[DFA_STATE_COUNT] = {\n");
+    for (int s = 0; s < group_count; s++) {
+        int rule = min_accept[s];
+        fprintf(out, "    %d,\n", rule < 0 ? 0 : rules[rule].flags);
+    }
+    fprintf(out, "};\n");
+    fclose(out);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s rules header.h tables.c\n", argv[0]);
+        return 1;
+    }
+    read_rules(argv[1]);
+    build_dfa(build_nfa());
+    minimize();
+    if (group_count > 255)
+        die(0, "too many states for an unsigned char table");
+    fold_classes();
+    write_header(argv[2], argv[1]);
+    write_tables(argv[3], argv[1]);
+    printf("%d rules, %d NFA states, %d DFA states, %d minimized, %d classes\n",
+           rule_count, nfa_count, dfa_count, group_count, class_count);
+    return 0;
+}